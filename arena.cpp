@@ -0,0 +1,38 @@
+/**
+ * \file arena.cpp
+ * \brief Implementation for arena.h
+ */
+
+#include<cstring>
+#include<algorithm>
+#include"arena.h"
+
+std::string_view Arena::store(std::string_view str)
+{
+	if(str.empty())
+		return std::string_view();
+	size += str.size();
+
+	// Large strings get a block of their own, so the current one can still be filled
+	if(str.size() > BLOCK_SIZE / 4)
+	{
+		blocks.push_back(std::unique_ptr<char[]>(new char[str.size()]));
+		std::memcpy(blocks.back().get(), str.data(), str.size());
+		return std::string_view(blocks.back().get(), str.size());
+	}
+
+	if(str.size() > available)
+	{
+		while(nextBlockSize < str.size())
+			nextBlockSize *= 2;
+		blocks.push_back(std::unique_ptr<char[]>(new char[nextBlockSize]));
+		current = blocks.back().get();
+		available = nextBlockSize;
+		nextBlockSize = std::min(nextBlockSize * 2, BLOCK_SIZE);
+	}
+	std::memcpy(current, str.data(), str.size());
+	std::string_view result(current, str.size());
+	current += str.size();
+	available -= str.size();
+	return result;
+}
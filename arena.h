@@ -0,0 +1,56 @@
+/**
+ * \file arena.h
+ * \brief Defines the Arena class
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include<string_view>
+#include<vector>
+#include<memory>
+#include<cstddef>
+
+/**
+ * \brief Storage for strings that live and die together
+ * \details Strings are copied into large blocks, so storing many small strings
+ * takes few allocations and no per-string overhead. Nothing is freed before
+ * the Arena itself is destroyed; the views returned by store() stay valid
+ * until then. Blocks start small and double in size up to BLOCK_SIZE, so an
+ * arena that holds little (e.g. that of an unchanged feed) stays small.
+ * Strings longer than a quarter block get a block of their own.
+ */
+class Arena
+{
+private:
+	std::vector<std::unique_ptr<char[]>> blocks;
+	char* current;
+	std::size_t available, size, nextBlockSize;
+public:
+	/// Size of the largest blocks that strings are copied into
+	static constexpr std::size_t BLOCK_SIZE = 64 * 1024;
+
+	/**
+	 * \brief Creates an empty Arena
+	 * \details No memory is allocated until the first string is stored.
+	 */
+	Arena(): current(nullptr), available(0), size(0), nextBlockSize(1024) {}
+
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+
+	/**
+	 * \brief Copies a string into the arena
+	 * \param str The string.
+	 * \return A view of the copy.
+	 */
+	std::string_view store(std::string_view str);
+
+	/**
+	 * \brief Returns how much has been stored
+	 * \return The total length of all stored strings in bytes.
+	 */
+	std::size_t getSize() const {return size;}
+};
+
+#endif //ARENA_H
@@ -0,0 +1,104 @@
+/**
+ * \file bandwidthscheduler.cpp
+ * \brief Implementation for bandwidthscheduler.h
+ */
+
+#include<algorithm>
+#include<cmath>
+#include"bandwidthscheduler.h"
+
+BandwidthScheduler::BandwidthScheduler(std::uint64_t rate)
+: rate(rate), nextId(0)
+{
+	// Allow bursts of a quarter second, but at least a few chunks as CURL delivers them
+	capacity = std::max(this->rate / 4, 64.0 * 1024);
+	tokens = capacity;
+	lastRefill = std::chrono::steady_clock::now();
+}
+
+unsigned BandwidthScheduler::add(const std::string& host, unsigned priority)
+{
+	// Start where the others are, so a new transfer does not get to catch up
+	double virtualTime = 0;
+	bool first = true;
+	for(const auto& entry : transfers)
+	{
+		virtualTime = first ? entry.second.virtualTime : std::min(virtualTime, entry.second.virtualTime);
+		first = false;
+	}
+	transfers[nextId] = Transfer{host, std::max(priority, 1u), virtualTime, false};
+	transfersPerHost[host]++;
+	return nextId++;
+}
+
+void BandwidthScheduler::remove(unsigned id)
+{
+	auto iter = transfers.find(id);
+	if(iter == transfers.end())
+		return;
+	if(--transfersPerHost[iter->second.host] == 0)
+		transfersPerHost.erase(iter->second.host);
+	transfers.erase(iter);
+}
+
+double BandwidthScheduler::weight(const Transfer& transfer) const
+{
+	return (double)transfer.priority / transfersPerHost.at(transfer.host);
+}
+
+bool BandwidthScheduler::request(unsigned id, std::size_t bytes)
+{
+	auto iter = transfers.find(id);
+	if(rate == 0 || iter == transfers.end())
+		return true;
+	Transfer& transfer = iter->second;
+
+	// Paused transfers that are further behind go first
+	bool entitled = tokens > 0;
+	for(const auto& entry : transfers)
+		if(entry.first != id && entry.second.paused && entry.second.virtualTime < transfer.virtualTime)
+			entitled = false;
+	if(!entitled)
+	{
+		transfer.paused = true;
+		return false;
+	}
+
+	// The bucket may go into debt for one chunk, which is paid back by waiting longer
+	tokens -= bytes;
+	transfer.virtualTime += bytes / weight(transfer);
+	transfer.paused = false;
+	return true;
+}
+
+std::vector<unsigned> BandwidthScheduler::refill()
+{
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	tokens = std::min(capacity, tokens + rate * std::chrono::duration<double>(now - lastRefill).count());
+	lastRefill = now;
+
+	// Resume paused transfers, those furthest behind first
+	std::vector<unsigned> result;
+	if(tokens <= 0)
+		return result;
+	for(auto& entry : transfers)
+		if(entry.second.paused)
+		{
+			entry.second.paused = false;
+			result.push_back(entry.first);
+		}
+	std::sort(result.begin(), result.end(), [this](unsigned a, unsigned b) {return transfers.at(a).virtualTime < transfers.at(b).virtualTime;});
+	return result;
+}
+
+int BandwidthScheduler::waitTime() const
+{
+	bool paused = false;
+	for(const auto& entry : transfers)
+		paused = paused || entry.second.paused;
+	if(!paused)
+		return -1;
+	if(tokens > 0)
+		return 0;
+	return (int)std::ceil(-tokens / rate * 1000) + 1;
+}
@@ -0,0 +1,97 @@
+/**
+ * \file bandwidthscheduler.h
+ * \brief Defines the BandwidthScheduler class
+ */
+
+#ifndef BANDWIDTHSCHEDULER_H
+#define BANDWIDTHSCHEDULER_H
+
+#include<string>
+#include<vector>
+#include<map>
+#include<chrono>
+#include<cstdint>
+#include<cstddef>
+
+/**
+ * \brief Distributes a global download rate among concurrent transfers
+ * \details The global rate is enforced with a token bucket. Transfers ask for
+ * permission before they consume received data (request()); if the bucket is
+ * empty or another transfer is entitled to the bandwidth first, the transfer
+ * has to pause until refill() selects it to continue.
+ *
+ * Bandwidth is shared by weighted fair queuing: every transfer accumulates a
+ * virtual time (bytes received divided by its weight), and the transfer that is
+ * furthest behind is served first. The weight of a transfer is its priority
+ * divided by the number of transfers to the same host, so every host gets the
+ * same share regardless of how many connections it has, and transfers with a
+ * higher priority get proportionally more.
+ *
+ * The scheduler does not deal with CURL handles itself, see DownloadEngine.
+ */
+class BandwidthScheduler
+{
+private:
+	struct Transfer
+	{
+		std::string host;
+		unsigned priority;
+		double virtualTime;
+		bool paused;
+	};
+
+	double rate, tokens, capacity;
+	std::chrono::steady_clock::time_point lastRefill;
+	std::map<unsigned, Transfer> transfers;
+	std::map<std::string, unsigned> transfersPerHost;
+	unsigned nextId;
+
+	double weight(const Transfer& transfer) const;
+public:
+	/**
+	 * \brief Creates a BandwidthScheduler
+	 * \param rate The maximum total rate in bytes per second, or 0 for no
+	 * limit. Without a limit, request() always grants permission.
+	 */
+	BandwidthScheduler(std::uint64_t rate);
+
+	/**
+	 * \brief Registers a transfer
+	 * \param host The host the transfer receives data from.
+	 * \param priority The priority of the transfer (at least 1).
+	 * \return An identifier for the transfer.
+	 */
+	unsigned add(const std::string& host, unsigned priority);
+
+	/**
+	 * \brief Unregisters a transfer once it has ended
+	 * \param id The identifier returned by add().
+	 */
+	void remove(unsigned id);
+
+	/**
+	 * \brief Asks for permission to consume received data
+	 * \param id The identifier returned by add().
+	 * \param bytes The amount of data.
+	 * \return True if the data may be consumed now, false if the transfer has
+	 * to pause until refill() returns its identifier.
+	 */
+	bool request(unsigned id, std::size_t bytes);
+
+	/**
+	 * \brief Adds tokens according to the time passed and selects paused
+	 * transfers to continue
+	 * \return The identifiers of the transfers that may continue, in the
+	 * order in which they should be resumed.
+	 */
+	std::vector<unsigned> refill();
+
+	/**
+	 * \brief Returns how long paused transfers have to wait at most
+	 * \return The time in milliseconds until refill() will let a paused
+	 * transfer continue, or -1 if no transfer is paused.
+	 */
+	int waitTime() const;
+};
+
+#endif //BANDWIDTHSCHEDULER_H
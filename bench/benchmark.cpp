@@ -0,0 +1,111 @@
+/**
+ * \file benchmark.cpp
+ * \brief Implementation for benchmark.h
+ */
+
+#include<iostream>
+#include<iomanip>
+#include<atomic>
+#include<new>
+#include<cstdlib>
+#include<malloc.h>
+#include"benchmark.h"
+
+// Counters for the replacement operator new and delete
+static std::atomic<std::uint64_t> allocations(0);
+static std::atomic<std::size_t> live(0), peak(0);
+
+void* operator new(std::size_t size)
+{
+	void* ptr = std::malloc(size ? size : 1);
+	if(!ptr)
+		throw std::bad_alloc();
+	allocations++;
+	std::size_t now = live += malloc_usable_size(ptr);
+	std::size_t before = peak;
+	while(now > before && !peak.compare_exchange_weak(before, now));
+	return ptr;
+}
+
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+	if(!ptr)
+		return;
+	live -= malloc_usable_size(ptr);
+	std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+	operator delete(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+	operator delete(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept
+{
+	operator delete(ptr);
+}
+
+std::uint64_t Benchmark::allocationCount()
+{
+	return allocations;
+}
+
+std::size_t Benchmark::liveBytes()
+{
+	return live;
+}
+
+std::size_t Benchmark::peakBytes()
+{
+	return peak;
+}
+
+void Benchmark::resetPeak()
+{
+	peak = live.load();
+}
+
+Benchmark::Benchmark(std::string filter, double minTime)
+: filter(filter), minTime(minTime)
+{
+}
+
+void Benchmark::report(const Result& result) const
+{
+	double perItem = result.seconds / result.items;
+	std::cout << std::left << std::setw(36) << result.name << std::right
+		<< std::setw(14) << std::fixed << std::setprecision(1) << perItem * 1e9 << " ns/item"
+		<< std::setw(16) << std::setprecision(0) << 1 / perItem << " items/s"
+		<< std::setw(12) << std::setprecision(2) << (double)result.allocations / result.items << " allocs/item"
+		<< std::setw(12) << std::setprecision(0) << result.peakBytes / 1024.0 << " KiB peak" << std::endl;
+}
+
+void Benchmark::writeJson(std::ostream& os) const
+{
+	os << "{" << std::endl << "  \"benchmarks\": [" << std::endl;
+	for(std::size_t i = 0; i < results.size(); i++)
+	{
+		const Result& result = results[i];
+		os << std::setprecision(9)
+			<< "    {\"name\": \"" << result.name << "\""
+			<< ", \"iterations\": " << result.iterations
+			<< ", \"items\": " << result.items
+			<< ", \"seconds\": " << result.seconds
+			<< ", \"ns_per_item\": " << result.seconds / result.items * 1e9
+			<< ", \"items_per_second\": " << result.items / result.seconds
+			<< ", \"allocations\": " << result.allocations
+			<< ", \"peak_bytes\": " << result.peakBytes
+			<< "}" << (i + 1 < results.size() ? "," : "") << std::endl;
+	}
+	os << "  ]" << std::endl << "}" << std::endl;
+}
@@ -0,0 +1,116 @@
+/**
+ * \file benchmark.h
+ * \brief Defines the Benchmark class
+ */
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include<string>
+#include<vector>
+#include<chrono>
+#include<ostream>
+#include<cstdint>
+#include<cstddef>
+
+/**
+ * \brief Runs benchmarks and collects their results
+ * \details Each benchmark is a function that processes a fixed number of
+ * items (e.g. dates or episodes). It is repeated until enough time has passed
+ * for a stable measurement, and the time per item is recorded. The number of
+ * heap allocations and the peak heap growth are recorded from the first
+ * repetition, since later ones may find warm caches.
+ */
+class Benchmark
+{
+private:
+	struct Result
+	{
+		std::string name;
+		std::size_t iterations, items;
+		double seconds; // Per iteration, the fastest one
+		std::uint64_t allocations; // In the first iteration
+		std::size_t peakBytes; // Heap growth in the first iteration
+	};
+
+	std::vector<Result> results;
+	std::string filter;
+	double minTime;
+
+	void report(const Result& result) const;
+
+	// Maintained by the replacement operator new and delete in benchmark.cpp
+	static std::uint64_t allocationCount();
+	static std::size_t liveBytes();
+	static std::size_t peakBytes();
+	static void resetPeak();
+public:
+	/**
+	 * \brief Creates a Benchmark
+	 * \param filter Only benchmarks whose name contains this string are run.
+	 * \param minTime Minimum time in seconds that each benchmark is repeated
+	 * for.
+	 */
+	Benchmark(std::string filter = "", double minTime = 0.5);
+
+	/**
+	 * \brief Returns whether a benchmark is selected by the filter
+	 * \details Can be used to skip expensive preparations.
+	 * \param name The name of the benchmark.
+	 * \return True if the benchmark is to be run.
+	 */
+	bool selected(const std::string& name) const {return name.find(filter) != std::string::npos;}
+
+	/**
+	 * \brief Runs a benchmark (unless it is not selected)
+	 * \param name The name of the benchmark, e.g. "filter/apply".
+	 * \param items Number of items that one call of function processes.
+	 * \param function The code to measure.
+	 */
+	template<typename F>
+	void run(const std::string& name, std::size_t items, F function)
+	{
+		if(!selected(name))
+			return;
+		Result result = {name, 0, items, 0, 0, 0};
+		double total = 0;
+		while(result.iterations < 3 || total < minTime)
+		{
+			std::uint64_t allocationsBefore = allocationCount();
+			std::size_t liveBefore = liveBytes();
+			resetPeak();
+			auto start = std::chrono::steady_clock::now();
+			function();
+			std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+			if(result.iterations == 0)
+			{
+				result.allocations = allocationCount() - allocationsBefore;
+				result.peakBytes = peakBytes() - liveBefore;
+			}
+			if(result.iterations == 0 || elapsed.count() < result.seconds)
+				result.seconds = elapsed.count();
+			total += elapsed.count();
+			result.iterations++;
+		}
+		results.push_back(result);
+		report(result);
+	}
+
+	/**
+	 * \brief Writes all results as JSON
+	 * \param os The stream the JSON document is written to.
+	 */
+	void writeJson(std::ostream& os) const;
+};
+
+/**
+ * \brief Keeps the compiler from optimizing away a computed value
+ * \param value The value.
+ */
+template<typename T>
+inline void keep(const T& value)
+{
+	asm volatile("" : : "r,m"(value) : "memory");
+}
+
+#endif //BENCHMARK_H
@@ -0,0 +1,26 @@
+/**
+ * \file benchmarks.h
+ * \brief Declares the functions that register the benchmarks
+ */
+
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include<filesystem>
+#include"benchmark.h"
+
+/**
+ * \brief Runs the benchmarks for publication date parsing
+ * \param benchmark Collects the results.
+ */
+void benchDateParser(Benchmark& benchmark);
+
+/**
+ * \brief Runs the benchmarks for the configuration file, feed updates,
+ * filters, filenames and the catalog
+ * \param benchmark Collects the results.
+ * \param workDir A scratch directory for synthetic feeds and downloads.
+ */
+void benchFeeds(Benchmark& benchmark, const std::filesystem::path& workDir);
+
+#endif //BENCHMARKS_H
@@ -0,0 +1,66 @@
+/**
+ * \file dateparser.cpp
+ * \brief Benchmarks for DateParser
+ * \details Compares DateParser with the std::get_time() based parser that
+ * Episode used before.
+ */
+
+#include<iomanip>
+#include<sstream>
+#include<cstdio>
+#include<vector>
+#include<string>
+#include"dateparser.h"
+#include"benchmarks.h"
+
+/// The parser Episode used before DateParser
+static bool parseLegacy(const std::string& str, std::tm& tm)
+{
+	std::stringstream ss(str);
+	ss >> std::get_time(&tm, "%a, %d %b %Y %H:%M:%S");
+	return !ss.fail();
+}
+
+void benchDateParser(Benchmark& benchmark)
+{
+	// Dates in the format the old parser understands, and the variants found in the wild
+	static const char* const MONTHS[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+	static const char* const WEEKDAYS[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+	std::vector<std::string> rfc822, variants;
+	for(int i = 0; i < 10000; i++)
+	{
+		char buffer[64];
+		int day = i % 28 + 1, month = i % 12, year = 1995 + i % 30, hour = i % 24, minute = i % 60;
+		std::snprintf(buffer, sizeof(buffer), "%s, %02d %s %d %02d:%02d:%02d +0000", WEEKDAYS[i % 7], day, MONTHS[month], year, hour, minute, i % 60);
+		rfc822.push_back(buffer);
+		switch(i % 4)
+		{
+			case 0: std::snprintf(buffer, sizeof(buffer), "%d %s %02d %02d:%02d GMT", day, MONTHS[month], year % 100, hour, minute); break;
+			case 1: std::snprintf(buffer, sizeof(buffer), "%s, %d %s %d %02d:%02d:%02d PDT", WEEKDAYS[i % 7], day, MONTHS[month], year, hour, minute, i % 60); break;
+			case 2: std::snprintf(buffer, sizeof(buffer), "%d-%02d-%02dT%02d:%02d:%02d+02:00", year, month + 1, day, hour, minute, i % 60); break;
+			case 3: std::snprintf(buffer, sizeof(buffer), "%d-%02d-%02dT%02d:%02d:%02d.123Z", year, month + 1, day, hour, minute, i % 60); break;
+		}
+		variants.push_back(buffer);
+	}
+
+	benchmark.run("date/rfc822/get_time", rfc822.size(), [&]
+	{
+		std::tm tm;
+		for(const std::string& date : rfc822)
+			keep(parseLegacy(date, tm));
+	});
+	benchmark.run("date/rfc822/dateparser", rfc822.size(), [&]
+	{
+		std::tm tm;
+		std::time_t utc;
+		for(const std::string& date : rfc822)
+			keep(DateParser::parse(date.c_str(), tm, utc));
+	});
+	benchmark.run("date/variants/dateparser", variants.size(), [&]
+	{
+		std::tm tm;
+		std::time_t utc;
+		for(const std::string& date : variants)
+			keep(DateParser::parse(date.c_str(), tm, utc));
+	});
+}
@@ -0,0 +1,190 @@
+/**
+ * \file feeds.cpp
+ * \brief Benchmarks for the configuration file, feed updates, filters,
+ * filenames and the catalog
+ * \details Feeds are synthetic RSS documents in the scratch directory that are
+ * retrieved via file:// URIs, so no network is involved.
+ */
+
+#include<fstream>
+#include<string>
+#include<vector>
+#include<cstdio>
+#include"config.h"
+#include"feed.h"
+#include"filter.h"
+#include"placeholderpattern.h"
+#include"catalog.h"
+#include"benchmarks.h"
+
+/// Writes an RSS document with the given number of items
+static void writeFeed(const std::filesystem::path& path, int items)
+{
+	static const char* const MONTHS[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+	std::ofstream ofs(path);
+	ofs << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>" << std::endl
+		<< "<rss version=\"2.0\"><channel>" << std::endl
+		<< "<title>Benchmark Podcast</title>" << std::endl
+		<< "<description>A synthetic feed with " << items << " items</description>" << std::endl;
+	for(int i = items; i > 0; i--)
+	{
+		char date[64];
+		std::snprintf(date, sizeof(date), "%02d %s %d %02d:%02d:00 +0000", i % 28 + 1, MONTHS[i % 12], 2000 + i % 25, i % 24, i % 60);
+		ofs << "<item>"
+			<< "<title>Episode " << i << ": On the " << (i % 2 ? "performance" : "history") << " of things</title>"
+			<< "<description>In this episode, we talk about item number " << i << " at some length.</description>"
+			<< "<guid>urn:bench:" << i << "</guid>"
+			<< "<pubDate>Mon, " << date << "</pubDate>"
+			<< "<enclosure url=\"http://127.0.0.1/episodes/" << i << ".mp3\" length=\"1000\" type=\"audio/mpeg\"/>"
+			<< "</item>" << std::endl;
+	}
+	ofs << "</channel></rss>" << std::endl;
+}
+
+/// Filters as they are typically found in configuration files
+static std::vector<Filter> typicalFilters()
+{
+	return {
+		Filter(FilterType::EXCLUDE_IF_MATCH, ".*(Trailer|Teaser|Best of).*", "%T"),
+		Filter(FilterType::INCLUDE_IF_MATCH, "Episode [0-9]*[05]:.*", "%T"),
+		Filter(FilterType::EXCLUDE_IF_NOT_MATCH, "20(1[5-9]|2[0-9])-.*", "%Y-%m-%d %T")
+	};
+}
+
+/// Writes a configuration file with the given number of feeds
+static void writeConfig(const std::filesystem::path& path, int feeds)
+{
+	std::ofstream ofs(path);
+	ofs << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>" << std::endl
+		<< "<podlist max-downloads=\"8\" datadir=\"state\">" << std::endl;
+	for(int i = 0; i < feeds; i++)
+	{
+		ofs << "\t<feed uid=\"feed" << i << "\" uri=\"http://127.0.0.1/feed" << i << ".xml\" basedir=\"pods/feed" << i << "\" filename=\"%Y-%m-%d_%T\">" << std::endl
+			<< "\t\t<filter type=\"exclude-if-match\" regex=\".*(Trailer|Teaser).*\" match=\"%T\" />" << std::endl
+			<< "\t\t<filter type=\"include-if-match\" regex=\"Episode [0-9]+:.*\" match=\"%T\" />" << std::endl
+			<< "\t\t<filter type=\"exclude-if-not-match\" regex=\"20[0-9]{2}\" match=\"%Y\" />" << std::endl
+			<< "\t</feed>" << std::endl;
+	}
+	ofs << "</podlist>" << std::endl;
+}
+
+void benchFeeds(Benchmark& benchmark, const std::filesystem::path& workDir)
+{
+	// Configuration file
+	if(benchmark.selected("config/read"))
+	{
+		const int FEEDS = 200;
+		std::filesystem::path configFile = workDir / "jpodconf";
+		writeConfig(configFile, FEEDS);
+		benchmark.run("config/read", FEEDS, [&]
+		{
+			Options options;
+			keep(readConfigFile(configFile, options).size());
+		});
+	}
+	if(benchmark.selected("config/snapshot"))
+	{
+		// Startup of a command that needs a single feed
+		const int FEEDS = 3000;
+		std::filesystem::path configFile = workDir / "jpodconf-large";
+		writeConfig(configFile, FEEDS);
+		Config(configFile, workDir / "config.snapshot");
+		benchmark.run("config/snapshot", FEEDS, [&]
+		{
+			Config config(configFile, workDir / "config.snapshot");
+			keep(config.getFeed("feed1234").getUid().size());
+		});
+	}
+
+	// Retrieving and parsing feeds of different sizes
+	for(int items : {10, 1000, 50000})
+	{
+		std::string name = "feed/update/" + std::to_string(items);
+		if(!benchmark.selected(name))
+			continue;
+		std::filesystem::path document = workDir / ("feed" + std::to_string(items) + ".xml");
+		writeFeed(document, items);
+		Feed feed(name, "file://" + document.string(), workDir / "pods", "%Y-%m-%d_%T", workDir / "state" / std::to_string(items), 1, typicalFilters());
+		benchmark.run(name, items, [&]
+		{
+			feed.update();
+			keep(feed.getEpisodes().size());
+		});
+	}
+
+	// Writing the catalog of a large feed and answering queries from it
+	if(benchmark.selected("catalog/"))
+	{
+		const int CATALOG_ITEMS = 20000;
+		std::filesystem::path catalogDocument = workDir / "catalog.xml";
+		writeFeed(catalogDocument, CATALOG_ITEMS);
+		Feed catalogFeed("catalog", "file://" + catalogDocument.string(), workDir / "pods", "%Y-%m-%d_%T", workDir / "state" / "catalog", 1);
+		catalogFeed.update();
+		benchmark.run("catalog/write", CATALOG_ITEMS, [&]
+		{
+			catalogFeed.updateCatalog();
+		});
+		benchmark.run("catalog/open", 1, [&]
+		{
+			Catalog catalog(catalogFeed.getCatalogPath());
+			keep(catalog.size());
+		});
+		Catalog catalog(catalogFeed.getCatalogPath());
+		benchmark.run("catalog/search/word", 1, [&]
+		{
+			keep(catalog.search("history").size());
+		});
+		benchmark.run("catalog/search/prefixes", 1, [&]
+		{
+			keep(catalog.search("perf item 1234").size());
+		});
+	}
+
+	// Per-episode work, on the episodes of a feed without filters
+	if(!benchmark.selected("episode/") && !benchmark.selected("filter/"))
+		return;
+	const int ITEMS = 1000;
+	std::filesystem::path document = workDir / "episodes.xml";
+	writeFeed(document, ITEMS);
+	Feed feed("episodes", "file://" + document.string(), workDir / "pods", "%Y-%m-%d_%T", workDir / "state" / "episodes", 1);
+	feed.update();
+	const std::vector<Episode>& episodes = feed.getEpisodes();
+	const std::string pattern = "%P/%Y-%m-%d_%T";
+
+	benchmark.run("episode/fillPlaceholders", episodes.size(), [&]
+	{
+		for(const Episode& episode : episodes)
+			keep(episode.fillPlaceholders(pattern));
+	});
+	PlaceholderPattern compiled(pattern);
+	benchmark.run("episode/fillPlaceholders/precompiled", episodes.size(), [&]
+	{
+		std::string filename;
+		for(const Episode& episode : episodes)
+		{
+			filename.clear();
+			compiled.fill(episode, filename);
+			keep(filename);
+		}
+	});
+	std::vector<std::string> filenames;
+	for(const Episode& episode : episodes)
+		filenames.push_back(compiled.fill(episode) + " <\"weird\"> *characters*?");
+	benchmark.run("episode/cleanupFilename", filenames.size(), [&]
+	{
+		std::string filename;
+		for(const std::string& name : filenames)
+		{
+			filename = name;
+			Feed::cleanupFilename(filename);
+			keep(filename);
+		}
+	});
+	std::vector<Filter> filters = typicalFilters();
+	benchmark.run("filter/apply", episodes.size() * filters.size(), [&]
+	{
+		for(const Episode& episode : episodes)
+			for(const Filter& filter : filters)
+				keep(filter.apply(episode));
+	});
+}
@@ -0,0 +1,304 @@
+/**
+ * \file loadserver.cpp
+ * \brief Implementation for loadserver.h
+ */
+
+#include<stdexcept>
+#include<chrono>
+#include<algorithm>
+#include<cctype>
+#include<cstring>
+#include<cstdio>
+#include<cinttypes>
+#include<sys/socket.h>
+#include<netinet/in.h>
+#include<netinet/tcp.h>
+#include<arpa/inet.h>
+#include<poll.h>
+#include<unistd.h>
+#include"loadserver.h"
+
+/// Reads a decimal number and advances p behind it
+static bool readNumber(const char*& p, unsigned& value)
+{
+	const char* start = p;
+	value = 0;
+	while(*p >= '0' && *p <= '9')
+		value = value * 10 + (*p++ - '0');
+	return p > start;
+}
+
+LoadServer::LoadServer(const LoadProfile& profile)
+: profile(profile), port(0), stopping(false), activeConnections(0), random(profile.seed), requests(0), errors(0), redirects(0), stalls(0), bytesSent(0)
+{
+	// One listening socket per host, all on the same port
+	for(unsigned host = 1; host <= profile.hosts; host++)
+	{
+		int fd = socket(AF_INET, SOCK_STREAM, 0);
+		if(fd < 0)
+			throw std::runtime_error("Unable to create socket");
+		listeners.push_back(fd);
+		int one = 1;
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+		sockaddr_in addr = {};
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(0x7F000000 + host);
+		addr.sin_port = htons(port);
+		if(bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 128) != 0)
+		{
+			for(int listener : listeners)
+				close(listener);
+			throw std::runtime_error("Unable to listen on 127.0.0." + std::to_string(host) + ": " + std::strerror(errno));
+		}
+		if(port == 0)
+		{
+			socklen_t length = sizeof(addr);
+			getsockname(fd, (sockaddr*)&addr, &length);
+			port = ntohs(addr.sin_port);
+		}
+	}
+
+	// Dead hosts listen with a tiny backlog that is never accepted from, so connections hang or time out
+	for(unsigned host = 1; host <= std::min(profile.deadHosts, profile.hosts); host++)
+	{
+		int fd = socket(AF_INET, SOCK_STREAM, 0);
+		if(fd < 0)
+			continue;
+		deadListeners.push_back(fd);
+		int one = 1;
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+		sockaddr_in addr = {};
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(0x7F000100 + host);
+		addr.sin_port = htons(port);
+		if(bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 1) != 0)
+		{
+			for(int listener : listeners)
+				close(listener);
+			for(int listener : deadListeners)
+				close(listener);
+			throw std::runtime_error("Unable to listen on 127.0.1." + std::to_string(host) + ": " + std::strerror(errno));
+		}
+	}
+	acceptThread = std::thread(&LoadServer::acceptConnections, this);
+}
+
+LoadServer::~LoadServer()
+{
+	stopping = true;
+	acceptThread.join();
+	for(int fd : listeners)
+		close(fd);
+	for(int fd : deadListeners)
+		close(fd);
+	while(activeConnections > 0)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+}
+
+std::string LoadServer::feedUri(unsigned feed) const
+{
+	return "http://127.0.0." + std::to_string(feed % profile.hosts + 1) + ":" + std::to_string(port) + "/feed" + std::to_string(feed) + ".xml";
+}
+
+void LoadServer::acceptConnections()
+{
+	std::vector<pollfd> fds;
+	for(int fd : listeners)
+		fds.push_back({fd, POLLIN, 0});
+	while(!stopping)
+	{
+		if(poll(fds.data(), fds.size(), 100) <= 0)
+			continue;
+		for(pollfd& p : fds)
+		{
+			if(!(p.revents & POLLIN))
+				continue;
+			int fd = accept(p.fd, NULL, NULL);
+			if(fd < 0)
+				continue;
+			int one = 1;
+			setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+			activeConnections++;
+			std::thread(&LoadServer::serve, this, fd).detach();
+		}
+	}
+}
+
+bool LoadServer::decide(double probability)
+{
+	if(probability <= 0)
+		return false;
+	std::lock_guard<std::mutex> lock(randomMutex);
+	return std::uniform_real_distribution<double>(0, 1)(random) < probability;
+}
+
+std::string LoadServer::feedDocument(unsigned feed) const
+{
+	bool dead = feed % profile.hosts < profile.deadHosts;
+	std::string host = (dead ? "http://127.0.1." : "http://127.0.0.") + std::to_string(feed % profile.hosts + 1) + ":" + std::to_string(port);
+	std::string document = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<rss version=\"2.0\"><channel>\n"
+		"<title>Load Test Feed " + std::to_string(feed) + "</title>\n<description>Served by jpod's load test</description>\n";
+	for(unsigned episode = profile.episodes; episode > 0; episode--)
+	{
+		char date[64];
+		std::snprintf(date, sizeof(date), "%02u Jan 2024 %02u:%02u:00 +0000", episode % 28 + 1, episode % 24, episode % 60);
+		std::string id = std::to_string(feed) + "/ep" + std::to_string(episode);
+		document += "<item><title>Episode " + std::to_string(episode) + "</title><description>Episode " + id + "</description>"
+			"<guid>urn:load:" + id + "</guid><pubDate>" + date + "</pubDate>"
+			"<enclosure url=\"" + host + "/feed" + id + ".mp3\" length=\"" + std::to_string(profile.episodeSize) + "\" type=\"audio/mpeg\"/></item>\n";
+	}
+	document += "</channel></rss>\n";
+	return document;
+}
+
+bool LoadServer::sendAll(int fd, const char* data, std::size_t size, bool throttle)
+{
+	const std::size_t CHUNK = 16 * 1024;
+	auto start = std::chrono::steady_clock::now();
+	std::size_t sent = 0;
+	while(sent < size)
+	{
+		ssize_t n = send(fd, data + sent, std::min(CHUNK, size - sent), MSG_NOSIGNAL);
+		if(n <= 0)
+			return false;
+		sent += n;
+		if(throttle && profile.bandwidth > 0)
+			std::this_thread::sleep_until(start + std::chrono::microseconds(sent * 1000000 / (profile.bandwidth * 1024ULL)));
+	}
+	return true;
+}
+
+void LoadServer::serve(int fd)
+{
+	static const std::string PAYLOAD(64 * 1024, 'J');
+	std::string buffer;
+	bool keepAlive = true;
+	while(keepAlive && !stopping)
+	{
+		// Read the request head
+		std::size_t end;
+		while((end = buffer.find("\r\n\r\n")) == std::string::npos)
+		{
+			pollfd p = {fd, POLLIN, 0};
+			if(stopping)
+				break;
+			if(poll(&p, 1, 100) == 0)
+				continue;
+			char chunk[4096];
+			ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+			if(n <= 0)
+				break;
+			buffer.append(chunk, n);
+		}
+		if(end == std::string::npos)
+			break;
+		std::string head = buffer.substr(0, end);
+		buffer.erase(0, end + 4);
+		requests++;
+		char method[16], target[1024];
+		if(std::sscanf(head.c_str(), "%15s %1023s", method, target) != 2)
+			break;
+		std::string lowerHead = head;
+		for(char& c : lowerHead)
+			c = std::tolower(c);
+		keepAlive = lowerHead.find("connection: close") == std::string::npos;
+		std::string path = target, query;
+		if(path.find('?') != std::string::npos)
+		{
+			query = path.substr(path.find('?') + 1);
+			path = path.substr(0, path.find('?'));
+		}
+
+		if(profile.latency > 0)
+			std::this_thread::sleep_for(std::chrono::milliseconds(profile.latency));
+
+		// Misbehave
+		std::string response;
+		if(query.empty() && decide(profile.redirectRate))
+		{
+			redirects++;
+			response = "HTTP/1.1 302 Found\r\nLocation: " + path + "?redirected\r\nContent-Length: 0\r\n\r\n";
+			if(!sendAll(fd, response.data(), response.size(), false))
+				break;
+			continue;
+		}
+		if(decide(profile.errorRate))
+		{
+			// Half of the failures come with an error page, like those of most real servers
+			static const std::string page = "<html><body><h1>503 Service Unavailable</h1>Try again later.</body></html>";
+			if(errors++ % 2)
+				response = "HTTP/1.1 503 Service Unavailable\r\nContent-Type: text/html\r\nContent-Length: " + std::to_string(page.size()) + "\r\n\r\n" + page;
+			else
+				response = "HTTP/1.1 500 Internal Server Error\r\nContent-Length: 0\r\n\r\n";
+			if(!sendAll(fd, response.data(), response.size(), false))
+				break;
+			continue;
+		}
+
+		// Serve feeds (/feedN.xml) and episodes (/feedN/epM.mp3)
+		unsigned feed = 0, episode = 0;
+		const char* p = path.c_str();
+		bool isFeed = false, isEpisode = false;
+		if(std::strncmp(p, "/feed", 5) == 0 && readNumber(p += 5, feed) && feed < profile.feeds)
+		{
+			isFeed = std::strcmp(p, ".xml") == 0;
+			isEpisode = std::strncmp(p, "/ep", 3) == 0 && readNumber(p += 3, episode) && std::strcmp(p, ".mp3") == 0 && episode >= 1 && episode <= profile.episodes;
+		}
+		if(isEpisode)
+		{
+			// Episodes never change, so ranges are served whatever If-Range says
+			std::uint64_t size = profile.episodeSize, first = 0, last = size - 1;
+			bool stall = decide(profile.stallRate);
+			std::size_t range = lowerHead.find("\r\nrange: bytes=");
+			if(range != std::string::npos && std::sscanf(lowerHead.c_str() + range + 15, "%" SCNu64 "-%" SCNu64, &first, &last) >= 1 && first < size)
+			{
+				last = std::min(last, size - 1);
+				response = "HTTP/1.1 206 Partial Content\r\nContent-Range: bytes " + std::to_string(first) + "-" + std::to_string(last) + "/" + std::to_string(size) + "\r\n";
+			}
+			else
+			{
+				first = 0;
+				last = size - 1;
+				response = "HTTP/1.1 200 OK\r\n";
+			}
+			size = last + 1 - first;
+			response += "Content-Type: audio/mpeg\r\nAccept-Ranges: bytes\r\nETag: \"load\"\r\nContent-Length: " + std::to_string(size) + "\r\n\r\n";
+			if(!sendAll(fd, response.data(), response.size(), false))
+				break;
+			std::uint64_t sent = 0, limit = stall ? size / 2 : size;
+			bool ok = true;
+			while(ok && sent < limit)
+			{
+				std::size_t n = std::min<std::uint64_t>(PAYLOAD.size(), limit - sent);
+				ok = sendAll(fd, PAYLOAD.data(), n, true);
+				sent += n;
+				bytesSent += n;
+			}
+			if(!ok)
+				break;
+			if(stall)
+			{
+				// Go silent, then cut the connection off
+				stalls++;
+				std::this_thread::sleep_for(std::chrono::milliseconds(profile.stallTime));
+				break;
+			}
+			continue;
+		}
+		if(isFeed)
+		{
+			std::string document = feedDocument(feed);
+			response = "HTTP/1.1 200 OK\r\nContent-Type: application/rss+xml\r\nContent-Length: " + std::to_string(document.size()) + "\r\n\r\n" + document;
+			bytesSent += document.size();
+			if(!sendAll(fd, response.data(), response.size(), true))
+				break;
+			continue;
+		}
+		errors++;
+		response = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+		if(!sendAll(fd, response.data(), response.size(), false))
+			break;
+	}
+	close(fd);
+	activeConnections--;
+}
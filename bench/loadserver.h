@@ -0,0 +1,111 @@
+/**
+ * \file loadserver.h
+ * \brief Defines the LoadServer class and the LoadProfile structure
+ */
+
+#ifndef LOADSERVER_H
+#define LOADSERVER_H
+
+#include<string>
+#include<vector>
+#include<atomic>
+#include<thread>
+#include<mutex>
+#include<random>
+#include<cstdint>
+
+/**
+ * \brief Describes the feeds a LoadServer serves and how badly it behaves
+ */
+struct LoadProfile
+{
+	/// Number of feeds
+	unsigned feeds = 20;
+	/// Number of hosts (loopback addresses 127.0.0.1, 127.0.0.2, ...) the feeds are spread over
+	unsigned hosts = 4;
+	/// Number of episodes per feed
+	unsigned episodes = 10;
+	/// Size of each episode in bytes
+	std::uint64_t episodeSize = 1024 * 1024;
+	/// Delay before each response in milliseconds
+	unsigned latency = 0;
+	/// Bandwidth per connection in KiB/s, 0 means unlimited
+	unsigned bandwidth = 0;
+	/// Fraction of requests that fail, alternately with an empty 500 Internal Server Error and a 503 Service Unavailable error page
+	double errorRate = 0;
+	/// Fraction of requests that are redirected (302) before being answered
+	double redirectRate = 0;
+	/// Fraction of episode downloads that stall halfway and are then cut off
+	double stallRate = 0;
+	/// How long a stalled connection stays silent in milliseconds
+	unsigned stallTime = 2000;
+	/// Number of hosts whose episodes are served from a dead host instead, which accepts connections but never answers
+	unsigned deadHosts = 0;
+	/// Seed for deciding which requests fail, redirect or stall
+	unsigned seed = 1;
+};
+
+/**
+ * \brief A loopback HTTP server that stands in for podcast hosts
+ * \details Serves synthetic RSS feeds (`/feedN.xml`) and episodes
+ * (`/feedN/epM.mp3`) as described by a LoadProfile. Feed N and its episodes
+ * are served by host 127.0.0.H with H = N % hosts + 1, so downloads are spread
+ * over several hosts like in real life. Each connection is handled by its own
+ * thread and supports keep-alive. Episodes can be requested in ranges.
+ * The episodes of the first LoadProfile#deadHosts hosts are moved to
+ * 127.0.1.H, where connections are never accepted.
+ */
+class LoadServer
+{
+private:
+	LoadProfile profile;
+	std::vector<int> listeners, deadListeners;
+	unsigned short port;
+	std::thread acceptThread;
+	std::atomic<bool> stopping;
+	std::atomic<unsigned> activeConnections;
+	std::mutex randomMutex;
+	std::mt19937 random;
+
+	void acceptConnections();
+	void serve(int fd);
+	bool decide(double probability);
+	std::string feedDocument(unsigned feed) const;
+	bool sendAll(int fd, const char* data, std::size_t size, bool throttle);
+public:
+	/// Number of requests received
+	std::atomic<std::uint64_t> requests;
+	/// Number of requests answered with an error
+	std::atomic<std::uint64_t> errors;
+	/// Number of requests that were redirected
+	std::atomic<std::uint64_t> redirects;
+	/// Number of connections that were stalled and cut off
+	std::atomic<std::uint64_t> stalls;
+	/// Number of body bytes sent
+	std::atomic<std::uint64_t> bytesSent;
+
+	/**
+	 * \brief Starts the server
+	 * \param profile Describes what to serve and how.
+	 * \throws std::runtime_error If the listening sockets could not be set up.
+	 */
+	LoadServer(const LoadProfile& profile);
+
+	/**
+	 * \brief Stops the server
+	 * \details Waits for the connections that are still open to finish.
+	 */
+	~LoadServer();
+
+	LoadServer(const LoadServer&) = delete;
+	LoadServer& operator=(const LoadServer&) = delete;
+
+	/**
+	 * \brief Returns the URI of a feed
+	 * \param feed The number of the feed.
+	 * \return The http:// URI of the feed.
+	 */
+	std::string feedUri(unsigned feed) const;
+};
+
+#endif //LOADSERVER_H
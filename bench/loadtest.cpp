@@ -0,0 +1,313 @@
+/**
+ * \file loadtest.cpp
+ * \brief Implements the main() function of the end-to-end load test
+ * \details Usage: loadtest [OPTION=VALUE ...]
+ *
+ * Starts a LoadServer, generates a configuration file with its feeds in a
+ * scratch home directory and runs `jpod update` against it. Reports wall time,
+ * CPU time, peak RSS (from wait4()), the number and size of the downloaded
+ * episodes and, if strace is installed, the number of system calls. System
+ * calls are counted in a second run, since tracing slows jpod down
+ * considerably. Run `loadtest --help` for the options, or `make bench-load`.
+ */
+
+#include<iostream>
+#include<iomanip>
+#include<fstream>
+#include<sstream>
+#include<filesystem>
+#include<string>
+#include<vector>
+#include<map>
+#include<algorithm>
+#include<chrono>
+#include<cstdlib>
+#include<cstring>
+#include<fcntl.h>
+#include<unistd.h>
+#include<sys/wait.h>
+#include<sys/resource.h>
+#include"loadserver.h"
+
+/**
+ * \brief The outcome of one run of jpod
+ */
+struct RunResult
+{
+	int exitCode = -1;
+	double wallTime = 0, userTime = 0, systemTime = 0;
+	long peakRss = 0; // KiB
+	std::uint64_t episodes = 0, bytes = 0;
+	std::map<std::string, std::uint64_t> syscalls; // Empty if not traced
+	std::uint64_t totalSyscalls = 0;
+};
+
+static void printHelp()
+{
+	std::cout
+		<< "Usage: loadtest [OPTION=VALUE ...]" << std::endl
+		<< std::endl
+		<< "Scenario:" << std::endl
+		<< "  --feeds=N              Number of feeds (20)." << std::endl
+		<< "  --hosts=N              Number of hosts the feeds are spread over (4)." << std::endl
+		<< "  --episodes=N           Episodes per feed (10)." << std::endl
+		<< "  --size=BYTES           Size of each episode (1048576)." << std::endl
+		<< "  --latency=MS           Delay before each response (0)." << std::endl
+		<< "  --bandwidth=KIB        Bandwidth per connection in KiB/s, 0 is unlimited (0)." << std::endl
+		<< "  --error-rate=P         Fraction of requests that fail with 500 or 503 (0)." << std::endl
+		<< "  --redirect-rate=P      Fraction of requests that are redirected (0)." << std::endl
+		<< "  --stall-rate=P         Fraction of downloads that stall and are cut off (0)." << std::endl
+		<< "  --stall-time=MS        How long stalled connections stay silent (2000)." << std::endl
+		<< "  --dead-hosts=N         Number of hosts whose episodes are on a host that never" << std::endl
+		<< "                         answers (0)." << std::endl
+		<< "  --seed=N               Seed for the misbehaviour (1)." << std::endl
+		<< std::endl
+		<< "jpod:" << std::endl
+		<< "  --jpod=PATH            The jpod binary (./jpod)." << std::endl
+		<< "  --max-downloads=N      Passed to jpod via the configuration file." << std::endl
+		<< "  --max-downloads-per-host=N" << std::endl
+		<< "  --max-rate=KIB" << std::endl
+		<< "  --update-threads=N" << std::endl
+		<< "  --fsync=none|episode|run" << std::endl
+		<< "  --segments=N" << std::endl
+		<< "  --segment-threshold=MIB" << std::endl
+		<< "  --connect-timeout=S" << std::endl
+		<< "  --stall-timeout=S" << std::endl
+		<< "  --feed-timeout=S" << std::endl
+		<< "  --download-timeout=S" << std::endl
+		<< "  --retries=N" << std::endl
+		<< "  --retry-delay=S" << std::endl
+		<< "  --breaker-threshold=N" << std::endl
+		<< "  --breaker-cooldown=MIN" << std::endl
+		<< "  --strace=yes|no        Count system calls if strace is installed (yes)." << std::endl
+		<< "  --json=FILE            Also write the results to FILE as JSON." << std::endl;
+}
+
+/// Searches the PATH for a program
+static std::string findProgram(const std::string& name)
+{
+	const char* path = getenv("PATH");
+	std::istringstream iss(path ? path : "");
+	std::string dir;
+	while(std::getline(iss, dir, ':'))
+	{
+		std::filesystem::path candidate = std::filesystem::path(dir) / name;
+		if(access(candidate.c_str(), X_OK) == 0)
+			return candidate;
+	}
+	return "";
+}
+
+/// Writes the configuration file for jpod into the scratch home directory
+static void writeConfig(const std::filesystem::path& home, const LoadServer& server, const LoadProfile& profile, const std::map<std::string, std::string>& podlistAttributes)
+{
+	std::ofstream ofs(home / ".jpodconf");
+	ofs << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>" << std::endl << "<podlist datadir=\".jpod\"";
+	for(const auto& attribute : podlistAttributes)
+		ofs << " " << attribute.first << "=\"" << attribute.second << "\"";
+	ofs << ">" << std::endl;
+	for(unsigned feed = 0; feed < profile.feeds; feed++)
+		ofs << "\t<feed uid=\"feed" << feed << "\" uri=\"" << server.feedUri(feed) << "\" basedir=\"pods/feed" << feed << "\" />" << std::endl;
+	ofs << "</podlist>" << std::endl;
+}
+
+/// Runs jpod update (optionally under strace) with the scratch home directory
+static RunResult run(const std::string& jpod, const std::filesystem::path& home, const std::string& strace)
+{
+	RunResult result;
+	std::filesystem::remove_all(home / "pods");
+	std::filesystem::remove_all(home / ".jpod");
+	std::filesystem::path traceFile = home / "strace.txt", logFile = home / "jpod.log";
+
+	auto start = std::chrono::steady_clock::now();
+	pid_t pid = fork();
+	if(pid < 0)
+		throw std::runtime_error("Unable to fork");
+	if(pid == 0)
+	{
+		setenv("HOME", home.c_str(), 1);
+		int log = open(logFile.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+		dup2(log, 1);
+		dup2(log, 2);
+		if(strace.empty())
+			execl(jpod.c_str(), jpod.c_str(), "update", (char*)NULL);
+		else
+			execl(strace.c_str(), strace.c_str(), "-f", "-c", "-o", traceFile.c_str(), jpod.c_str(), "update", (char*)NULL);
+		_exit(127);
+	}
+	int status;
+	rusage usage;
+	wait4(pid, &status, 0, &usage);
+	result.wallTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	result.exitCode = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+	result.userTime = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6;
+	result.systemTime = usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+	result.peakRss = usage.ru_maxrss;
+
+	// Count what arrived (files in .partial are unfinished)
+	std::error_code ec;
+	for(auto it = std::filesystem::recursive_directory_iterator(home / "pods", ec); !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec))
+	{
+		if(it->is_directory() && it->path().filename() == ".partial")
+			it.disable_recursion_pending();
+		else if(it->is_regular_file())
+		{
+			result.episodes++;
+			result.bytes += it->file_size();
+		}
+	}
+
+	// Summary of strace -c: "% time seconds usecs/call calls [errors] syscall"
+	std::ifstream trace(traceFile);
+	std::string line;
+	while(std::getline(trace, line))
+	{
+		std::istringstream iss(line);
+		std::vector<std::string> fields;
+		std::string field;
+		while(iss >> field)
+			fields.push_back(field);
+		if(fields.size() < 5 || fields[0].find_first_not_of("0123456789.") != std::string::npos)
+			continue;
+		std::uint64_t calls = std::strtoull(fields[3].c_str(), NULL, 10);
+		if(fields.back() == "total")
+			result.totalSyscalls = calls;
+		else
+			result.syscalls[fields.back()] = calls;
+	}
+	std::filesystem::remove(traceFile, ec);
+	return result;
+}
+
+int main(int argc, char** argv)
+{
+	LoadProfile profile;
+	std::string jpod = "./jpod", jsonFile;
+	bool useStrace = true;
+	std::map<std::string, std::string> podlistAttributes;
+	for(int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if(arg == "--help" || arg == "-h")
+		{
+			printHelp();
+			return 0;
+		}
+		std::size_t eq = arg.find('=');
+		if(arg.compare(0, 2, "--") != 0 || eq == std::string::npos)
+		{
+			std::cerr << "Invalid argument " << arg << ", see --help" << std::endl;
+			return 1;
+		}
+		std::string name = arg.substr(2, eq - 2), value = arg.substr(eq + 1);
+		if(name == "feeds") profile.feeds = std::stoul(value);
+		else if(name == "hosts") profile.hosts = std::max(1UL, std::min(254UL, std::stoul(value)));
+		else if(name == "episodes") profile.episodes = std::stoul(value);
+		else if(name == "size") profile.episodeSize = std::stoull(value);
+		else if(name == "latency") profile.latency = std::stoul(value);
+		else if(name == "bandwidth") profile.bandwidth = std::stoul(value);
+		else if(name == "error-rate") profile.errorRate = std::stod(value);
+		else if(name == "redirect-rate") profile.redirectRate = std::stod(value);
+		else if(name == "stall-rate") profile.stallRate = std::stod(value);
+		else if(name == "stall-time") profile.stallTime = std::stoul(value);
+		else if(name == "dead-hosts") profile.deadHosts = std::stoul(value);
+		else if(name == "seed") profile.seed = std::stoul(value);
+		else if(name == "jpod") jpod = value;
+		else if(name == "strace") useStrace = value == "yes";
+		else if(name == "json") jsonFile = value;
+		else if(name == "max-downloads" || name == "max-downloads-per-host" || name == "max-rate" || name == "update-threads" || name == "fsync" || name == "segments" || name == "segment-threshold"
+			|| name == "connect-timeout" || name == "stall-timeout" || name == "feed-timeout" || name == "download-timeout" || name == "retries" || name == "retry-delay" || name == "breaker-threshold" || name == "breaker-cooldown")
+			podlistAttributes[name] = value;
+		else
+		{
+			std::cerr << "Unknown option --" << name << ", see --help" << std::endl;
+			return 1;
+		}
+	}
+	jpod = std::filesystem::absolute(jpod);
+	std::string strace = useStrace ? findProgram("strace") : "";
+
+	std::filesystem::path home = std::filesystem::temp_directory_path() / ("jpodload-" + std::to_string(getpid()));
+	std::filesystem::create_directories(home);
+	RunResult result;
+	std::uint64_t requests, errors, redirects, stalls, bytesSent;
+	try
+	{
+		LoadServer server(profile);
+		writeConfig(home, server, profile, podlistAttributes);
+		result = run(jpod, home, "");
+		requests = server.requests;
+		errors = server.errors;
+		redirects = server.redirects;
+		stalls = server.stalls;
+		bytesSent = server.bytesSent;
+		if(!strace.empty())
+		{
+			RunResult traced = run(jpod, home, strace);
+			result.syscalls = traced.syscalls;
+			result.totalSyscalls = traced.totalSyscalls;
+		}
+	}
+	catch(std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		std::filesystem::remove_all(home);
+		return 1;
+	}
+	std::filesystem::remove_all(home);
+
+	// Report
+	double throughput = result.bytes / result.wallTime / (1024 * 1024);
+	std::cout << std::fixed << std::setprecision(3)
+		<< "Scenario:      " << profile.feeds << " feeds on " << profile.hosts << " hosts, " << profile.episodes << " episodes of " << profile.episodeSize << " bytes each" << std::endl
+		<< "Server:        " << requests << " requests, " << errors << " errors, " << redirects << " redirects, " << stalls << " stalls, " << bytesSent << " bytes sent" << std::endl
+		<< "Exit code:     " << result.exitCode << std::endl
+		<< "Wall time:     " << result.wallTime << " s" << std::endl
+		<< "CPU time:      " << result.userTime << " s user, " << result.systemTime << " s system" << std::endl
+		<< "Peak RSS:      " << result.peakRss << " KiB" << std::endl
+		<< "Downloaded:    " << result.episodes << " episodes, " << result.bytes << " bytes" << std::endl
+		<< "Throughput:    " << throughput << " MiB/s" << std::endl;
+	if(strace.empty())
+		std::cout << "System calls:  not counted (strace is not available)" << std::endl;
+	else
+	{
+		std::cout << "System calls:  " << result.totalSyscalls << std::endl;
+		std::vector<std::pair<std::uint64_t, std::string>> top;
+		for(const auto& syscall : result.syscalls)
+			top.push_back({syscall.second, syscall.first});
+		std::sort(top.rbegin(), top.rend());
+		for(std::size_t i = 0; i < top.size() && i < 10; i++)
+			std::cout << "  " << std::left << std::setw(20) << top[i].second << std::right << top[i].first << std::endl;
+	}
+
+	if(!jsonFile.empty())
+	{
+		std::ofstream ofs(jsonFile);
+		ofs << std::setprecision(6)
+			<< "{" << std::endl
+			<< "  \"scenario\": {\"feeds\": " << profile.feeds << ", \"hosts\": " << profile.hosts << ", \"episodes\": " << profile.episodes
+			<< ", \"episode_size\": " << profile.episodeSize << ", \"latency_ms\": " << profile.latency << ", \"bandwidth_kib\": " << profile.bandwidth
+			<< ", \"error_rate\": " << profile.errorRate << ", \"redirect_rate\": " << profile.redirectRate << ", \"stall_rate\": " << profile.stallRate << ", \"dead_hosts\": " << profile.deadHosts << "}," << std::endl
+			<< "  \"server\": {\"requests\": " << requests << ", \"errors\": " << errors << ", \"redirects\": " << redirects << ", \"stalls\": " << stalls << ", \"bytes_sent\": " << bytesSent << "}," << std::endl
+			<< "  \"exit_code\": " << result.exitCode << "," << std::endl
+			<< "  \"wall_seconds\": " << result.wallTime << "," << std::endl
+			<< "  \"user_seconds\": " << result.userTime << "," << std::endl
+			<< "  \"system_seconds\": " << result.systemTime << "," << std::endl
+			<< "  \"peak_rss_kib\": " << result.peakRss << "," << std::endl
+			<< "  \"episodes\": " << result.episodes << "," << std::endl
+			<< "  \"bytes\": " << result.bytes << "," << std::endl
+			<< "  \"throughput_mib_per_second\": " << throughput << "," << std::endl
+			<< "  \"syscalls\": ";
+		if(strace.empty())
+			ofs << "null" << std::endl;
+		else
+		{
+			ofs << "{\"total\": " << result.totalSyscalls;
+			for(const auto& syscall : result.syscalls)
+				ofs << ", \"" << syscall.first << "\": " << syscall.second;
+			ofs << "}" << std::endl;
+		}
+		ofs << "}" << std::endl;
+	}
+	return 0;
+}
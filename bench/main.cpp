@@ -0,0 +1,62 @@
+/**
+ * \file main.cpp
+ * \brief Implements the main() function of the benchmark suite
+ * \details Usage: jpodbench [--json=FILE] [FILTER]
+ *
+ * Runs all benchmarks whose name contains FILTER, prints the results and,
+ * with --json, also writes them to FILE as JSON so they can be compared
+ * between versions. Run with `make bench`.
+ */
+
+#include<iostream>
+#include<fstream>
+#include<string>
+#include<cstdlib>
+#include<unistd.h>
+#include"transfercontext.h"
+#include"benchmarks.h"
+
+int main(int argc, char** argv)
+{
+	std::string jsonFile, filter;
+	for(int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if(arg.compare(0, 7, "--json=") == 0)
+			jsonFile = arg.substr(7);
+		else
+			filter = arg;
+	}
+
+	// Feeds need a home directory and a place to store their state
+	std::filesystem::path workDir = std::filesystem::temp_directory_path() / ("jpodbench-" + std::to_string(getpid()));
+	std::filesystem::create_directories(workDir);
+	setenv("HOME", workDir.c_str(), 1);
+	TransferContext::get();
+
+	Benchmark benchmark(filter);
+	try
+	{
+		benchDateParser(benchmark);
+		benchFeeds(benchmark, workDir);
+	}
+	catch(std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		std::filesystem::remove_all(workDir);
+		return 1;
+	}
+	std::filesystem::remove_all(workDir);
+
+	if(!jsonFile.empty())
+	{
+		std::ofstream ofs(jsonFile);
+		benchmark.writeJson(ofs);
+		if(!ofs.good())
+		{
+			std::cerr << "Unable to write " << jsonFile << std::endl;
+			return 1;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,297 @@
+/**
+ * \file catalog.cpp
+ * \brief Implementation for catalog.h
+ */
+
+#include<stdexcept>
+#include<cstring>
+#include<fstream>
+#include<algorithm>
+#include<iterator>
+#include<cctype>
+#include<unordered_map>
+#include<fcntl.h>
+#include<unistd.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include"catalog.h"
+
+// Layout of the catalog file, followed by the episode records, the token records, the postings and the strings
+struct CatalogHeader
+{
+	char magic[8];
+	std::int64_t updateTime;
+	std::uint64_t stringBytes;
+	std::uint32_t episodeCount, tokenCount, postingCount;
+	std::uint32_t titleOffset, titleLength, descriptionOffset, descriptionLength;
+	std::uint32_t reserved;
+};
+
+static const char catalogMagic[8] = {'J', 'P', 'O', 'D', 'C', 'A', 'T', '1'};
+
+/// Longer words are cut to this many bytes, in the catalog as well as in queries
+static const std::size_t MAX_WORD = 64;
+
+std::tm CatalogEpisode::getPubDate() const
+{
+	std::time_t local = pubTime + utcOffset;
+	std::tm date;
+	gmtime_r(&local, &date);
+	return date;
+}
+
+Catalog::Catalog(const std::filesystem::path& filename)
+: mapping(NULL), mappingSize(0), updateTime(0), title{0, 0}, description{0, 0}, episodes(NULL), tokens(NULL), postings(NULL), strings(NULL), episodeCount(0), tokenCount(0), postingCount(0), stringBytes(0)
+{
+	load(filename);
+}
+
+Catalog::~Catalog()
+{
+	unmap();
+}
+
+void Catalog::load(const std::filesystem::path& filename)
+{
+	int fd = open(filename.c_str(), O_RDONLY);
+	if(fd < 0)
+		return;
+	struct stat st;
+	if(fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(CatalogHeader))
+	{
+		void* m = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		if(m != MAP_FAILED)
+		{
+			mapping = m;
+			mappingSize = st.st_size;
+		}
+	}
+	close(fd);
+	if(!mapping)
+		return;
+
+	// Check that the sections add up to the size of the file
+	const CatalogHeader* header = (const CatalogHeader*)mapping;
+	std::uint64_t size = sizeof(CatalogHeader) + (std::uint64_t)header->episodeCount * sizeof(EpisodeRecord) + (std::uint64_t)header->tokenCount * sizeof(TokenRecord) + (std::uint64_t)header->postingCount * sizeof(std::uint32_t);
+	if(std::memcmp(header->magic, catalogMagic, sizeof(catalogMagic)) != 0 || size > mappingSize || mappingSize - size != header->stringBytes)
+	{
+		unmap();
+		return;
+	}
+	updateTime = header->updateTime;
+	episodeCount = header->episodeCount;
+	tokenCount = header->tokenCount;
+	postingCount = header->postingCount;
+	stringBytes = header->stringBytes;
+	episodes = (const EpisodeRecord*)((const char*)mapping + sizeof(CatalogHeader));
+	tokens = (const TokenRecord*)(episodes + episodeCount);
+	postings = (const std::uint32_t*)(tokens + tokenCount);
+	strings = (const char*)(postings + postingCount);
+	title = StringRef{header->titleOffset, header->titleLength};
+	description = StringRef{header->descriptionOffset, header->descriptionLength};
+
+	// Check every reference, so nothing outside of the file is ever read
+	bool intact = check(title) && check(description);
+	for(std::uint32_t i = 0; intact && i < episodeCount; i++)
+		intact = check(episodes[i].title) && check(episodes[i].description) && check(episodes[i].uri) && check(episodes[i].guid);
+	for(std::uint32_t i = 0; intact && i < tokenCount; i++)
+		intact = check(tokens[i].token) && tokens[i].first <= postingCount && tokens[i].count <= postingCount - tokens[i].first;
+	if(!intact)
+		unmap();
+}
+
+void Catalog::unmap()
+{
+	if(mapping)
+		munmap(mapping, mappingSize);
+	mapping = NULL;
+	mappingSize = 0;
+	episodes = NULL;
+	tokens = NULL;
+	postings = NULL;
+	strings = NULL;
+	title = description = StringRef{0, 0};
+	episodeCount = tokenCount = postingCount = 0;
+	stringBytes = 0;
+}
+
+CatalogEpisode Catalog::getEpisode(std::size_t i) const
+{
+	const EpisodeRecord& record = episodes[i];
+	return CatalogEpisode{string(record.title), string(record.description), string(record.uri), string(record.guid), (std::time_t)record.pubTime, record.utcOffset, record.downloaded != 0};
+}
+
+std::vector<std::size_t> Catalog::search(std::string_view query) const
+{
+	std::vector<std::string> words, titleWords;
+	tokenize(query, words);
+	tokenize(getTitle(), titleWords);
+	if(words.empty() || !mapping)
+		return std::vector<std::size_t>();
+
+	std::vector<std::uint32_t> result, matches;
+	bool everything = true;
+	for(const std::string& word : words)
+	{
+		// A word of the feed's title matches all of its episodes
+		if(std::any_of(titleWords.begin(), titleWords.end(), [&word](const std::string& titleWord) {return titleWord.compare(0, word.size(), word) == 0;}))
+			continue;
+
+		// All words that begin with the word follow each other in the table
+		const TokenRecord* token = std::lower_bound(tokens, tokens + tokenCount, word, [this](const TokenRecord& record, const std::string& word) {return string(record.token) < std::string_view(word);});
+		const TokenRecord* first = token;
+		matches.clear();
+		for(; token != tokens + tokenCount && string(token->token).compare(0, word.size(), word) == 0; token++)
+			matches.insert(matches.end(), postings + token->first, postings + token->first + token->count);
+		if(token - first > 1)
+		{
+			std::sort(matches.begin(), matches.end());
+			matches.erase(std::unique(matches.begin(), matches.end()), matches.end());
+		}
+
+		if(everything)
+			result.swap(matches);
+		else
+		{
+			std::vector<std::uint32_t> both;
+			std::set_intersection(result.begin(), result.end(), matches.begin(), matches.end(), std::back_inserter(both));
+			result.swap(both);
+		}
+		everything = false;
+		if(result.empty())
+			break;
+	}
+
+	std::vector<std::size_t> positions;
+	if(everything)
+		for(std::size_t i = 0; i < episodeCount; i++)
+			positions.push_back(i);
+	else
+		for(std::uint32_t i : result)
+			if(i < episodeCount)
+				positions.push_back(i);
+	return positions;
+}
+
+void Catalog::tokenize(std::string_view text, std::vector<std::string>& words)
+{
+	std::string word;
+	auto finish = [&]
+	{
+		if(word.empty())
+			return;
+		// Cut long words without splitting a UTF-8 sequence
+		if(word.size() > MAX_WORD)
+		{
+			std::size_t length = MAX_WORD;
+			while(length > 0 && (word[length] & 0xC0) == 0x80)
+				length--;
+			word.resize(length);
+		}
+		words.push_back(word);
+		word.clear();
+	};
+	for(std::size_t i = 0; i < text.size(); i++)
+	{
+		unsigned char c = text[i];
+		if(c == '<' && i + 1 < text.size() && (std::isalpha((unsigned char)text[i + 1]) || text[i + 1] == '/' || text[i + 1] == '!'))
+		{
+			// Descriptions are often HTML, the names of tags and attributes are not words of the text
+			finish();
+			std::size_t end = text.find('>', i);
+			if(end == std::string_view::npos)
+				break;
+			i = end;
+		}
+		else if(c >= 0x80 || (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z'))
+			word += c;
+		else if(c >= 'A' && c <= 'Z')
+			word += c - 'A' + 'a';
+		else
+			finish();
+	}
+	finish();
+}
+
+void Catalog::write(const std::filesystem::path& filename, std::string_view title, std::string_view description, const std::vector<CatalogEpisode>& episodes)
+{
+	std::string strings;
+	auto store = [&strings](std::string_view str)
+	{
+		StringRef ref{(std::uint32_t)strings.size(), (std::uint32_t)str.size()};
+		strings.append(str);
+		return ref;
+	};
+
+	// Collect the episodes each word occurs in, but for single letters (which would occur almost everywhere)
+	std::unordered_map<std::string, std::vector<std::uint32_t>> words;
+	std::vector<std::string> episodeWords;
+	std::vector<EpisodeRecord> records;
+	records.reserve(episodes.size());
+	for(std::uint32_t i = 0; i < episodes.size(); i++)
+	{
+		const CatalogEpisode& episode = episodes[i];
+		records.push_back(EpisodeRecord{episode.pubTime, (std::int32_t)episode.utcOffset, episode.downloaded, store(episode.title), store(episode.description), store(episode.uri), store(episode.guid)});
+		episodeWords.clear();
+		tokenize(episode.title, episodeWords);
+		tokenize(episode.description, episodeWords);
+		for(const std::string& word : episodeWords)
+		{
+			if(word.size() < 2)
+				continue;
+			std::vector<std::uint32_t>& list = words[word];
+			if(list.empty() || list.back() != i)
+				list.push_back(i);
+		}
+	}
+	StringRef titleRef = store(title), descriptionRef = store(description);
+
+	// The table of words is sorted, so a prefix can be found by binary search
+	std::vector<const std::pair<const std::string, std::vector<std::uint32_t>>*> sorted;
+	sorted.reserve(words.size());
+	for(const auto& entry : words)
+		sorted.push_back(&entry);
+	std::sort(sorted.begin(), sorted.end(), [](const auto* a, const auto* b) {return a->first < b->first;});
+	std::vector<TokenRecord> tokens;
+	std::vector<std::uint32_t> postings;
+	tokens.reserve(sorted.size());
+	for(const auto* entry : sorted)
+	{
+		tokens.push_back(TokenRecord{store(entry->first), (std::uint32_t)postings.size(), (std::uint32_t)entry->second.size()});
+		postings.insert(postings.end(), entry->second.begin(), entry->second.end());
+	}
+	if(strings.size() > UINT32_MAX || postings.size() > UINT32_MAX)
+		throw std::runtime_error("The catalog \"" + filename.string() + "\" would be too large.");
+
+	CatalogHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, catalogMagic, sizeof(catalogMagic));
+	header.updateTime = std::time(NULL);
+	header.stringBytes = strings.size();
+	header.episodeCount = records.size();
+	header.tokenCount = tokens.size();
+	header.postingCount = postings.size();
+	header.titleOffset = titleRef.offset;
+	header.titleLength = titleRef.length;
+	header.descriptionOffset = descriptionRef.offset;
+	header.descriptionLength = descriptionRef.length;
+
+	// Written under a name of its own and renamed, so readers never see half of it
+	std::error_code ec;
+	std::filesystem::create_directories(filename.parent_path(), ec);
+	std::filesystem::path tempPath = filename.string() + "." + std::to_string(getpid());
+	std::ofstream ofs(tempPath, std::ios::binary | std::ios::trunc);
+	ofs.write((const char*)&header, sizeof(header));
+	ofs.write((const char*)records.data(), records.size() * sizeof(EpisodeRecord));
+	ofs.write((const char*)tokens.data(), tokens.size() * sizeof(TokenRecord));
+	ofs.write((const char*)postings.data(), postings.size() * sizeof(std::uint32_t));
+	ofs.write(strings.data(), strings.size());
+	ofs.close();
+	if(!ofs.fail())
+		std::filesystem::rename(tempPath, filename, ec);
+	if(ofs.fail() || ec)
+	{
+		std::filesystem::remove(tempPath, ec);
+		throw std::runtime_error("Unable to write the catalog \"" + filename.string() + "\".");
+	}
+}
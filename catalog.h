@@ -0,0 +1,177 @@
+/**
+ * \file catalog.h
+ * \brief Defines the Catalog class and the CatalogEpisode struct
+ */
+
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include<string>
+#include<string_view>
+#include<vector>
+#include<cstdint>
+#include<ctime>
+#include<filesystem>
+
+/**
+ * \brief An episode as recorded in a Catalog
+ * \details The strings point into the catalog (or, when writing one, to
+ * wherever the caller keeps them).
+ */
+struct CatalogEpisode
+{
+	std::string_view title, description, uri, guid;
+	std::time_t pubTime; ///< Publication time as a UTC timestamp
+	long utcOffset; ///< Offset of the feed's time zone from UTC in seconds
+	bool downloaded; ///< Whether the episode had been downloaded at the time of the update
+
+	/**
+	 * \brief Returns the publication date as written in the feed
+	 * \return The date in the feed's time zone, like Episode#getPubDate().
+	 */
+	std::tm getPubDate() const;
+};
+
+/**
+ * \brief Read-only snapshot of a feed and its episodes, searchable by word
+ * \details Every update writes the catalog of a feed, so its title,
+ * description and episodes (including whether they have been downloaded) can
+ * be shown without retrieving the feed again.
+ *
+ * On disk, the catalog is memory-mapped like the EpisodeIndex, so nothing
+ * is read into memory or parsed. After a header come fixed-size episode
+ * records, a table of all words of the episodes' titles and descriptions in
+ * byte order, the sorted list of episodes for each word, and finally the
+ * strings. Words are runs of letters and digits (any non-ASCII byte counts
+ * as a letter), ASCII letters are lowercased, and HTML tags are skipped. A
+ * search looks up each word of the query by binary search as a prefix and
+ * intersects the episode lists, so it only reads the parts of the file that
+ * match.
+ *
+ * The file is replaced atomically by write(). Rather than checksummed, it is
+ * validated when it is opened: every offset in the episode and word records
+ * is checked against the size of the file. This takes time linear in the
+ * number of records, but neither the strings nor the episode lists are
+ * read, which is cheaper than a checksum of the whole file.
+ */
+class Catalog
+{
+private:
+	struct StringRef
+	{
+		std::uint32_t offset, length;
+	};
+
+	struct EpisodeRecord
+	{
+		std::int64_t pubTime;
+		std::int32_t utcOffset;
+		std::uint32_t downloaded;
+		StringRef title, description, uri, guid;
+	};
+
+	struct TokenRecord
+	{
+		StringRef token;
+		std::uint32_t first, count;
+	};
+
+	void* mapping;
+	std::size_t mappingSize;
+	std::time_t updateTime;
+	StringRef title, description;
+	const EpisodeRecord* episodes;
+	const TokenRecord* tokens;
+	const std::uint32_t* postings;
+	const char* strings;
+	std::uint32_t episodeCount, tokenCount, postingCount;
+	std::uint64_t stringBytes;
+
+	void load(const std::filesystem::path& filename);
+	void unmap();
+	bool check(StringRef ref) const {return ref.offset <= stringBytes && ref.length <= stringBytes - ref.offset;}
+	std::string_view string(StringRef ref) const {return std::string_view(strings + ref.offset, ref.length);}
+	static void tokenize(std::string_view text, std::vector<std::string>& words);
+public:
+	/**
+	 * \brief Opens a catalog
+	 * \details A missing, damaged or outdated file results in an invalid
+	 * catalog (see isValid()).
+	 * \param filename The file where the catalog is stored.
+	 */
+	Catalog(const std::filesystem::path& filename);
+
+	/**
+	 * \brief Destructor
+	 * \details Unmaps the file, which invalidates all strings returned.
+	 */
+	~Catalog();
+
+	Catalog(const Catalog&) = delete;
+	Catalog& operator=(const Catalog&) = delete;
+
+	/**
+	 * \brief Checks whether the catalog could be opened
+	 * \return True if the file exists and is intact.
+	 */
+	bool isValid() const {return mapping != NULL;}
+
+	/**
+	 * \brief Returns when the catalog was written
+	 * \return The time of the update that wrote it.
+	 */
+	std::time_t getUpdateTime() const {return updateTime;}
+
+	/**
+	 * \brief Returns the feed's title
+	 * \return The title of the feed.
+	 */
+	std::string_view getTitle() const {return string(title);}
+
+	/**
+	 * \brief Returns the feed's description
+	 * \return The description of the feed.
+	 */
+	std::string_view getDescription() const {return string(description);}
+
+	/**
+	 * \brief Returns the number of episodes
+	 * \return The number of episodes in the catalog.
+	 */
+	std::size_t size() const {return episodeCount;}
+
+	/**
+	 * \brief Returns an episode
+	 * \details Episodes are in the order of the feed, i.e. usually the newest
+	 * one first.
+	 * \param i The position of the episode, less than size().
+	 * \return The episode.
+	 */
+	CatalogEpisode getEpisode(std::size_t i) const;
+
+	/**
+	 * \brief Finds the episodes that contain all words of a query
+	 * \details Each word of the query matches any word that begins with it,
+	 * in the title or description of an episode, or in the title of the
+	 * feed (which then matches all episodes). Case is ignored for ASCII
+	 * letters.
+	 * \param query The words to look for, e.g. "interview linux".
+	 * \return The positions of the matching episodes in ascending order.
+	 * Empty if the query contains no words.
+	 */
+	std::vector<std::size_t> search(std::string_view query) const;
+
+	/**
+	 * \brief Writes a catalog
+	 * \details The file is written under a temporary name and renamed, so
+	 * catalogs that are open (even the one being replaced) stay intact.
+	 * \param filename The file where the catalog is stored.
+	 * \param title The title of the feed.
+	 * \param description The description of the feed.
+	 * \param episodes The episodes, in the order they are to be listed.
+	 * \throws std::runtime_error If the file could not be written.
+	 */
+	static void write(const std::filesystem::path& filename, std::string_view title, std::string_view description, const std::vector<CatalogEpisode>& episodes);
+};
+
+#endif //CATALOG_H
@@ -0,0 +1,130 @@
+/**
+ * \file circuitbreaker.cpp
+ * \brief Implementation for circuitbreaker.h
+ */
+
+#include<stdexcept>
+#include<fstream>
+#include<sstream>
+#include<algorithm>
+#include<unistd.h>
+#include"circuitbreaker.h"
+
+/// Longest time a host is skipped, in seconds
+static const std::time_t MAX_COOLDOWN = 24 * 60 * 60;
+
+CircuitBreaker::CircuitBreaker(std::filesystem::path filename, unsigned threshold, unsigned cooldown)
+: filename(filename), threshold(threshold), cooldown(cooldown)
+{
+	// One line per host: host=failures open-until
+	std::ifstream ifs(filename);
+	std::string line;
+	while(std::getline(ifs, line))
+	{
+		std::size_t pos = line.find('=');
+		if(pos == std::string::npos || pos == 0)
+			continue;
+		Host host{0, 0, false};
+		std::istringstream iss(line.substr(pos + 1));
+		if(iss >> host.failures >> host.openUntil && host.failures > 0)
+			hosts[line.substr(0, pos)] = host;
+	}
+}
+
+std::time_t CircuitBreaker::cooldownFor(unsigned failures) const
+{
+	// Every failed probe doubles the time the host is skipped
+	std::time_t duration = cooldown;
+	for(unsigned i = threshold; i < failures && duration < MAX_COOLDOWN; i++)
+		duration *= 2;
+	return std::min(duration, MAX_COOLDOWN);
+}
+
+std::time_t CircuitBreaker::admit(const std::string& host, std::time_t now)
+{
+	if(threshold == 0 || host.empty())
+		return 0;
+	std::lock_guard<std::mutex> lock(mutex);
+	auto iter = hosts.find(host);
+	if(iter == hosts.end() || iter->second.failures < threshold)
+		return 0;
+	Host& state = iter->second;
+	if(state.openUntil > now)
+		return state.openUntil;
+
+	// The cooldown has passed, this transfer probes the host while the others stay away
+	state.probing = true;
+	state.openUntil = now + cooldownFor(state.failures);
+	return 0;
+}
+
+bool CircuitBreaker::isProbing(const std::string& host, std::time_t now) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto iter = hosts.find(host);
+	return iter != hosts.end() && iter->second.probing && iter->second.openUntil > now;
+}
+
+void CircuitBreaker::succeeded(const std::string& host)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	hosts.erase(host);
+}
+
+void CircuitBreaker::failed(const std::string& host, std::time_t now)
+{
+	if(threshold == 0 || host.empty())
+		return;
+	std::lock_guard<std::mutex> lock(mutex);
+	Host& state = hosts.emplace(host, Host{0, 0, false}).first->second;
+
+	// Once the breaker is open, only the probe tells something new (the others started before it opened)
+	if(state.failures >= threshold && !state.probing)
+		return;
+	state.probing = false;
+	state.failures++;
+	if(state.failures >= threshold)
+		state.openUntil = now + cooldownFor(state.failures);
+}
+
+void CircuitBreaker::inconclusive(const std::string& host, std::time_t now)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto iter = hosts.find(host);
+	if(iter == hosts.end() || !iter->second.probing)
+		return;
+	iter->second.probing = false;
+	iter->second.openUntil = now;
+}
+
+unsigned CircuitBreaker::countOpen(std::time_t now) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	unsigned count = 0;
+	for(const auto& entry : hosts)
+		count += entry.second.openUntil > now;
+	return count;
+}
+
+void CircuitBreaker::save() const
+{
+	std::error_code ec;
+	std::filesystem::create_directories(filename.parent_path(), ec);
+
+	// Written under a name of its own and renamed, so a concurrent run never reads half of it
+	std::filesystem::path tempPath = filename.string() + "." + std::to_string(getpid());
+	std::ofstream ofs(tempPath, std::ios::trunc);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for(const auto& entry : hosts)
+			ofs << entry.first << "=" << entry.second.failures << " " << entry.second.openUntil << std::endl;
+	}
+	ofs.close();
+	if(!ofs.fail())
+		std::filesystem::rename(tempPath, filename, ec);
+	if(ofs.fail() || ec)
+	{
+		std::filesystem::remove(tempPath, ec);
+		throw std::runtime_error("Unable to write the state of the hosts to \"" + filename.string() + "\".");
+	}
+}
@@ -0,0 +1,124 @@
+/**
+ * \file circuitbreaker.h
+ * \brief Defines the CircuitBreaker class
+ */
+
+#ifndef CIRCUITBREAKER_H
+#define CIRCUITBREAKER_H
+
+#include<string>
+#include<map>
+#include<mutex>
+#include<ctime>
+#include<filesystem>
+
+/**
+ * \brief Keeps track of hosts that keep failing, across runs
+ * \details Every transfer to a host reports whether the host answered. After
+ * a number of failures in a row (connections refused or timed out, 500 or
+ * 503 responses etc., see RetryPolicy#isTransient()), the breaker opens: the
+ * host is not contacted at all until a cooldown has passed, so a dead server
+ * costs nothing instead of a timeout per feed and episode. Failures of
+ * transfers that were already running when the breaker opened are not
+ * counted.
+ *
+ * Once the cooldown has passed, admit() lets a single transfer through as a
+ * probe; the host stays closed to all others while it runs. If the probe
+ * succeeds, the host is healthy again; if it fails, the breaker opens once
+ * more, for twice as long as before (but not longer than a day). A probe
+ * whose outcome is never reported is given up after another cooldown.
+ *
+ * The state is kept in a small text file, so hosts that were found to be
+ * down by one run are skipped by the next one. All methods are thread-safe.
+ */
+class CircuitBreaker
+{
+private:
+	struct Host
+	{
+		unsigned failures;
+		std::time_t openUntil;
+		bool probing;
+	};
+
+	std::filesystem::path filename;
+	unsigned threshold, cooldown;
+	std::map<std::string, Host> hosts;
+	mutable std::mutex mutex;
+
+	std::time_t cooldownFor(unsigned failures) const;
+public:
+	/**
+	 * \brief Creates a CircuitBreaker with the state of the previous run
+	 * \details A missing or unreadable file is treated like an empty one.
+	 * \param filename The file where the state is stored.
+	 * \param threshold Number of failures in a row after which a host is
+	 * skipped. 0 means hosts are never skipped.
+	 * \param cooldown How long a host is skipped at first, in seconds.
+	 */
+	CircuitBreaker(std::filesystem::path filename, unsigned threshold, unsigned cooldown);
+
+	/**
+	 * \brief Checks whether a host may be contacted
+	 * \details If the cooldown of the host has passed, the caller's transfer
+	 * becomes the probe and must report its outcome with succeeded(),
+	 * failed() or inconclusive().
+	 * \param host The name of the host. An empty name (e.g. of a file URI)
+	 * is always allowed.
+	 * \param now The current time.
+	 * \return The time until which the host is skipped (which, while a probe
+	 * runs, is when the probe is given up), or 0 if it may be contacted.
+	 */
+	std::time_t admit(const std::string& host, std::time_t now);
+
+	/**
+	 * \brief Checks whether a probe of a host is running
+	 * \details Transfers that can wait for its outcome should do so rather
+	 * than be skipped.
+	 * \param host The name of the host.
+	 * \param now The current time.
+	 * \return True if a transfer admitted as a probe has not reported yet.
+	 */
+	bool isProbing(const std::string& host, std::time_t now) const;
+
+	/**
+	 * \brief Records that a host answered
+	 * \details Any answer counts, even an error like 404 Not Found.
+	 * \param host The name of the host.
+	 */
+	void succeeded(const std::string& host);
+
+	/**
+	 * \brief Records that a host did not answer properly
+	 * \param host The name of the host.
+	 * \param now The current time.
+	 */
+	void failed(const std::string& host, std::time_t now);
+
+	/**
+	 * \brief Records that a transfer ended without telling anything about
+	 * the host
+	 * \details E.g. the file could not be written. If the transfer was the
+	 * probe, the next transfer may probe the host instead.
+	 * \param host The name of the host.
+	 * \param now The current time.
+	 */
+	void inconclusive(const std::string& host, std::time_t now);
+
+	/**
+	 * \brief Returns the number of hosts that are skipped
+	 * \param now The current time.
+	 * \return The number of hosts whose breaker is open.
+	 */
+	unsigned countOpen(std::time_t now) const;
+
+	/**
+	 * \brief Stores the state for the next run
+	 * \details The file is replaced atomically. Only hosts that failed at
+	 * their last attempt are kept.
+	 * \throws std::runtime_error If the file could not be written.
+	 */
+	void save() const;
+};
+
+#endif //CIRCUITBREAKER_H
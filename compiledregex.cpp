@@ -0,0 +1,507 @@
+/**
+ * \file compiledregex.cpp
+ * \brief Implementation for compiledregex.h
+ */
+
+#include"compiledregex.h"
+
+/// Upper limit for the number of instructions (counted repetition is expanded)
+static const std::size_t MAX_PROGRAM_SIZE = 20000;
+
+/**
+ * \brief A node of the syntax tree of a regular expression
+ */
+struct CompiledRegex::Node
+{
+	enum class Type {EMPTY, SET, CONCAT, ALTERNATION, REPEAT, ASSERTION};
+	Type type;
+	std::bitset<256> set;
+	std::vector<Node> children;
+	int min, max; // max < 0 means unbounded
+	Op assertion;
+
+	Node(Type type) : type(type), min(0), max(0), assertion(Op::MATCH) {}
+};
+
+/**
+ * \brief Parses the supported subset of the ECMAScript grammar
+ * \details Anything that is not supported (or not valid) makes parse() fail,
+ * in which case the expression is left to std::regex.
+ */
+class CompiledRegex::Parser
+{
+private:
+	const std::string& regex;
+	std::size_t pos;
+
+	struct Unsupported {};
+
+	bool atEnd() const {return pos >= regex.size();}
+	unsigned char peek() const {return regex[pos];}
+
+	static std::bitset<256> classSet(char c)
+	{
+		std::bitset<256> set;
+		for(int i = 0; i < 256; i++)
+		{
+			bool digit = i >= '0' && i <= '9';
+			bool word = digit || (i >= 'a' && i <= 'z') || (i >= 'A' && i <= 'Z') || i == '_';
+			bool space = i == ' ' || (i >= '\t' && i <= '\r');
+			switch(c)
+			{
+				case 'd': case 'D': set[i] = digit; break;
+				case 'w': case 'W': set[i] = word; break;
+				case 's': case 'S': set[i] = space; break;
+			}
+		}
+		if(c == 'D' || c == 'W' || c == 'S')
+			set.flip();
+		return set;
+	}
+
+	static int hexValue(char c)
+	{
+		if(c >= '0' && c <= '9') return c - '0';
+		if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+		if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+		return -1;
+	}
+
+	// Parses the character after a backslash that stands for a single character
+	unsigned char escapedChar()
+	{
+		if(atEnd())
+			throw Unsupported();
+		char c = regex[pos++];
+		switch(c)
+		{
+			case 'n': return '\n';
+			case 'r': return '\r';
+			case 't': return '\t';
+			case 'v': return '\v';
+			case 'f': return '\f';
+			case '0':
+				if(!atEnd() && peek() >= '0' && peek() <= '9')
+					throw Unsupported();
+				return '\0';
+			case 'x':
+			{
+				if(pos + 2 > regex.size() || hexValue(regex[pos]) < 0 || hexValue(regex[pos + 1]) < 0)
+					throw Unsupported();
+				int value = hexValue(regex[pos]) * 16 + hexValue(regex[pos + 1]);
+				pos += 2;
+				if(value >= 0x80)
+					throw Unsupported();
+				return value;
+			}
+		}
+		// Any other escaped punctuation stands for itself, letters and digits are special
+		if((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (unsigned char)c >= 0x80)
+			throw Unsupported();
+		return c;
+	}
+
+	Node alternation()
+	{
+		Node node(Node::Type::ALTERNATION);
+		node.children.push_back(concatenation());
+		while(!atEnd() && peek() == '|')
+		{
+			pos++;
+			node.children.push_back(concatenation());
+		}
+		return node.children.size() == 1 ? node.children[0] : node;
+	}
+
+	Node concatenation()
+	{
+		Node node(Node::Type::CONCAT);
+		while(!atEnd() && peek() != '|' && peek() != ')')
+			node.children.push_back(repetition());
+		return node;
+	}
+
+	bool number(int& value)
+	{
+		std::size_t start = pos;
+		value = 0;
+		while(!atEnd() && peek() >= '0' && peek() <= '9')
+		{
+			value = value * 10 + (peek() - '0');
+			if(value > 1000)
+				throw Unsupported();
+			pos++;
+		}
+		return pos > start;
+	}
+
+	Node repetition()
+	{
+		Node child = atom();
+		while(!atEnd())
+		{
+			int min, max;
+			char c = peek();
+			if(c == '*') {min = 0; max = -1; pos++;}
+			else if(c == '+') {min = 1; max = -1; pos++;}
+			else if(c == '?') {min = 0; max = 1; pos++;}
+			else if(c == '{')
+			{
+				pos++;
+				if(!number(min))
+					throw Unsupported();
+				max = min;
+				if(!atEnd() && peek() == ',')
+				{
+					pos++;
+					if(!number(max))
+						max = -1;
+				}
+				if(atEnd() || peek() != '}' || (max >= 0 && max < min))
+					throw Unsupported();
+				pos++;
+			}
+			else
+				break;
+
+			// Laziness changes which match is found, but not whether there is one
+			if(!atEnd() && peek() == '?')
+				pos++;
+			if(child.type == Node::Type::ASSERTION || child.type == Node::Type::REPEAT)
+				throw Unsupported();
+			Node node(Node::Type::REPEAT);
+			node.min = min;
+			node.max = max;
+			node.children.push_back(child);
+			child = node;
+		}
+		return child;
+	}
+
+	Node characterClass()
+	{
+		Node node(Node::Type::SET);
+		bool negate = false;
+		if(!atEnd() && peek() == '^')
+		{
+			negate = true;
+			pos++;
+		}
+		if(!atEnd() && peek() == ']')
+			throw Unsupported(); // An empty class
+		while(true)
+		{
+			if(atEnd())
+				throw Unsupported();
+			unsigned char c = regex[pos++];
+			if(c == ']')
+				break;
+			if(c == '[')
+				throw Unsupported(); // [:alpha:] and friends
+			if(c == '\\')
+			{
+				if(atEnd())
+					throw Unsupported();
+				char e = peek();
+				if(e == 'd' || e == 'D' || e == 'w' || e == 'W' || e == 's' || e == 'S')
+				{
+					pos++;
+					node.set |= classSet(e);
+					if(!atEnd() && peek() == '-' && pos + 1 < regex.size() && regex[pos + 1] != ']')
+						throw Unsupported();
+					continue;
+				}
+				if(e == 'b' || e == 'B')
+					throw Unsupported();
+				c = escapedChar();
+			}
+			else if(c >= 0x80)
+				throw Unsupported();
+
+			// A range?
+			if(!atEnd() && peek() == '-' && pos + 1 < regex.size() && regex[pos + 1] != ']')
+			{
+				pos++;
+				unsigned char last = regex[pos++];
+				if(last == '\\')
+					last = escapedChar();
+				else if(last == '[' || last >= 0x80)
+					throw Unsupported();
+				if(last < c)
+					throw Unsupported();
+				for(int i = c; i <= last; i++)
+					node.set[i] = true;
+			}
+			else
+				node.set[c] = true;
+		}
+		if(negate)
+			node.set.flip();
+		return node;
+	}
+
+	Node atom()
+	{
+		unsigned char c = regex[pos++];
+		switch(c)
+		{
+			case '(':
+			{
+				if(!atEnd() && peek() == '?')
+				{
+					if(pos + 1 >= regex.size() || regex[pos + 1] != ':')
+						throw Unsupported(); // Lookahead
+					pos += 2;
+				}
+				Node node = alternation();
+				if(atEnd() || peek() != ')')
+					throw Unsupported();
+				pos++;
+				return node;
+			}
+			case '[':
+				return characterClass();
+			case '.':
+			{
+				Node node(Node::Type::SET);
+				node.set.set();
+				node.set['\n'] = node.set['\r'] = false;
+				return node;
+			}
+			case '^': case '$':
+			{
+				Node node(Node::Type::ASSERTION);
+				node.assertion = c == '^' ? Op::BEGIN : Op::END;
+				return node;
+			}
+			case '\\':
+			{
+				if(atEnd())
+					throw Unsupported();
+				char e = peek();
+				if(e == 'd' || e == 'D' || e == 'w' || e == 'W' || e == 's' || e == 'S')
+				{
+					pos++;
+					Node node(Node::Type::SET);
+					node.set = classSet(e);
+					return node;
+				}
+				if(e == 'b' || e == 'B')
+				{
+					pos++;
+					Node node(Node::Type::ASSERTION);
+					node.assertion = e == 'b' ? Op::WORD_BOUNDARY : Op::NOT_WORD_BOUNDARY;
+					return node;
+				}
+				Node node(Node::Type::SET);
+				node.set[escapedChar()] = true;
+				return node;
+			}
+			case '*': case '+': case '?': case '{': case '}': case ']': case ')':
+				throw Unsupported();
+		}
+		Node node(Node::Type::SET);
+		node.set[c] = true;
+		return node;
+	}
+public:
+	Parser(const std::string& regex) : regex(regex), pos(0) {}
+
+	bool parse(Node& root)
+	{
+		try
+		{
+			root = alternation();
+			return atEnd();
+		}
+		catch(Unsupported&)
+		{
+			return false;
+		}
+	}
+};
+
+CompiledRegex::CompiledRegex(const std::string& regex)
+{
+	Node root(Node::Type::EMPTY);
+	if(Parser(regex).parse(root))
+	{
+		compile(root);
+		emit(Op::MATCH);
+		if(program.size() <= MAX_PROGRAM_SIZE)
+			return;
+	}
+
+	// Not supported (or not even valid), leave it to std::regex
+	program.clear();
+	sets.clear();
+	fallback = std::make_shared<std::regex>(regex);
+}
+
+int CompiledRegex::emit(Op op, int x, int y)
+{
+	if(program.size() > MAX_PROGRAM_SIZE)
+		return program.size(); // Give up, the constructor falls back to std::regex
+	program.push_back({op, x, y});
+	return program.size() - 1;
+}
+
+void CompiledRegex::compile(const Node& node)
+{
+	// Nested counts would multiply the work, stop as soon as the program is too large
+	if(program.size() > MAX_PROGRAM_SIZE)
+		return;
+	switch(node.type)
+	{
+		case Node::Type::EMPTY:
+			break;
+		case Node::Type::SET:
+			sets.push_back(node.set);
+			emit(Op::SET, sets.size() - 1);
+			break;
+		case Node::Type::CONCAT:
+			for(const Node& child : node.children)
+				compile(child);
+			break;
+		case Node::Type::ALTERNATION:
+		{
+			// SPLIT to each alternative, each one jumps to the end when done
+			std::vector<int> jumps;
+			for(std::size_t i = 0; i < node.children.size() && program.size() <= MAX_PROGRAM_SIZE; i++)
+			{
+				int split = i + 1 < node.children.size() ? emit(Op::SPLIT) : -1;
+				compile(node.children[i]);
+				if(split >= 0)
+				{
+					jumps.push_back(emit(Op::JMP));
+					if((std::size_t)split < program.size())
+						program[split] = {Op::SPLIT, split + 1, (int)program.size()};
+				}
+			}
+			for(int jump : jumps)
+				if((std::size_t)jump < program.size())
+					program[jump].x = program.size();
+			break;
+		}
+		case Node::Type::REPEAT:
+		{
+			const Node& child = node.children[0];
+			for(int i = 0; i < node.min && program.size() <= MAX_PROGRAM_SIZE; i++)
+			{
+				std::size_t size = program.size();
+				compile(child);
+				if(program.size() == size)
+					break; // Repeating nothing yields nothing
+			}
+			if(node.max < 0)
+			{
+				// loop: SPLIT body, out; body; JMP loop
+				int split = emit(Op::SPLIT);
+				compile(child);
+				emit(Op::JMP, split);
+				if((std::size_t)split < program.size())
+					program[split] = {Op::SPLIT, split + 1, (int)program.size()};
+			}
+			else
+			{
+				// Each optional copy may skip to the very end
+				std::vector<int> splits;
+				for(int i = node.min; i < node.max && program.size() <= MAX_PROGRAM_SIZE; i++)
+				{
+					splits.push_back(emit(Op::SPLIT));
+					compile(child);
+				}
+				for(int split : splits)
+					if((std::size_t)split < program.size())
+						program[split] = {Op::SPLIT, split + 1, (int)program.size()};
+			}
+			break;
+		}
+		case Node::Type::ASSERTION:
+			emit(node.assertion);
+			break;
+	}
+}
+
+static bool isWordChar(unsigned char c)
+{
+	return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+void CompiledRegex::addThread(Threads& threads, int pc, const std::string& str, std::size_t pos) const
+{
+	// Follow all transitions that do not consume a character
+	std::vector<int>& stack = threads.stack;
+	std::vector<unsigned>& marks = threads.marks;
+	unsigned mark = threads.mark;
+	stack.push_back(pc);
+	while(!stack.empty())
+	{
+		pc = stack.back();
+		stack.pop_back();
+		if(marks[pc] == mark)
+			continue;
+		marks[pc] = mark;
+		const Instruction& instruction = program[pc];
+		switch(instruction.op)
+		{
+			case Op::SPLIT:
+				stack.push_back(instruction.y);
+				stack.push_back(instruction.x);
+				break;
+			case Op::JMP:
+				stack.push_back(instruction.x);
+				break;
+			case Op::BEGIN:
+				if(pos == 0)
+					stack.push_back(pc + 1);
+				break;
+			case Op::END:
+				if(pos == str.size())
+					stack.push_back(pc + 1);
+				break;
+			case Op::WORD_BOUNDARY:
+			case Op::NOT_WORD_BOUNDARY:
+			{
+				bool before = pos > 0 && isWordChar(str[pos - 1]);
+				bool after = pos < str.size() && isWordChar(str[pos]);
+				if((before != after) == (instruction.op == Op::WORD_BOUNDARY))
+					stack.push_back(pc + 1);
+				break;
+			}
+			case Op::SET:
+			case Op::MATCH:
+				threads.next.push_back(pc);
+				break;
+		}
+	}
+}
+
+bool CompiledRegex::match(const std::string& str) const
+{
+	if(fallback)
+		return std::regex_match(str, *fallback);
+
+	// Reuse the buffers, matching is done once per episode and filter
+	thread_local Threads threads;
+	threads.marks.assign(program.size(), 0);
+	threads.mark = 1;
+	threads.next.clear();
+	addThread(threads, 0, str, 0);
+	for(std::size_t pos = 0; pos < str.size(); pos++)
+	{
+		if(threads.next.empty())
+			return false;
+		unsigned char c = str[pos];
+		threads.current.swap(threads.next);
+		threads.next.clear();
+		threads.mark++;
+		for(int pc : threads.current)
+			if(program[pc].op == Op::SET && sets[program[pc].x][c])
+				addThread(threads, pc + 1, str, pos + 1);
+	}
+	for(int pc : threads.next)
+		if(program[pc].op == Op::MATCH)
+			return true;
+	return false;
+}
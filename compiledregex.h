@@ -0,0 +1,81 @@
+/**
+ * \file compiledregex.h
+ * \brief Defines the CompiledRegex class
+ */
+
+#ifndef COMPILEDREGEX_H
+#define COMPILEDREGEX_H
+
+#include<string>
+#include<vector>
+#include<bitset>
+#include<memory>
+#include<regex>
+
+/**
+ * \brief A regular expression that is matched in linear time
+ * \details The expression is compiled into a nondeterministic finite automaton
+ * which is simulated by keeping track of all active states at once (Thompson's
+ * construction, simulated like a Pike VM). Matching therefore takes time
+ * proportional to the length of the string times the size of the expression,
+ * without the exponential backtracking std::regex can run into.
+ *
+ * The syntax and semantics are those of std::regex with the default
+ * ECMAScript grammar: literals, `.`, character classes (including ranges and
+ * `\d`, `\w`, `\s` and their negations), groups (capturing or not),
+ * alternation, the quantifiers `*`, `+`, `?` and `{n,m}` (greedy or lazy),
+ * `^`, `$`, `\b` and `\B`. Expressions using anything beyond that (e.g.
+ * backreferences or lookahead) are handed to std::regex instead, so they keep
+ * working exactly as before, only without the speed-up.
+ */
+class CompiledRegex
+{
+private:
+	enum class Op {SET, SPLIT, JMP, BEGIN, END, WORD_BOUNDARY, NOT_WORD_BOUNDARY, MATCH};
+	struct Instruction
+	{
+		Op op;
+		int x, y;
+	};
+	struct Node;
+	class Parser;
+	struct Threads
+	{
+		std::vector<int> current, next, stack;
+		std::vector<unsigned> marks;
+		unsigned mark;
+	};
+
+	std::vector<Instruction> program;
+	std::vector<std::bitset<256>> sets;
+	std::shared_ptr<std::regex> fallback;
+
+	int emit(Op op, int x = 0, int y = 0);
+	void compile(const Node& node);
+	void addThread(Threads& threads, int pc, const std::string& str, std::size_t pos) const;
+public:
+	/**
+	 * \brief Compiles a regular expression
+	 * \param regex A regular expression in the ECMAScript grammar of
+	 * std::regex.
+	 * \throws std::regex_error If the expression is invalid.
+	 */
+	CompiledRegex(const std::string& regex);
+
+	/**
+	 * \brief Checks whether the whole string matches the expression
+	 * \details Equivalent to std::regex_match().
+	 * \param str The string.
+	 * \return True if the expression matches the entire string.
+	 */
+	bool match(const std::string& str) const;
+
+	/**
+	 * \brief Returns whether the expression is matched by the automaton
+	 * \return False if the expression uses features that are only supported
+	 * by std::regex.
+	 */
+	bool isLinear() const {return !fallback;}
+};
+
+#endif //COMPILEDREGEX_H
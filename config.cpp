@@ -0,0 +1,599 @@
+/**
+ * \file config.cpp
+ * \brief Implementation for config.h
+ */
+
+#include<string>
+#include<vector>
+#include<fstream>
+#include<algorithm>
+#include<iterator>
+#include<tuple>
+#include<stdexcept>
+#include<functional>
+#include<cstdlib>
+#include<cstring>
+#include<cerrno>
+#include<nxml.h>
+#include"filter.h"
+#include"config.h"
+
+/**
+ * \brief Helper class for automatically freeing C-style objects when they go
+ * out of scope
+ * \details Used for libnxml objects.
+ */
+class Finalizer
+{
+private:
+	std::function<void()> finalize;
+public:
+	/**
+	 * \brief Constructs a Finalizer
+	 * \param finalize Function that is called when this instance does out of
+	 * scope.
+	 */
+	Finalizer(std::function<void()> finalize): finalize(finalize) {}
+
+	/**
+	 * \brief Destructor that calls the finalize() function.
+	 */
+	~Finalizer() {finalize();}
+};
+
+/// Identifies snapshot files (and their format version)
+static const char SNAPSHOT_MAGIC[8] = {'J', 'P', 'O', 'D', 'C', 'F', 'G', '5'};
+
+/// Computes the 64 bit FNV-1a hash of data
+static std::uint64_t fnv1a(const char* data, std::size_t size)
+{
+	std::uint64_t hash = 14695981039346656037ULL;
+	for(std::size_t i = 0; i < size; i++)
+		hash = (hash ^ (unsigned char)data[i]) * 1099511628211ULL;
+	return hash;
+}
+
+/// Appends a number with the given number of bytes (little endian)
+static void appendNumber(std::string& out, std::uint64_t value, int bytes)
+{
+	for(int i = 0; i < bytes; i++)
+		out += (char)(value >> (8 * i));
+}
+
+/// Appends a string, preceded by its length
+static void appendString(std::string& out, const std::string& str)
+{
+	appendNumber(out, str.size(), 4);
+	out += str;
+}
+
+/**
+ * \brief Reads what appendNumber() and appendString() have written
+ * \details Throws std::runtime_error instead of reading past the end.
+ */
+class Decoder
+{
+private:
+	const std::string& data;
+	std::size_t pos, end;
+public:
+	Decoder(const std::string& data, std::size_t pos = 0, std::size_t end = std::string::npos)
+	: data(data), pos(pos), end(std::min(end, data.size())) {}
+
+	std::size_t position() const {return pos;}
+
+	std::uint64_t number(int bytes)
+	{
+		if(pos > end || end - pos < (std::size_t)bytes)
+			throw std::runtime_error("Configuration snapshot is damaged.");
+		std::uint64_t value = 0;
+		for(int i = 0; i < bytes; i++)
+			value |= (std::uint64_t)(unsigned char)data[pos++] << (8 * i);
+		return value;
+	}
+
+	std::string string()
+	{
+		std::size_t length = number(4);
+		if(end - pos < length)
+			throw std::runtime_error("Configuration snapshot is damaged.");
+		pos += length;
+		return data.substr(pos - length, length);
+	}
+};
+
+/// Checks the record of a feed in the snapshot and returns a Decoder for its fields
+static Decoder feedRecord(const std::string& records, std::size_t offset)
+{
+	Decoder decoder(records, offset);
+	std::size_t length = decoder.number(4);
+	std::uint64_t checksum = decoder.number(8);
+	std::size_t start = decoder.position();
+	if(records.size() - start < length || fnv1a(records.data() + start, length) != checksum)
+		throw std::runtime_error("Configuration snapshot is damaged.");
+	return Decoder(records, start, start + length);
+}
+
+/**
+ * \brief Reads an optional attribute containing a non-negative number
+ * \param xmlElement The element that may have the attribute.
+ * \param name The name of the attribute.
+ * \param value Receives the value of the attribute. Left unchanged if the
+ * attribute does not exist.
+ * \throws std::runtime_error If the attribute exists but is not a number.
+ */
+static void readUnsignedAttribute(nxml_data_t* xmlElement, std::string name, unsigned& value)
+{
+	nxml_attr_t* xmlAttr;
+	nxml_error_t rc = nxml_find_attribute(xmlElement, name.data(), &xmlAttr);
+	if(rc != NXML_OK || xmlAttr == NULL)
+		return;
+	std::string str(xmlAttr->value);
+	if(str.empty() || str.find_first_not_of("0123456789") != std::string::npos || str.length() > 9)
+		throw std::runtime_error("Invalid config file. Attribute " + name + " of <" + xmlElement->value + "> must be a non-negative number.");
+	value = std::stoul(str);
+}
+
+std::uint64_t Config::parse(const std::string& configFile)
+{
+	std::filesystem::path homeDir(getenv("HOME"));
+
+	// Read config file
+	std::ifstream ifs(configFile, std::ios::binary);
+	std::string content((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+	if(!ifs.is_open() || ifs.bad())
+		throw std::runtime_error("Error reading config file " + configFile + ": " + std::strerror(errno));
+
+	nxml_t* xmlData;
+	nxml_error_t rc;
+
+	// Initlialize nxml library
+	rc = nxml_new(&xmlData);
+	if(rc != NXML_OK)
+		throw std::runtime_error("Error initializing libnxml.");
+	Finalizer f1([xmlData]{nxml_free(xmlData);});
+
+	// Parse config file
+	rc = nxml_parse_buffer(xmlData, content.data(), content.size());
+	if(rc != NXML_OK)
+		throw std::runtime_error("Error reading config file " + configFile + ": " + nxml_strerror(xmlData, rc));
+
+	// Get <podlist>...</podlist> root element
+	nxml_data_t* xmlPodlist;
+	nxml_root_element(xmlData, &xmlPodlist);
+	if(xmlPodlist->type != NXML_TYPE_ELEMENT || std::string(xmlPodlist->value) != "podlist")
+		throw std::runtime_error("Invalid config file. Root node is not <podlist>...</podlist>");
+
+	// Get the global settings
+	options = Options();
+	readUnsignedAttribute(xmlPodlist, "max-downloads", options.maxDownloads);
+	readUnsignedAttribute(xmlPodlist, "max-downloads-per-host", options.maxDownloadsPerHost);
+	readUnsignedAttribute(xmlPodlist, "max-rate", options.maxRate);
+	readUnsignedAttribute(xmlPodlist, "segments", options.segments);
+	readUnsignedAttribute(xmlPodlist, "segment-threshold", options.segmentThreshold);
+	readUnsignedAttribute(xmlPodlist, "connect-timeout", options.connectTimeout);
+	readUnsignedAttribute(xmlPodlist, "stall-timeout", options.stallTimeout);
+	readUnsignedAttribute(xmlPodlist, "feed-timeout", options.feedTimeout);
+	readUnsignedAttribute(xmlPodlist, "download-timeout", options.downloadTimeout);
+	readUnsignedAttribute(xmlPodlist, "retries", options.retries);
+	readUnsignedAttribute(xmlPodlist, "retry-delay", options.retryDelay);
+	readUnsignedAttribute(xmlPodlist, "breaker-threshold", options.breakerThreshold);
+	readUnsignedAttribute(xmlPodlist, "breaker-cooldown", options.breakerCooldown);
+	readUnsignedAttribute(xmlPodlist, "update-threads", options.updateThreads);
+	readUnsignedAttribute(xmlPodlist, "min-poll-interval", options.minPollInterval);
+	readUnsignedAttribute(xmlPodlist, "max-poll-interval", options.maxPollInterval);
+	nxml_attr_t* xmlDatadir;
+	rc = nxml_find_attribute(xmlPodlist, std::string("datadir").data(), &xmlDatadir);
+	if(rc == NXML_OK && xmlDatadir != NULL && std::string(xmlDatadir->value) != "")
+		options.dataDir = homeDir / xmlDatadir->value;
+	else if(getenv("XDG_DATA_HOME") && std::string(getenv("XDG_DATA_HOME")) != "")
+		options.dataDir = std::filesystem::path(getenv("XDG_DATA_HOME")) / "jpod";
+	else
+		options.dataDir = homeDir / ".local" / "share" / "jpod";
+	nxml_attr_t* xmlMediaStore;
+	rc = nxml_find_attribute(xmlPodlist, std::string("media-store").data(), &xmlMediaStore);
+	if(rc == NXML_OK && xmlMediaStore != NULL && std::string(xmlMediaStore->value) != "")
+		options.mediaStore = homeDir / xmlMediaStore->value;
+	nxml_attr_t* xmlFsync;
+	rc = nxml_find_attribute(xmlPodlist, std::string("fsync").data(), &xmlFsync);
+	if(rc == NXML_OK && xmlFsync != NULL)
+	{
+		std::string value(xmlFsync->value);
+		if(value == "none")
+			options.sync = SyncPolicy::NONE;
+		else if(value == "episode")
+			options.sync = SyncPolicy::EPISODE;
+		else if(value == "run")
+			options.sync = SyncPolicy::RUN;
+		else
+			throw std::runtime_error("Invalid config file. Attribute fsync of <podlist> must be none, episode or run.");
+	}
+
+	// Go through <feed>...</feed> elements
+	records.clear();
+	index.clear();
+	nxml_data_t* xmlFeed = xmlPodlist->children;
+	while(xmlFeed)
+	{
+		if(xmlFeed->type != NXML_TYPE_COMMENT)
+		{
+			if(xmlFeed->type != NXML_TYPE_ELEMENT || std::string(xmlFeed->value) != "feed")
+				throw std::runtime_error("Invalid config file. Podlist contains something other than <feed>...</feed>");
+
+			// Get the uid attribute
+			nxml_attr_t* xmlUid;
+			rc = nxml_find_attribute(xmlFeed, std::string("uid").data(), &xmlUid);
+			if(rc != NXML_OK || xmlUid == NULL)
+				throw std::runtime_error("Invalid feed in config file. Attribute uid is missing.");
+			std::string uid(xmlUid->value);
+			if(uid.empty() || uid.find_first_of(" \t\r\n/") != std::string::npos || uid == "." || uid == "..")
+				throw std::runtime_error("Invalid feed in config file. Attribute uid must not be empty or contain whitespaces or slashes.");
+
+			// Get the uri attribute
+			nxml_attr_t* xmlUri;
+			rc = nxml_find_attribute(xmlFeed, std::string("uri").data(), &xmlUri);
+			if(rc != NXML_OK || xmlUri == NULL)
+				throw std::runtime_error("Invalid feed in config file. Attribute uri is missing in the feed with uid \"" + uid + "\".");
+			std::string uri(xmlUri->value);
+			if(uri.empty())
+				throw std::runtime_error("Invalid feed in config file. Attribute uri is empty in the feed with uid \"" + uid + "\".");
+
+			// Get the basedir
+			nxml_attr_t* xmlBasedir;
+			rc = nxml_find_attribute(xmlFeed, std::string("basedir").data(), &xmlBasedir);
+			if(rc != NXML_OK || xmlBasedir == NULL)
+				throw std::runtime_error("Invalid feed in config file. Attribute basedir is missing in the feed with uid \"" + uid + "\".");
+			std::string basedir(xmlBasedir->value);
+
+			// Get the filename pattern
+			nxml_attr_t* xmlFilename;
+			rc = nxml_find_attribute(xmlFeed, std::string("filename").data(), &xmlFilename);
+			std::string filename = "%Y-%m-%d_%T";
+			if(rc == NXML_OK && xmlFilename != NULL)
+			{
+				filename = xmlFilename->value;
+				if(filename.empty())
+					throw std::runtime_error("Invalid feed in config file. Attribute filename is invalid in the feed with uid \"" + uid + "\".");
+			}
+
+			// Get the priority
+			unsigned priority = 1;
+			readUnsignedAttribute(xmlFeed, "priority", priority);
+			if(priority == 0)
+				throw std::runtime_error("Invalid feed in config file. Attribute priority must be at least 1 in the feed with uid \"" + uid + "\".");
+
+			// Get the filters
+			std::string filters;
+			std::uint32_t filterCount = 0;
+			nxml_data_t* xmlFilter = xmlFeed->children;
+			while(xmlFilter)
+			{
+				if(xmlFilter->type != NXML_TYPE_COMMENT)
+				{
+					if(xmlFilter->type != NXML_TYPE_ELEMENT || std::string(xmlFilter->value) != "filter")
+						throw std::runtime_error("Invalid config file. <feed>...</feed> contains something other than <filter ... />");
+
+					// Get the type attribute
+					nxml_attr_t* xmlType;
+					rc = nxml_find_attribute(xmlFilter, std::string("type").data(), &xmlType);
+					if(rc != NXML_OK || xmlType == NULL)
+						throw std::runtime_error("Invalid filter in feed with uid \"" + uid + "\". Attribute type is missing.");
+					std::string strType(xmlType->value);
+					FilterType type;
+					if(strType == "include-if-match")
+						type = FilterType::INCLUDE_IF_MATCH;
+					else if(strType == "include-if-not-match")
+						type = FilterType::INCLUDE_IF_NOT_MATCH;
+					else if(strType == "exclude-if-match")
+						type = FilterType::EXCLUDE_IF_MATCH;
+					else if(strType == "exclude-if-not-match")
+						type = FilterType::EXCLUDE_IF_NOT_MATCH;
+					else
+						throw std::runtime_error("Invalid filter in feed with uid \"" + uid + "\". Attribute type must be one of \"include-if-match\", \"include-if-not-match\", \"exclude-if-match\", \"exclude-if-not-match\".");
+
+					// Get the regex attribute
+					nxml_attr_t* xmlRegex;
+					rc = nxml_find_attribute(xmlFilter, std::string("regex").data(), &xmlRegex);
+					if(rc != NXML_OK || xmlRegex == NULL)
+						throw std::runtime_error("Invalid filter in feed with uid \"" + uid + "\". Attribute regex is missing.");
+					std::string regex = xmlRegex->value;
+
+					// Get the match attribute
+					nxml_attr_t* xmlMatch;
+					rc = nxml_find_attribute(xmlFilter, std::string("match").data(), &xmlMatch);
+					if(rc != NXML_OK || xmlMatch == NULL)
+						throw std::runtime_error("Invalid filter in feed with uid \"" + uid + "\". Attribute match is missing.");
+					std::string match(xmlMatch->value);
+						
+					// Make sure the filter is valid, then add it to the list
+					try {Filter(type, regex, match);}
+					catch(std::regex_error& e) {throw std::runtime_error("Invalid filter in feed with uid \"" + uid + "\". Attribute regex is not a valid regular expression: " + e.what());}
+					appendNumber(filters, (std::uint64_t)type, 1);
+					appendString(filters, regex);
+					appendString(filters, match);
+					filterCount++;
+				}
+				xmlFilter = xmlFilter->next;
+			}
+
+			// Add the encoded feed to the list
+			std::string record;
+			appendString(record, uid);
+			appendString(record, uri);
+			appendString(record, (homeDir / basedir).string());
+			appendString(record, filename);
+			appendString(record, (options.dataDir / "feeds" / uid).string());
+			appendNumber(record, priority, 4);
+			appendNumber(record, filterCount, 4);
+			record += filters;
+			index.push_back(std::make_pair(uid, records.size()));
+			appendNumber(records, record.size(), 4);
+			appendNumber(records, fnv1a(record.data(), record.size()), 8);
+			records += record;
+		}
+		xmlFeed = xmlFeed->next;
+	}
+
+	return fnv1a(content.data(), content.size());
+}
+
+Config::Config(const std::string& configFile, const std::filesystem::path& snapshotFile)
+: snapshotFile(snapshotFile)
+{
+	Key key;
+	key.configFile = std::filesystem::absolute(configFile).string();
+	key.home = getenv("HOME") ? getenv("HOME") : "";
+	key.dataHome = getenv("XDG_DATA_HOME") ? getenv("XDG_DATA_HOME") : "";
+	key.hash = 0;
+	std::error_code ec1, ec2;
+	key.modified = std::filesystem::last_write_time(configFile, ec1).time_since_epoch().count();
+	key.size = std::filesystem::file_size(configFile, ec2);
+	bool useSnapshot = !snapshotFile.empty() && !ec1 && !ec2;
+
+	// Use the snapshot if it belongs to the same configuration
+	bool stale = false;
+	if(useSnapshot && readSnapshot(snapshotFile, key, stale))
+	{
+		if(stale)
+			writeSnapshot(snapshotFile, key);
+		return;
+	}
+
+	key.hash = parse(configFile);
+	if(useSnapshot)
+		writeSnapshot(snapshotFile, key);
+}
+
+bool Config::readSnapshot(const std::filesystem::path& snapshotFile, Key& key, bool& stale)
+{
+	std::ifstream ifs(snapshotFile, std::ios::binary);
+	std::string data((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+	if(data.size() < sizeof(SNAPSHOT_MAGIC) || data.compare(0, sizeof(SNAPSHOT_MAGIC), SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0)
+		return false;
+	try
+	{
+		// The header (key, options and index) has a checksum, each feed has its own
+		Decoder decoder(data, sizeof(SNAPSHOT_MAGIC));
+		std::size_t headerLength = decoder.number(4);
+		std::uint64_t headerChecksum = decoder.number(8);
+		std::size_t headerStart = decoder.position();
+		if(data.size() - headerStart < headerLength || fnv1a(data.data() + headerStart, headerLength) != headerChecksum)
+			return false;
+		Decoder header(data, headerStart, headerStart + headerLength);
+
+		// Check that the snapshot was made from the same file in the same environment
+		if(header.string() != key.configFile || header.string() != key.home || header.string() != key.dataHome)
+			return false;
+		std::int64_t modified = header.number(8);
+		std::uint64_t size = header.number(8), hash = header.number(8);
+		if(size != key.size)
+			return false;
+		if(modified != key.modified)
+		{
+			// Touched but possibly unchanged
+			std::ifstream config(key.configFile, std::ios::binary);
+			std::string content((std::istreambuf_iterator<char>(config)), std::istreambuf_iterator<char>());
+			if(fnv1a(content.data(), content.size()) != hash)
+				return false;
+			stale = true;
+		}
+		key.hash = hash;
+
+		options.maxDownloads = header.number(4);
+		options.maxDownloadsPerHost = header.number(4);
+		options.maxRate = header.number(4);
+		options.segments = header.number(4);
+		options.segmentThreshold = header.number(4);
+		options.connectTimeout = header.number(4);
+		options.stallTimeout = header.number(4);
+		options.feedTimeout = header.number(4);
+		options.downloadTimeout = header.number(4);
+		options.retries = header.number(4);
+		options.retryDelay = header.number(4);
+		options.breakerThreshold = header.number(4);
+		options.breakerCooldown = header.number(4);
+		options.updateThreads = header.number(4);
+		options.minPollInterval = header.number(4);
+		options.maxPollInterval = header.number(4);
+		options.dataDir = header.string();
+		options.mediaStore = header.string();
+		options.sync = (SyncPolicy)header.number(1);
+		std::size_t count = header.number(4);
+		index.clear();
+		for(std::size_t i = 0; i < count; i++)
+		{
+			std::string uid = header.string();
+			index.push_back(std::make_pair(uid, header.number(4)));
+		}
+		std::size_t recordsLength = header.number(8);
+		if(data.size() - headerStart - headerLength != recordsLength)
+			return false;
+		records = data.substr(headerStart + headerLength);
+		return true;
+	}
+	catch(std::runtime_error& e)
+	{
+		return false;
+	}
+}
+
+void Config::writeSnapshot(const std::filesystem::path& snapshotFile, const Key& key) const
+{
+	std::string header;
+	appendString(header, key.configFile);
+	appendString(header, key.home);
+	appendString(header, key.dataHome);
+	appendNumber(header, key.modified, 8);
+	appendNumber(header, key.size, 8);
+	appendNumber(header, key.hash, 8);
+	appendNumber(header, options.maxDownloads, 4);
+	appendNumber(header, options.maxDownloadsPerHost, 4);
+	appendNumber(header, options.maxRate, 4);
+	appendNumber(header, options.segments, 4);
+	appendNumber(header, options.segmentThreshold, 4);
+	appendNumber(header, options.connectTimeout, 4);
+	appendNumber(header, options.stallTimeout, 4);
+	appendNumber(header, options.feedTimeout, 4);
+	appendNumber(header, options.downloadTimeout, 4);
+	appendNumber(header, options.retries, 4);
+	appendNumber(header, options.retryDelay, 4);
+	appendNumber(header, options.breakerThreshold, 4);
+	appendNumber(header, options.breakerCooldown, 4);
+	appendNumber(header, options.updateThreads, 4);
+	appendNumber(header, options.minPollInterval, 4);
+	appendNumber(header, options.maxPollInterval, 4);
+	appendString(header, options.dataDir.string());
+	appendString(header, options.mediaStore.string());
+	appendNumber(header, (unsigned)options.sync, 1);
+	appendNumber(header, index.size(), 4);
+	for(const auto& entry : index)
+	{
+		appendString(header, entry.first);
+		appendNumber(header, entry.second, 4);
+	}
+	appendNumber(header, records.size(), 8);
+
+	// Replace the snapshot atomically, it is only an optimization so errors are ignored
+	std::error_code ec;
+	std::filesystem::create_directories(snapshotFile.parent_path(), ec);
+	std::filesystem::path newFile = snapshotFile;
+	newFile += ".new";
+	std::ofstream ofs(newFile, std::ios::binary | std::ios::trunc);
+	ofs.write(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+	std::string prefix;
+	appendNumber(prefix, header.size(), 4);
+	appendNumber(prefix, fnv1a(header.data(), header.size()), 8);
+	ofs << prefix << header << records;
+	ofs.close();
+	if(ofs.fail())
+		std::filesystem::remove(newFile, ec);
+	else
+		std::filesystem::rename(newFile, snapshotFile, ec);
+}
+
+std::runtime_error Config::damaged() const
+{
+	std::error_code ec;
+	std::filesystem::remove(snapshotFile, ec);
+	return std::runtime_error("Configuration snapshot " + snapshotFile.string() + " was damaged and has been removed. Please try again.");
+}
+
+Feed Config::decode(std::size_t offset) const
+{
+	std::string uid, uri, basePath, filename, statePath;
+	unsigned priority;
+	std::vector<std::tuple<FilterType, std::string, std::string>> filters;
+	try
+	{
+		Decoder record = feedRecord(records, offset);
+		uid = record.string();
+		uri = record.string();
+		basePath = record.string();
+		filename = record.string();
+		statePath = record.string();
+		priority = record.number(4);
+		std::size_t filterCount = record.number(4);
+		for(std::size_t i = 0; i < filterCount; i++)
+		{
+			FilterType type = (FilterType)record.number(1);
+			std::string regex = record.string();
+			filters.push_back(std::make_tuple(type, regex, record.string()));
+		}
+	}
+	catch(std::runtime_error& e)
+	{
+		throw damaged();
+	}
+
+	std::vector<Filter> filterList;
+	for(const auto& filter : filters)
+	{
+		try {filterList.push_back(Filter(std::get<0>(filter), std::get<1>(filter), std::get<2>(filter)));}
+		catch(std::regex_error& e) {throw std::runtime_error("Invalid filter in feed with uid \"" + uid + "\". Attribute regex is not a valid regular expression: " + e.what());}
+	}
+	return Feed(uid, uri, basePath, filename, statePath, priority, filterList);
+}
+
+std::vector<std::string> Config::getUids() const
+{
+	std::vector<std::string> uids;
+	for(const auto& entry : index)
+		uids.push_back(entry.first);
+	return uids;
+}
+
+bool Config::contains(const std::string& uid) const
+{
+	for(const auto& entry : index)
+		if(entry.first == uid)
+			return true;
+	return false;
+}
+
+Feed Config::getFeed(const std::string& uid) const
+{
+	for(const auto& entry : index)
+		if(entry.first == uid)
+			return decode(entry.second);
+	throw std::runtime_error("No feed with UID \"" + uid + "\" exists.");
+}
+
+std::vector<Feed> Config::getFeeds() const
+{
+	std::vector<Feed> feedList;
+	feedList.reserve(index.size());
+	for(const auto& entry : index)
+		feedList.push_back(decode(entry.second));
+	return feedList;
+}
+
+std::vector<std::pair<std::string, std::filesystem::path>> Config::getStatePaths() const
+{
+	std::vector<std::pair<std::string, std::filesystem::path>> paths;
+	paths.reserve(index.size());
+	try
+	{
+		for(const auto& entry : index)
+		{
+			// Only the fields up to the state path are decoded, the filters are not compiled
+			Decoder record = feedRecord(records, entry.second);
+			std::string uid = record.string();
+			record.string(); // URI
+			record.string(); // Base path
+			record.string(); // Filename pattern
+			paths.emplace_back(uid, record.string());
+		}
+	}
+	catch(std::runtime_error& e)
+	{
+		throw damaged();
+	}
+	return paths;
+}
+
+std::vector<Feed> readConfigFile(std::string configFile, Options& options)
+{
+	Config config(configFile);
+	options = config.getOptions();
+	return config.getFeeds();
+}
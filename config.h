@@ -0,0 +1,124 @@
+/**
+ * \file config.h
+ * \brief Defines the Config class
+ */
+
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include<string>
+#include<vector>
+#include<utility>
+#include<cstdint>
+#include<cstddef>
+#include<filesystem>
+#include"feed.h"
+#include"options.h"
+
+/**
+ * \brief The contents of the configuration file
+ * \details Parsing the configuration file and compiling the regular
+ * expressions of all filters is slow for large files, so the validated
+ * configuration is kept in a binary snapshot file. As long as the
+ * configuration file's modification time and size (or, failing that, a hash of
+ * its contents) and the environment variables that determine the paths match
+ * those stored in the snapshot, the snapshot is used instead of the
+ * configuration file. Otherwise the configuration file is parsed and a new
+ * snapshot is written.
+ *
+ * Either way, feeds are only kept in their encoded form, and Feed objects
+ * (with their compiled filters) are only created for the feeds that are
+ * requested. Each encoded feed carries a checksum, so a damaged snapshot is
+ * detected when the feed is decoded.
+ */
+class Config
+{
+private:
+	struct Key
+	{
+		std::string configFile, home, dataHome;
+		std::int64_t modified;
+		std::uint64_t size, hash;
+	};
+
+	Options options;
+	std::filesystem::path snapshotFile;
+	std::string records;
+	std::vector<std::pair<std::string, std::size_t>> index;
+
+	std::uint64_t parse(const std::string& configFile);
+	bool readSnapshot(const std::filesystem::path& snapshotFile, Key& key, bool& stale);
+	void writeSnapshot(const std::filesystem::path& snapshotFile, const Key& key) const;
+	std::runtime_error damaged() const;
+	Feed decode(std::size_t offset) const;
+public:
+	/**
+	 * \brief Reads the configuration
+	 * \param configFile Name of the configuration file.
+	 * \param snapshotFile Name of the snapshot file. Its directory is created
+	 * if needed. If empty, no snapshot is used. Problems with the snapshot are
+	 * not errors, the configuration file is parsed instead.
+	 * \throws std::runtime_error If a problem occurs while parsing the config
+	 * file.
+	 */
+	Config(const std::string& configFile, const std::filesystem::path& snapshotFile = std::filesystem::path());
+
+	/**
+	 * \brief Returns the global settings
+	 * \return The settings from the attributes of the `<podlist>` element.
+	 */
+	const Options& getOptions() const {return options;}
+
+	/**
+	 * \brief Returns the uids of all feeds
+	 * \return The uids in the order of the configuration file.
+	 */
+	std::vector<std::string> getUids() const;
+
+	/**
+	 * \brief Checks whether a feed exists
+	 * \param uid The unique identifier string of a feed.
+	 * \return True if the configuration contains a feed with this uid.
+	 */
+	bool contains(const std::string& uid) const;
+
+	/**
+	 * \brief Creates the Feed object for a feed
+	 * \param uid The unique identifier string of the feed.
+	 * \return The feed.
+	 * \throws std::runtime_error If there is no such feed or the snapshot is
+	 * damaged.
+	 */
+	Feed getFeed(const std::string& uid) const;
+
+	/**
+	 * \brief Creates the Feed objects of all feeds
+	 * \return All feeds in the order of the configuration file.
+	 * \throws std::runtime_error If the snapshot is damaged.
+	 */
+	std::vector<Feed> getFeeds() const;
+
+	/**
+	 * \brief Returns where JPod keeps data about each feed
+	 * \details Much cheaper than getFeeds() for commands that only read the
+	 * stored data, e.g. the catalogs (see Feed#getCatalogPath()), as no Feed
+	 * objects are created and no filters are compiled.
+	 * \return The uids and state directories of all feeds in the order of
+	 * the configuration file.
+	 * \throws std::runtime_error If the snapshot is damaged.
+	 */
+	std::vector<std::pair<std::string, std::filesystem::path>> getStatePaths() const;
+};
+
+/**
+ * \brief Parse the configuration file and extract a list of all feeds
+ * \details This does not use a snapshot, see Config.
+ * \param configFile Name of the configuration file.
+ * \param options Receives the global settings from the attributes of the
+ * `<podlist>` element.
+ * \return List of all the feeds.
+ * \throws std::runtime_error If a problem occurs while parsing the config file.
+ */
+std::vector<Feed> readConfigFile(std::string configFile, Options& options);
+
+#endif //CONFIG_H
@@ -0,0 +1,229 @@
+/**
+ * \file dateparser.cpp
+ * \brief Implementation for dateparser.h
+ */
+
+#include<cstring>
+#include"dateparser.h"
+
+static const char MONTHS[] = "janfebmaraprmayjunjulaugsepoctnovdec";
+static const char WEEKDAYS[] = "sunmontuewedthufrisat";
+
+static bool isDigit(char c) {return c >= '0' && c <= '9';}
+static bool isAlpha(char c) {return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');}
+static char toLower(char c) {return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;}
+
+static void skipSpace(const char*& p)
+{
+	while(*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+		p++;
+}
+
+/// Reads between minDigits and maxDigits digits
+static bool readNumber(const char*& p, int minDigits, int maxDigits, int& value)
+{
+	int digits = 0;
+	value = 0;
+	while(digits < maxDigits && isDigit(*p))
+	{
+		value = value * 10 + (*p++ - '0');
+		digits++;
+	}
+	return digits >= minDigits;
+}
+
+/// Reads a name and returns the index of its first three letters in a table, or -1
+static int readName(const char*& p, const char* table, int count)
+{
+	if(!isAlpha(p[0]) || !isAlpha(p[1]) || !isAlpha(p[2]))
+		return -1;
+	char name[3] = {toLower(p[0]), toLower(p[1]), toLower(p[2])};
+	for(int i = 0; i < count; i++)
+	{
+		if(std::memcmp(name, table + 3 * i, 3) == 0)
+		{
+			while(isAlpha(*p))
+				p++;
+			return i;
+		}
+	}
+	return -1;
+}
+
+/// Reads a numeric zone (+HHMM, +HH:MM or +HH) and returns the offset in seconds
+static bool readNumericZone(const char*& p, long& offset)
+{
+	if(*p != '+' && *p != '-')
+		return false;
+	int sign = *p++ == '-' ? -1 : 1;
+	int hours, minutes = 0;
+	if(!readNumber(p, 2, 2, hours))
+		return false;
+	if(*p == ':')
+		p++;
+	if(isDigit(*p) && !readNumber(p, 2, 2, minutes))
+		return false;
+	if(hours > 23 || minutes > 59)
+		return false;
+	offset = sign * (hours * 3600L + minutes * 60L);
+	return true;
+}
+
+/// Reads the time of day (HH:MM[:SS])
+static bool readTime(const char*& p, std::tm& date)
+{
+	if(!readNumber(p, 1, 2, date.tm_hour) || *p++ != ':' || !readNumber(p, 2, 2, date.tm_min))
+		return false;
+	date.tm_sec = 0;
+	if(*p == ':')
+	{
+		p++;
+		if(!readNumber(p, 2, 2, date.tm_sec))
+			return false;
+	}
+	return true;
+}
+
+long DateParser::daysFromCivil(long year, unsigned month, unsigned day)
+{
+	// Days since 1970-01-01 in the proleptic Gregorian calendar (see Howard Hinnant's date algorithms)
+	year -= month <= 2;
+	long era = (year >= 0 ? year : year - 399) / 400;
+	unsigned yearOfEra = year - era * 400;
+	unsigned dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+	unsigned dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+	return era * 146097L + dayOfEra - 719468L;
+}
+
+bool DateParser::finish(std::tm& date, long offset, std::time_t& utc)
+{
+	static const int DAYS_IN_MONTH[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+	long year = 1900L + date.tm_year;
+	bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+	if(date.tm_mon < 0 || date.tm_mon > 11 || date.tm_mday < 1)
+		return false;
+	if(date.tm_mday > DAYS_IN_MONTH[date.tm_mon] + (date.tm_mon == 1 && leap))
+		return false;
+	if(date.tm_hour > 23 || date.tm_min > 59 || date.tm_sec > 60)
+		return false;
+
+	// Fill in the fields that follow from the date
+	long days = daysFromCivil(year, date.tm_mon + 1, date.tm_mday);
+	date.tm_wday = ((days + 4) % 7 + 7) % 7; // 1970-01-01 was a Thursday
+	date.tm_yday = days - daysFromCivil(year, 1, 1);
+	date.tm_isdst = 0;
+
+	utc = days * 86400L + date.tm_hour * 3600L + date.tm_min * 60L + date.tm_sec - offset;
+	return true;
+}
+
+bool DateParser::parse(const char* str, std::tm& date, std::time_t& utc)
+{
+	const char* p = str;
+	skipSpace(p);
+
+	// ISO 8601 dates start with a four digit year and a dash
+	if(isDigit(p[0]) && isDigit(p[1]) && isDigit(p[2]) && isDigit(p[3]) && p[4] == '-')
+		return parseIso8601(str, date, utc);
+	return parseRfc822(str, date, utc);
+}
+
+bool DateParser::parseRfc822(const char* str, std::tm& date, std::time_t& utc)
+{
+	const char* p = str;
+	date = std::tm();
+	skipSpace(p);
+
+	// Optional weekday, it is computed from the date anyway
+	if(isAlpha(*p))
+	{
+		if(readName(p, WEEKDAYS, 7) < 0)
+			return false;
+		skipSpace(p);
+		if(*p == ',')
+			p++;
+		skipSpace(p);
+	}
+
+	// Date
+	int year;
+	if(!readNumber(p, 1, 2, date.tm_mday))
+		return false;
+	skipSpace(p);
+	if((date.tm_mon = readName(p, MONTHS, 12)) < 0)
+		return false;
+	skipSpace(p);
+	const char* yearStart = p;
+	if(!readNumber(p, 2, 4, year) || p - yearStart == 3)
+		return false;
+	if(p - yearStart == 2)
+		year += year < 50 ? 2000 : 1900;
+	date.tm_year = year - 1900;
+
+	// Time
+	skipSpace(p);
+	if(!readTime(p, date))
+		return false;
+
+	// Zone, unknown ones (and anything after the zone) are ignored like they always have been
+	long offset = 0;
+	skipSpace(p);
+	if(*p == '+' || *p == '-')
+	{
+		if(!readNumericZone(p, offset))
+			offset = 0;
+	}
+	else if(isAlpha(*p))
+	{
+		char name[4] = {};
+		std::size_t length = 0;
+		while(isAlpha(p[length]) && length < 4)
+			length++;
+		for(std::size_t i = 0; i < length && i < 3; i++)
+			name[i] = toLower(p[i]);
+		if(length == 4) offset = 0;
+		else if(std::strcmp(name, "edt") == 0) offset = -4 * 3600;
+		else if(std::strcmp(name, "est") == 0 || std::strcmp(name, "cdt") == 0) offset = -5 * 3600;
+		else if(std::strcmp(name, "cst") == 0 || std::strcmp(name, "mdt") == 0) offset = -6 * 3600;
+		else if(std::strcmp(name, "mst") == 0 || std::strcmp(name, "pdt") == 0) offset = -7 * 3600;
+		else if(std::strcmp(name, "pst") == 0) offset = -8 * 3600;
+		else offset = 0; // UT, GMT, Z and military zones (RFC 2822 says to treat those as UTC)
+	}
+	return finish(date, offset, utc);
+}
+
+bool DateParser::parseIso8601(const char* str, std::tm& date, std::time_t& utc)
+{
+	const char* p = str;
+	date = std::tm();
+	skipSpace(p);
+
+	// Date
+	int year, month;
+	if(!readNumber(p, 4, 4, year) || *p++ != '-' || !readNumber(p, 2, 2, month) || *p++ != '-' || !readNumber(p, 2, 2, date.tm_mday))
+		return false;
+	date.tm_year = year - 1900;
+	date.tm_mon = month - 1;
+
+	// Time and zone
+	long offset = 0;
+	if((*p == 'T' || *p == 't' || *p == ' ') && isDigit(p[1]))
+	{
+		p++;
+		if(!readTime(p, date))
+			return false;
+		if(*p == '.' || *p == ',')
+		{
+			p++;
+			if(!isDigit(*p))
+				return false;
+			while(isDigit(*p))
+				p++;
+		}
+		if(*p == 'Z' || *p == 'z')
+			p++;
+		else if((*p == '+' || *p == '-') && !readNumericZone(p, offset))
+			return false;
+	}
+	return finish(date, offset, utc);
+}
@@ -0,0 +1,59 @@
+/**
+ * \file dateparser.h
+ * \brief Defines the DateParser class
+ */
+
+#ifndef DATEPARSER_H
+#define DATEPARSER_H
+
+#include<string>
+#include<ctime>
+
+/**
+ * \brief Parses the publication dates found in feeds
+ * \details Understands RFC 822 dates as used by RSS (e.g. "Tue, 02 Jan 2024
+ * 10:00:00 +0100") and ISO 8601 dates as used by Atom (e.g.
+ * "2024-01-02T10:00:00+01:00"). Parsing neither allocates memory nor depends
+ * on the locale.
+ *
+ * Supported RFC 822 variants: the weekday is optional, the day may have one
+ * or two digits, month and weekday names are case-insensitive and may be
+ * spelled out, the year may have two digits (00-49 are 20xx, 50-99 are
+ * 19xx), seconds are optional, and the zone may be numeric (+HHMM, +HH:MM),
+ * a name (UT, GMT, EST, EDT, CST, CDT, MST, MDT, PST, PDT), a military letter
+ * or missing (UTC). Unknown zone names are taken as UTC. ISO 8601 dates may
+ * have a time (separated by "T" or a space) with optional seconds and
+ * fractions, and a zone ("Z", +HH:MM, +HHMM or +HH), otherwise UTC is
+ * assumed.
+ */
+class DateParser
+{
+private:
+	static long daysFromCivil(long year, unsigned month, unsigned day);
+	static bool finish(std::tm& date, long offset, std::time_t& utc);
+public:
+	/**
+	 * \brief Parses a date
+	 * \param str The date as found in the feed.
+	 * \param date Receives the date and time as written, i.e. in the zone of
+	 * the date string. Weekday and day of the year are filled in as well.
+	 * \param utc Receives the point in time as a UTC timestamp.
+	 * \return True if successful, false if the string is not a date in one
+	 * of the supported formats.
+	 */
+	static bool parse(const char* str, std::tm& date, std::time_t& utc);
+
+	/**
+	 * \brief Parses an RFC 822 date
+	 * \copydetails parse()
+	 */
+	static bool parseRfc822(const char* str, std::tm& date, std::time_t& utc);
+
+	/**
+	 * \brief Parses an ISO 8601 date
+	 * \copydetails parse()
+	 */
+	static bool parseIso8601(const char* str, std::tm& date, std::time_t& utc);
+};
+
+#endif //DATEPARSER_H
@@ -0,0 +1,376 @@
+/**
+ * \file diskwriter.cpp
+ * \brief Implementation for diskwriter.h
+ */
+
+#include<stdexcept>
+#include<algorithm>
+#include<vector>
+#include<deque>
+#include<chrono>
+#include<cerrno>
+#include<cstring>
+#include<fcntl.h>
+#include<unistd.h>
+#include<sys/stat.h>
+#include<sys/mman.h>
+#include<sys/uio.h>
+#include<sys/syscall.h>
+#include<linux/io_uring.h>
+#include"diskwriter.h"
+
+/// Writes every piece of data right away
+class PwriteWriter : public DiskWriter
+{
+protected:
+	bool finish(int) override {return true;}
+public:
+	PwriteWriter(SyncPolicy policy): DiskWriter(policy) {}
+
+	bool write(int fd, std::uint64_t offset, const char* data, std::size_t size) override
+	{
+		return writeFully(fd, offset, data, size);
+	}
+};
+
+/**
+ * \brief Writes behind the network using io_uring
+ * \details Consecutive data for a file is collected in a buffer, and full
+ * buffers are handed to the kernel, which writes them while the next data
+ * arrives. The number of buffers limits how much data may be waiting.
+ * The buffers of one file are written one after another, so an interrupted
+ * download always leaves a file without holes that can be resumed.
+ */
+class UringWriter : public DiskWriter
+{
+private:
+	static constexpr unsigned QUEUE_DEPTH = 32;
+	static constexpr std::size_t BUFFER_SIZE = 128 * 1024;
+
+	struct Buffer
+	{
+		std::unique_ptr<char[]> data;
+		std::size_t length;
+		std::uint64_t offset;
+		int fd;
+		struct iovec iov;
+	};
+
+	struct File
+	{
+		/// The buffer being filled, -1 if none
+		int filling = -1;
+		/// Whether a buffer of the file is being written by the kernel
+		bool writing = false;
+		/// Full buffers waiting for the one being written
+		std::deque<int> queued;
+		bool failed = false;
+	};
+
+	int ring;
+	void* sqRing;
+	void* cqRing;
+	std::size_t sqRingSize, cqRingSize, sqesSize;
+	unsigned *sqHead, *sqTail, *sqMask, *sqArray, *cqHead, *cqTail, *cqMask;
+	struct io_uring_sqe* sqes;
+	struct io_uring_cqe* cqes;
+	std::vector<Buffer> buffers;
+	std::vector<int> freeBuffers;
+	std::map<int, File> files;
+	unsigned inFlight;
+
+	void unmap();
+	void enqueue(File& file, int index);
+	void submit(File& file, int index);
+	void reap(bool wait);
+	int acquire();
+protected:
+	bool finish(int fd) override;
+public:
+	UringWriter(SyncPolicy policy);
+	~UringWriter();
+	bool write(int fd, std::uint64_t offset, const char* data, std::size_t size) override;
+};
+
+UringWriter::UringWriter(SyncPolicy policy)
+: DiskWriter(policy), sqRing(MAP_FAILED), cqRing(MAP_FAILED), sqes((struct io_uring_sqe*)MAP_FAILED), buffers(QUEUE_DEPTH), inFlight(0)
+{
+	struct io_uring_params params;
+	std::memset(&params, 0, sizeof(params));
+	ring = syscall(__NR_io_uring_setup, QUEUE_DEPTH, &params);
+	if(ring < 0)
+		throw std::runtime_error("io_uring is not available");
+
+	// Map the rings, which share one mapping on newer kernels
+	sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+	if(single)
+		sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+	sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+	sqRing = mmap(NULL, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+	cqRing = single ? sqRing : mmap(NULL, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_CQ_RING);
+	sqes = (struct io_uring_sqe*)mmap(NULL, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES);
+	if(sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqes == MAP_FAILED)
+	{
+		unmap();
+		throw std::runtime_error("io_uring is not available");
+	}
+	sqHead = (unsigned*)((char*)sqRing + params.sq_off.head);
+	sqTail = (unsigned*)((char*)sqRing + params.sq_off.tail);
+	sqMask = (unsigned*)((char*)sqRing + params.sq_off.ring_mask);
+	sqArray = (unsigned*)((char*)sqRing + params.sq_off.array);
+	cqHead = (unsigned*)((char*)cqRing + params.cq_off.head);
+	cqTail = (unsigned*)((char*)cqRing + params.cq_off.tail);
+	cqMask = (unsigned*)((char*)cqRing + params.cq_off.ring_mask);
+	cqes = (struct io_uring_cqe*)((char*)cqRing + params.cq_off.cqes);
+
+	for(int i = QUEUE_DEPTH - 1; i >= 0; i--)
+		freeBuffers.push_back(i);
+}
+
+UringWriter::~UringWriter()
+{
+	// The kernel may still be writing from the buffers
+	while(inFlight > 0)
+		reap(true);
+	unmap();
+}
+
+void UringWriter::unmap()
+{
+	if(sqes != MAP_FAILED)
+		munmap(sqes, sqesSize);
+	if(cqRing != MAP_FAILED && cqRing != sqRing)
+		munmap(cqRing, cqRingSize);
+	if(sqRing != MAP_FAILED)
+		munmap(sqRing, sqRingSize);
+	::close(ring);
+}
+
+void UringWriter::enqueue(File& file, int index)
+{
+	if(file.failed)
+		freeBuffers.push_back(index);
+	else if(file.writing)
+		file.queued.push_back(index);
+	else
+		submit(file, index);
+}
+
+void UringWriter::submit(File& file, int index)
+{
+	Buffer& buffer = buffers[index];
+	buffer.iov.iov_base = buffer.data.get();
+	buffer.iov.iov_len = buffer.length;
+
+	// Vectored writes are supported since the first version of io_uring
+	unsigned tail = *sqTail, slot = tail & *sqMask;
+	struct io_uring_sqe* sqe = &sqes[slot];
+	std::memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = IORING_OP_WRITEV;
+	sqe->fd = buffer.fd;
+	sqe->off = buffer.offset;
+	sqe->addr = (std::uint64_t)(std::uintptr_t)&buffer.iov;
+	sqe->len = 1;
+	sqe->user_data = index;
+	sqArray[slot] = slot;
+	__atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+
+	// At most QUEUE_DEPTH writes are in flight, so the completion queue cannot overflow
+	int result;
+	while((result = syscall(__NR_io_uring_enter, ring, 1, 0, 0, NULL, 0)) < 0 && errno == EINTR);
+	if(result < 0)
+	{
+		// Take the entry back and write synchronously instead
+		__atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+		file.failed = !writeFully(buffer.fd, buffer.offset, buffer.data.get(), buffer.length);
+		freeBuffers.push_back(index);
+		if(!file.queued.empty())
+		{
+			index = file.queued.front();
+			file.queued.pop_front();
+			enqueue(file, index);
+		}
+		return;
+	}
+	file.writing = true;
+	inFlight++;
+}
+
+void UringWriter::reap(bool wait)
+{
+	if(wait)
+		while(syscall(__NR_io_uring_enter, ring, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0 && errno == EINTR);
+
+	unsigned head = *cqHead, tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+	for(; head != tail; head++)
+	{
+		const struct io_uring_cqe& cqe = cqes[head & *cqMask];
+		int index = cqe.user_data;
+		Buffer& buffer = buffers[index];
+		File& file = files[buffer.fd];
+		// A short write (e.g. the disk is full) is completed synchronously, which reports the error
+		if(cqe.res < 0 || ((std::size_t)cqe.res < buffer.length && !writeFully(buffer.fd, buffer.offset + cqe.res, buffer.data.get() + cqe.res, buffer.length - cqe.res)))
+			file.failed = true;
+		file.writing = false;
+		inFlight--;
+		freeBuffers.push_back(index);
+
+		// Start on the next buffer of the file, or drop them all after an error
+		while(!file.queued.empty() && !file.writing)
+		{
+			index = file.queued.front();
+			file.queued.pop_front();
+			enqueue(file, index);
+		}
+	}
+	__atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+}
+
+int UringWriter::acquire()
+{
+	while(freeBuffers.empty())
+	{
+		// If every buffer is being filled, send them off to make room
+		if(inFlight == 0)
+		{
+			for(auto& entry : files)
+			{
+				if(entry.second.filling >= 0)
+				{
+					enqueue(entry.second, entry.second.filling);
+					entry.second.filling = -1;
+				}
+			}
+		}
+		if(inFlight > 0)
+			reap(true);
+	}
+	int index = freeBuffers.back();
+	freeBuffers.pop_back();
+	if(!buffers[index].data)
+		buffers[index].data.reset(new char[BUFFER_SIZE]);
+	return index;
+}
+
+bool UringWriter::write(int fd, std::uint64_t offset, const char* data, std::size_t size)
+{
+	reap(false);
+	File& file = files[fd];
+	while(size > 0 && !file.failed)
+	{
+		// Data that does not continue the buffer goes into a new one
+		if(file.filling >= 0 && buffers[file.filling].offset + buffers[file.filling].length != offset)
+		{
+			enqueue(file, file.filling);
+			file.filling = -1;
+		}
+		if(file.filling < 0)
+		{
+			int index = acquire();
+			file.filling = index;
+			buffers[index].fd = fd;
+			buffers[index].offset = offset;
+			buffers[index].length = 0;
+		}
+		Buffer& buffer = buffers[file.filling];
+		std::size_t length = std::min(size, BUFFER_SIZE - buffer.length);
+		std::memcpy(buffer.data.get() + buffer.length, data, length);
+		buffer.length += length;
+		data += length;
+		size -= length;
+		offset += length;
+		if(buffer.length == BUFFER_SIZE)
+		{
+			enqueue(file, file.filling);
+			file.filling = -1;
+		}
+	}
+	return !file.failed;
+}
+
+bool UringWriter::finish(int fd)
+{
+	auto iter = files.find(fd);
+	if(iter == files.end())
+		return true;
+	File& file = iter->second;
+	if(file.filling >= 0)
+	{
+		enqueue(file, file.filling);
+		file.filling = -1;
+	}
+	while(file.writing)
+		reap(true);
+	bool success = !file.failed;
+	files.erase(iter);
+	return success;
+}
+
+DiskWriter::~DiskWriter()
+{
+	for(auto& entry : syncTargets)
+		::close(entry.second);
+}
+
+std::unique_ptr<DiskWriter> DiskWriter::create(SyncPolicy policy)
+{
+	try
+	{
+		return std::make_unique<UringWriter>(policy);
+	}
+	catch(std::runtime_error& e)
+	{
+		return std::make_unique<PwriteWriter>(policy);
+	}
+}
+
+bool DiskWriter::writeFully(int fd, std::uint64_t offset, const char* data, std::size_t size)
+{
+	while(size > 0)
+	{
+		ssize_t written = pwrite(fd, data, size, offset);
+		if(written < 0 && errno == EINTR)
+			continue;
+		if(written <= 0)
+			return false;
+		data += written;
+		size -= written;
+		offset += written;
+	}
+	return true;
+}
+
+bool DiskWriter::close(int fd, bool keep)
+{
+	bool success = finish(fd);
+	if(success && keep && policy == SyncPolicy::EPISODE)
+		success = fsync(fd) == 0;
+	else if(success && keep && policy == SyncPolicy::RUN)
+	{
+		// Remember one file per file system to call syncfs() on
+		struct stat st;
+		if(fstat(fd, &st) == 0 && !syncTargets.count(st.st_dev))
+		{
+			int target = dup(fd);
+			if(target >= 0)
+				syncTargets[st.st_dev] = target;
+		}
+	}
+	if(::close(fd) != 0)
+		success = false;
+	return success;
+}
+
+double DiskWriter::sync()
+{
+	auto start = std::chrono::steady_clock::now();
+	for(auto& entry : syncTargets)
+	{
+		syncfs(entry.second);
+		::close(entry.second);
+	}
+	syncTargets.clear();
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
@@ -0,0 +1,113 @@
+/**
+ * \file diskwriter.h
+ * \brief Defines the DiskWriter class and the SyncPolicy enumeration
+ */
+
+#ifndef DISKWRITER_H
+#define DISKWRITER_H
+
+#include<map>
+#include<memory>
+#include<cstdint>
+#include<cstddef>
+#include<sys/types.h>
+
+/**
+ * \brief When downloaded episodes are flushed to disk
+ */
+enum class SyncPolicy
+{
+	/// Never, the operating system writes them back eventually
+	NONE,
+	/// Each episode before it is moved to its final name
+	EPISODE,
+	/// Once at the end of a run, for each file system that episodes were written to
+	RUN
+};
+
+/**
+ * \brief The stage that writes downloaded data to files
+ * \details Files are written with explicit offsets, so data can be written
+ * behind the network: write() may return before the data is on its way to
+ * disk, and close() waits until everything queued for the file has been
+ * written. create() picks the best implementation available:
+ * - io_uring: data is copied into a pool of buffers that are written
+ *   asynchronously by the kernel while the next data arrives, so write() only
+ *   blocks when all buffers are in flight. The ring is set up with raw system
+ *   calls (Linux 5.1 or later), no library is needed.
+ * - pwrite(): every write() blocks until the kernel has taken the data.
+ *
+ * A DiskWriter is not thread-safe; it is meant to be used from the thread
+ * that drives the transfers (see DownloadEngine).
+ */
+class DiskWriter
+{
+private:
+	SyncPolicy policy;
+	std::map<dev_t, int> syncTargets;
+protected:
+	/// Writes all of size bytes at offset, returns false on error
+	static bool writeFully(int fd, std::uint64_t offset, const char* data, std::size_t size);
+
+	/**
+	 * \brief Waits until everything queued for a file has been written
+	 * \param fd The file descriptor.
+	 * \return False if any write to the file failed.
+	 */
+	virtual bool finish(int fd) = 0;
+public:
+	/**
+	 * \brief Creates a DiskWriter
+	 * \param policy When the files closed with close() are flushed to disk.
+	 */
+	DiskWriter(SyncPolicy policy): policy(policy) {}
+
+	/**
+	 * \brief Destructor
+	 * \details Does not sync(), but closes what it kept open for it.
+	 */
+	virtual ~DiskWriter();
+
+	DiskWriter(const DiskWriter&) = delete;
+	DiskWriter& operator=(const DiskWriter&) = delete;
+
+	/**
+	 * \brief Creates the best DiskWriter this system supports
+	 * \param policy See DiskWriter().
+	 * \return A writer using io_uring or, if that is not available, pwrite().
+	 */
+	static std::unique_ptr<DiskWriter> create(SyncPolicy policy);
+
+	/**
+	 * \brief Writes data to a file
+	 * \details The data is copied or written before the call returns, the
+	 * caller may reuse it immediately. Errors may be reported later, by
+	 * close().
+	 * \param fd The file descriptor, opened for writing.
+	 * \param offset Where in the file the data goes.
+	 * \param data Pointer to the data.
+	 * \param size Number of bytes.
+	 * \return False if writing to the file has failed.
+	 */
+	virtual bool write(int fd, std::uint64_t offset, const char* data, std::size_t size) = 0;
+
+	/**
+	 * \brief Completes the writes to a file and closes it
+	 * \param fd The file descriptor. It is closed in any case.
+	 * \param keep True if the file is complete and should be flushed
+	 * according to the SyncPolicy, false if it is going to be discarded or
+	 * resumed later anyway.
+	 * \return False if a write or the flush failed.
+	 */
+	bool close(int fd, bool keep);
+
+	/**
+	 * \brief Flushes the files closed so far if the policy is SyncPolicy::RUN
+	 * \details Calls syncfs() once for each file system that files were
+	 * written to.
+	 * \return The time spent flushing, in seconds.
+	 */
+	double sync();
+};
+
+#endif //DISKWRITER_H
@@ -0,0 +1,387 @@
+/**
+ * \file download.cpp
+ * \brief Implementation for download.h
+ */
+
+#include<stdexcept>
+#include<algorithm>
+#include<cstdio>
+#include"download.h"
+#include"transfercontext.h"
+
+Download::Download(std::string uri, std::filesystem::path filename, DiskWriter& writer, const std::string& etag, const std::string& lastModified)
+: uri(uri), file(filename, uri, writer), conditional(!etag.empty() || !lastModified.empty()), requestHeaders(NULL), scheduler(NULL), schedulerId(0), maxSegments(1), segmentThreshold(0), total(0), offset(0), segmentBytes(0), repairs(0), curlEnded(false), rejected(false), handedOver(false), created(std::chrono::steady_clock::now())
+{
+	curl = TransferContext::get().acquire(TransferKind::EPISODE);
+
+	// Prepare HTTP GET request, the body is streamed into the file
+	curl_easy_setopt(curl, CURLOPT_URL, this->uri.c_str());
+	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, curlWrite);
+	curl_easy_setopt(curl, CURLOPT_WRITEDATA, this);
+	curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, ResponseHeaders::curlHeader);
+	curl_easy_setopt(curl, CURLOPT_HEADERDATA, &responseHeaders);
+	curl_easy_setopt(curl, CURLOPT_PRIVATE, this);
+
+	// Only request the file if it differs from the available copy
+	if(conditional)
+	{
+		if(!etag.empty())
+			requestHeaders = curl_slist_append(requestHeaders, ("If-None-Match: " + etag).c_str());
+		if(!lastModified.empty())
+			requestHeaders = curl_slist_append(requestHeaders, ("If-Modified-Since: " + lastModified).c_str());
+		curl_easy_setopt(curl, CURLOPT_HTTPHEADER, requestHeaders);
+	}
+	// Only request the rest of an interrupted download, unless the file has changed since
+	else if(file.getResumeOffset() > 0)
+	{
+		requestHeaders = curl_slist_append(requestHeaders, ("If-Range: " + file.getResumeValidator()).c_str());
+		curl_easy_setopt(curl, CURLOPT_HTTPHEADER, requestHeaders);
+		curl_easy_setopt(curl, CURLOPT_RANGE, (std::to_string(file.getResumeOffset()) + "-").c_str());
+	}
+}
+
+Download::~Download()
+{
+	for(auto& segment : segments)
+	{
+		if(segment->curl)
+			TransferContext::get().release(segment->curl);
+		curl_slist_free_all(segment->requestHeaders);
+	}
+	TransferContext::get().release(curl);
+	curl_slist_free_all(requestHeaders);
+}
+
+std::vector<CURL*> Download::getHandles() const
+{
+	std::vector<CURL*> handles;
+	if(!curlEnded)
+		handles.push_back(curl);
+	for(const auto& segment : segments)
+		if(segment->curl)
+			handles.push_back(segment->curl);
+	return handles;
+}
+
+void Download::setSegmentation(unsigned segments, std::uint64_t threshold)
+{
+	maxSegments = segments;
+	segmentThreshold = threshold;
+}
+
+std::vector<CURL*> Download::takeNewHandles()
+{
+	std::vector<CURL*> handles;
+	handles.swap(newHandles);
+	return handles;
+}
+
+void Download::setScheduler(BandwidthScheduler* scheduler, unsigned id)
+{
+	this->scheduler = scheduler;
+	schedulerId = id;
+}
+
+DownloadStats Download::getStats() const
+{
+	DownloadStats stats;
+	curl_off_t bytes = 0, time = 0;
+	curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &stats.responseCode);
+	curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &bytes);
+	curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &time);
+	stats.bytes = bytes + segmentBytes;
+	stats.seconds = time / 1e6;
+	if(!segments.empty())
+		stats.seconds = std::max(stats.seconds, std::chrono::duration<double>(lastEnded - created).count());
+	stats.connections = stats.responseCode ? 1 : 0;
+	for(const auto& segment : segments)
+		stats.connections += segment->received > 0;
+	stats.diskSeconds = file.getDiskSeconds();
+	stats.resumedFrom = stats.responseCode == 206 ? file.getResumeOffset() : 0;
+	stats.fromMediaStore = conditional && stats.responseCode == 304;
+	return stats;
+}
+
+void Download::openFile()
+{
+	long responseCode;
+	curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &responseCode);
+	char* ct = NULL;
+	curl_easy_getinfo(curl, CURLINFO_CONTENT_TYPE, &ct);
+	curl_off_t contentLength = -1;
+	curl_easy_getinfo(curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &contentLength);
+
+	if(responseCode == 206)
+	{
+		// Make sure the server sends exactly the missing part ("bytes <first>-<last>/<total>")
+		unsigned long long first, last, total;
+		if(file.getResumeOffset() == 0 || std::sscanf(responseHeaders.contentRange.c_str(), "bytes %llu-%llu/%llu", &first, &last, &total) != 3 || first != file.getResumeOffset() || last + 1 != total)
+			throw std::runtime_error("Server sent an unexpected range: " + responseHeaders.contentRange);
+		file.open(ct ? ct : "", true, total, responseHeaders.etag, responseHeaders.lastModified);
+	}
+	else
+	{
+		file.open(ct ? ct : "", false, contentLength > 0 ? contentLength : 0, responseHeaders.etag, responseHeaders.lastModified);
+		if(maxSegments > 1 && contentLength > 0 && (std::uint64_t)contentLength >= segmentThreshold)
+		{
+			total = contentLength;
+			split();
+		}
+	}
+}
+
+void Download::split()
+{
+	// Without a validator, a segment might get a different version of the file
+	const std::uint64_t MIN_SEGMENT = 1024 * 1024;
+	if(responseHeaders.acceptRanges != "bytes" || file.getResumeValidator().empty())
+		return;
+	unsigned count = std::min<std::uint64_t>(maxSegments, total / MIN_SEGMENT);
+	for(unsigned i = 1; i < count; i++)
+		addSegment(total * i / count, total * (i + 1) / count, false);
+}
+
+void Download::addSegment(std::uint64_t start, std::uint64_t end, bool repair)
+{
+	std::unique_ptr<Segment> segment(new Segment{this, NULL, NULL, ResponseHeaders(), start, end, 0, 0, repair, false, false, false});
+	try
+	{
+		segment->curl = TransferContext::get().acquire(TransferKind::EPISODE);
+	}
+	catch(std::runtime_error& e)
+	{
+		return; // The first request carries on or the part is missing in the end
+	}
+
+	// Ask for the same file the first request got, on a connection of its own (HTTP/2 would share one)
+	char* url = NULL;
+	curl_easy_getinfo(curl, CURLINFO_EFFECTIVE_URL, &url);
+	curl_easy_setopt(segment->curl, CURLOPT_URL, url ? url : uri.c_str());
+	curl_easy_setopt(segment->curl, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_1_1);
+	curl_easy_setopt(segment->curl, CURLOPT_WRITEFUNCTION, curlWriteSegment);
+	curl_easy_setopt(segment->curl, CURLOPT_WRITEDATA, segment.get());
+	curl_easy_setopt(segment->curl, CURLOPT_HEADERFUNCTION, ResponseHeaders::curlHeader);
+	curl_easy_setopt(segment->curl, CURLOPT_HEADERDATA, &segment->responseHeaders);
+	curl_easy_setopt(segment->curl, CURLOPT_PRIVATE, this);
+	curl_easy_setopt(segment->curl, CURLOPT_RANGE, (std::to_string(start) + "-" + std::to_string(end - 1)).c_str());
+	segment->requestHeaders = curl_slist_append(NULL, ("If-Range: " + file.getResumeValidator()).c_str());
+	curl_easy_setopt(segment->curl, CURLOPT_HTTPHEADER, segment->requestHeaders);
+	newHandles.push_back(segment->curl);
+	segments.push_back(std::move(segment));
+}
+
+bool Download::acceptSegment(Segment& segment)
+{
+	// Only exactly the requested range of the same file will do
+	long responseCode;
+	curl_easy_getinfo(segment.curl, CURLINFO_RESPONSE_CODE, &responseCode);
+	unsigned long long first, last, length;
+	if(responseCode != 206 || std::sscanf(segment.responseHeaders.contentRange.c_str(), "bytes %llu-%llu/%llu", &first, &last, &length) != 3 || first != segment.start || last + 1 != segment.end || length != total)
+		return false;
+
+	// The first request may have got there first
+	if(offset > segment.start && (!curlEnded || offset >= segment.end))
+		return false;
+	try
+	{
+		segment.stream = file.addStream();
+	}
+	catch(std::runtime_error& e)
+	{
+		return false;
+	}
+	segment.started = true;
+	return true;
+}
+
+size_t Download::writeSegmented(const char* data, size_t size)
+{
+	std::size_t written = 0;
+	while(written < size)
+	{
+		// Stop where a segment has taken over, otherwise carry on through segments that have not
+		std::uint64_t limit = total;
+		for(const auto& segment : segments)
+		{
+			if(segment->repair)
+				continue;
+			if(segment->start == offset && segment->started && !segment->failed)
+			{
+				handedOver = true;
+				return written;
+			}
+			if(segment->start > offset)
+				limit = std::min(limit, segment->start);
+		}
+		std::size_t length = std::min<std::uint64_t>(size - written, limit - offset);
+		if(length == 0)
+			return written; // More than Content-Length
+		if(!file.writeAt(0, offset, data + written, length))
+		{
+			error = "Unable to write to temporary file";
+			return 0;
+		}
+		offset += length;
+		written += length;
+	}
+	return size;
+}
+
+bool Download::ended(CURL* handle, CURLcode result)
+{
+	lastEnded = std::chrono::steady_clock::now();
+	if(handle == curl)
+		curlEnded = true;
+	for(auto& segment : segments)
+	{
+		if(segment->curl != handle)
+			continue;
+		segment->ended = true;
+		segment->failed = result != CURLE_OK || segment->received < segment->end - segment->start;
+		if(segment->started)
+			file.closeStream(segment->stream);
+		curl_off_t bytes = 0;
+		curl_easy_getinfo(handle, CURLINFO_SIZE_DOWNLOAD_T, &bytes);
+		segmentBytes += bytes;
+		TransferContext::get().release(handle);
+		segment->curl = NULL;
+	}
+	if(!segments.empty() && error.empty())
+		repair();
+	if(!curlEnded || !newHandles.empty())
+		return false;
+	for(const auto& segment : segments)
+		if(!segment->ended)
+			return false;
+	return true;
+}
+
+void Download::repair()
+{
+	// While the first request is running, it carries on through failed segments ahead of it
+	if(!curlEnded)
+		return;
+
+	// Request what nobody has received or is still receiving, but only so many times
+	std::vector<std::pair<std::uint64_t, std::uint64_t>> covered{{0, offset}};
+	for(const auto& segment : segments)
+		covered.push_back({segment->start, segment->ended ? segment->start + segment->received : segment->end});
+	std::sort(covered.begin(), covered.end());
+	std::uint64_t position = 0;
+	for(const auto& range : covered)
+	{
+		if(range.first > position && repairs < maxSegments)
+		{
+			addSegment(position, range.first, true);
+			repairs++;
+		}
+		position = std::max(position, range.second);
+	}
+	if(position < total && repairs < maxSegments)
+	{
+		addSegment(position, total, true);
+		repairs++;
+	}
+}
+
+std::uint64_t Download::completeLength() const
+{
+	std::vector<std::pair<std::uint64_t, std::uint64_t>> received{{0, offset}};
+	for(const auto& segment : segments)
+		received.push_back({segment->start, segment->start + segment->received});
+	std::sort(received.begin(), received.end());
+	std::uint64_t length = 0;
+	for(const auto& range : received)
+		if(range.first <= length)
+			length = std::max(length, range.second);
+	return length;
+}
+
+// Callback function for CURL to write data
+size_t Download::curlWrite(void* ptr, size_t size, size_t nmemb, Download* download)
+{
+	// The headers are complete once the first chunk of the body arrives
+	if(!download->file.isOpen())
+	{
+		long responseCode;
+		curl_easy_getinfo(download->curl, CURLINFO_RESPONSE_CODE, &responseCode);
+		if(responseCode != 200 && responseCode != 206)
+		{
+			download->rejected = true;
+			return 0; // Don't store error pages, abort instead
+		}
+		try
+		{
+			download->openFile();
+		}
+		catch(std::runtime_error& e)
+		{
+			download->error = e.what();
+			return 0;
+		}
+	}
+	if(download->scheduler && !download->scheduler->request(download->schedulerId, size * nmemb))
+		return CURL_WRITEFUNC_PAUSE;
+	if(!download->segments.empty())
+		return download->writeSegmented((char*)ptr, size * nmemb);
+	if(!download->file.write((char*)ptr, size * nmemb))
+	{
+		download->error = "Unable to write to temporary file";
+		return 0;
+	}
+	return size * nmemb;
+}
+
+// Callback function for CURL to write the data of a segment
+size_t Download::curlWriteSegment(void* ptr, size_t size, size_t nmemb, Segment* segment)
+{
+	Download* download = segment->download;
+	if(!segment->started && !download->acceptSegment(*segment))
+		return 0; // The part is left to others
+	if(download->scheduler && !download->scheduler->request(download->schedulerId, size * nmemb))
+		return CURL_WRITEFUNC_PAUSE;
+	std::size_t length = std::min<std::uint64_t>(size * nmemb, segment->end - segment->start - segment->received);
+	if(!download->file.writeAt(segment->stream, segment->start + segment->received, (char*)ptr, length))
+	{
+		download->error = "Unable to write to temporary file";
+		return 0;
+	}
+	segment->received += length;
+	return length;
+}
+
+std::filesystem::path Download::finish(CURLcode result)
+{
+	long responseCode;
+	curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &responseCode);
+
+	if(!error.empty())
+		throw std::runtime_error(error);
+	if(result != CURLE_OK && result != CURLE_WRITE_ERROR && !file.isOpen())
+		throw std::runtime_error("Unable to connect to server");
+	if(conditional && responseCode == 304 && result == CURLE_OK)
+		return std::filesystem::path(); // The available copy is current
+	if(responseCode == 416)
+		file.discard(); // The partial file does not match the server's file, start over next time
+	if(responseCode != 200 && responseCode != 206)
+		throw std::runtime_error("Unable to download the episode from \"" + uri + "\", got response code " + std::to_string(responseCode));
+
+	// A file received in segments is complete if every byte has been received by one transfer or another
+	if(!segments.empty())
+	{
+		std::uint64_t length = completeLength();
+		if(length < total)
+		{
+			file.truncate(length); // Keep the beginning for resuming
+			throw std::runtime_error("Download is incomplete, got the first " + std::to_string(length) + " of " + std::to_string(total) + " bytes");
+		}
+		return file.commit();
+	}
+	if(result != CURLE_OK)
+		throw std::runtime_error(std::string("Download was interrupted: ") + curl_easy_strerror(result));
+
+	// Move the complete file to its final name (an empty body never opened it)
+	if(!file.isOpen())
+		openFile();
+	return file.commit();
+}
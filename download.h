@@ -0,0 +1,242 @@
+/**
+ * \file download.h
+ * \brief Defines the Download class
+ */
+
+#ifndef DOWNLOAD_H
+#define DOWNLOAD_H
+
+#include<string>
+#include<vector>
+#include<memory>
+#include<chrono>
+#include<filesystem>
+#include<curl/curl.h>
+#include"downloadfile.h"
+#include"responseheaders.h"
+#include"bandwidthscheduler.h"
+
+/**
+ * \brief Statistics about a finished transfer
+ */
+struct DownloadStats
+{
+	/// The HTTP status of the response, 0 if none was received
+	long responseCode = 0;
+	/// Number of bytes received (the body only)
+	std::uint64_t bytes = 0;
+	/// Where the transfer continued an earlier, interrupted download, 0 if it started from the beginning
+	std::uint64_t resumedFrom = 0;
+	/// Duration of the transfer in seconds (of all of them if the file was split into segments)
+	double seconds = 0;
+	/// Time spent waiting for the disk in seconds, while writing and when the file was completed
+	double diskSeconds = 0;
+	/// Whether the file came from the media store (responseCode is 304 if the server confirmed it, 0 if it was not asked)
+	bool fromMediaStore = false;
+	/// Number of transfers the file was received over, more than 1 if it was split into segments
+	unsigned connections = 0;
+	/// Number of times the download was tried again after a transient failure (see DownloadEngine)
+	unsigned retries = 0;
+};
+
+/**
+ * \brief A single HTTP transfer of an episode into a file
+ * \details Wraps a CURL easy handle that streams the response body into a
+ * DownloadFile. If the DownloadFile holds the beginning of an earlier,
+ * interrupted download, only the rest is requested (using the Range and
+ * If-Range headers). Should the server not honour the range, the whole file is
+ * downloaded again. The handle is added to a CURL multi handle (see
+ * DownloadEngine), and finish() must be called with the result of the
+ * transfer.
+ * If a copy of the file is available elsewhere (see MediaStore), its
+ * validators make the request conditional instead, and the server's 304 Not
+ * Modified answer confirms the copy without transferring the file.
+ *
+ * With setSegmentation(), a large file is transferred over several
+ * connections at once, if the server accepts ranges: once the response
+ * headers of the first request are known, the rest of the file is split into
+ * segments that are requested separately and written into the partial file at
+ * their offsets. The first request stops where a segment has taken over. If a
+ * segment is refused or interrupted, the first request carries on through it
+ * or, if it has already stopped, the missing part is requested again. Such
+ * additional transfers are handed to the caller by takeNewHandles(), and each
+ * transfer's end is reported with ended().
+ */
+class Download
+{
+private:
+	/// A part of the file that is requested separately
+	struct Segment
+	{
+		Download* download;
+		CURL* curl;
+		struct curl_slist* requestHeaders;
+		ResponseHeaders responseHeaders;
+		std::uint64_t start, end, received;
+		unsigned stream;
+		bool repair, started, ended, failed;
+	};
+
+	std::string uri;
+	DownloadFile file;
+	bool conditional;
+	CURL* curl;
+	struct curl_slist* requestHeaders;
+	ResponseHeaders responseHeaders;
+	std::string error;
+	BandwidthScheduler* scheduler;
+	unsigned schedulerId;
+	unsigned maxSegments;
+	std::uint64_t segmentThreshold, total, offset, segmentBytes;
+	std::vector<std::unique_ptr<Segment>> segments;
+	std::vector<CURL*> newHandles;
+	unsigned repairs;
+	bool curlEnded, rejected, handedOver;
+	std::chrono::steady_clock::time_point created, lastEnded;
+
+	void openFile();
+	void split();
+	void addSegment(std::uint64_t start, std::uint64_t end, bool repair);
+	bool acceptSegment(Segment& segment);
+	size_t writeSegmented(const char* data, size_t size);
+	void repair();
+	std::uint64_t completeLength() const;
+	static size_t curlWrite(void* ptr, size_t size, size_t nmemb, Download* download);
+	static size_t curlWriteSegment(void* ptr, size_t size, size_t nmemb, Segment* segment);
+public:
+	/**
+	 * \brief Prepares a download
+	 * \details The CURL handle is obtained from the TransferContext.
+	 * \param uri The URI of the file to download.
+	 * \param filename The name (including path, excluding extension) of the
+	 * file where the downloaded data should be written.
+	 * \param writer The writer for the data, it must outlive the Download.
+	 * \param etag The ETag of an available copy of the file. If it or
+	 * lastModified is given, the file is only transferred if it differs from
+	 * the copy, and an interrupted download is not resumed.
+	 * \param lastModified The Last-Modified date of an available copy.
+	 * \throws std::runtime_error If CURL could not be initialized.
+	 */
+	Download(std::string uri, std::filesystem::path filename, DiskWriter& writer, const std::string& etag = "", const std::string& lastModified = "");
+
+	/**
+	 * \brief Destructor
+	 * \details Returns the CURL handle to the TransferContext. If finish() did not succeed, the
+	 * temporary file is removed.
+	 */
+	~Download();
+
+	Download(const Download&) = delete;
+	Download& operator=(const Download&) = delete;
+
+	/**
+	 * \brief Returns the URI of the download
+	 * \return The URI of the file that is downloaded.
+	 */
+	const std::string& getUri() const {return uri;}
+
+	/**
+	 * \brief Returns the CURL easy handle of the download
+	 * \details The handle's CURLINFO_PRIVATE points to the Download, as does
+	 * that of every segment.
+	 * \return The handle, ready to be performed.
+	 */
+	CURL* getHandle() const {return curl;}
+
+	/**
+	 * \brief Returns the handles of the transfers that have not ended
+	 * \return The download's own handle, unless it has ended, and those of
+	 * its segments.
+	 */
+	std::vector<CURL*> getHandles() const;
+
+	/**
+	 * \brief Allows the download to be split into segments
+	 * \details Must be called before the transfer starts. Only a file of
+	 * known size of at least threshold bytes is split, and only if the server
+	 * accepts ranges and sent a validator for the If-Range header. Segments
+	 * are at least 1 MiB.
+	 * \param segments Maximum number of transfers at the same time.
+	 * \param threshold Minimum size of a file that is split in bytes.
+	 */
+	void setSegmentation(unsigned segments, std::uint64_t threshold);
+
+	/**
+	 * \brief Returns the handles of segments that should be started
+	 * \details Segments are created during the transfer, i.e. from within a
+	 * CURL callback, where they must not be added to a multi handle yet. The
+	 * caller should check after every call of curl_multi_perform() and
+	 * after ended().
+	 * \return The handles, each to be performed and passed to ended().
+	 */
+	std::vector<CURL*> takeNewHandles();
+
+	/**
+	 * \brief Reports the end of one of the download's transfers
+	 * \param handle The handle of the download or of a segment. It must not
+	 * be part of a multi handle anymore.
+	 * \param result The result code of the transfer.
+	 * \return True if no transfer of the download is left, i.e. finish()
+	 * should be called (with the result of the download's own handle).
+	 */
+	bool ended(CURL* handle, CURLcode result);
+
+	/**
+	 * \brief Subjects the download to a bandwidth limit
+	 * \details Before received data is written, the scheduler is asked for
+	 * permission. If it is denied, the transfer is paused (see
+	 * CURL_WRITEFUNC_PAUSE) and must be resumed with curl_easy_pause() once
+	 * the scheduler allows it to continue.
+	 * \param scheduler The scheduler.
+	 * \param id The identifier of this transfer within the scheduler.
+	 */
+	void setScheduler(BandwidthScheduler* scheduler, unsigned id);
+
+	/**
+	 * \brief Returns statistics about the transfer
+	 * \details Should be called after finish(), so the time for completing
+	 * the file is included.
+	 * \return Status, size and duration of the transfer.
+	 */
+	DownloadStats getStats() const;
+
+	/**
+	 * \brief Returns the response headers
+	 * \details Should be called after the transfer has ended.
+	 * \return The headers of the response, e.g. the validators of the file.
+	 */
+	const ResponseHeaders& getResponseHeaders() const {return responseHeaders;}
+
+	/**
+	 * \brief Returns whether the transfer was aborted because of its status
+	 * \details The body of an error response is not stored, the transfer is
+	 * aborted instead, so curl reports a write error. Whether the failure is
+	 * worth a retry only depends on the status then.
+	 * \return True if the server answered with something other than 200 or
+	 * 206 and sent a body.
+	 */
+	bool wasRejected() const {return rejected;}
+
+	/**
+	 * \brief Returns whether the transfer was aborted for a segment
+	 * \details When the download's own transfer reaches a segment that has
+	 * taken over, it is aborted, so curl reports a write error. Whether the
+	 * download failed then depends on the segments.
+	 * \return True if the download's own transfer stopped where a segment
+	 * took over.
+	 */
+	bool wasHandedOver() const {return handedOver;}
+
+	/**
+	 * \brief Completes the download after the transfer has ended
+	 * \param result The result code of the transfer.
+	 * \return The final name (including path and extension) of the file, or
+	 * an empty path if the request was conditional and the server reported
+	 * that the available copy is current.
+	 * \throws std::runtime_error If the transfer failed or the file could not
+	 * be stored.
+	 */
+	std::filesystem::path finish(CURLcode result);
+};
+
+#endif //DOWNLOAD_H
@@ -0,0 +1,335 @@
+/**
+ * \file downloadengine.cpp
+ * \brief Implementation for downloadengine.h
+ */
+
+#include<chrono>
+#include<ctime>
+#include<vector>
+#include"downloadengine.h"
+#include"transfercontext.h"
+
+DownloadEngine::DownloadEngine(unsigned maxTransfers, unsigned maxTransfersPerHost, std::uint64_t maxRate, SyncPolicy sync)
+: maxTransfers(maxTransfers ? maxTransfers : 1), maxTransfersPerHost(maxTransfersPerHost), scheduler(maxRate), writer(DiskWriter::create(sync)), syncSeconds(0), segments(1), segmentThreshold(0), store(NULL)
+{
+	TransferContext::get();
+	multi = curl_multi_init();
+	if(!multi)
+		throw std::runtime_error("Unable to initialize CURL");
+	curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+	curl_multi_setopt(multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, (long)this->maxTransfers);
+	if(this->maxTransfersPerHost)
+		curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long)this->maxTransfersPerHost);
+}
+
+DownloadEngine::~DownloadEngine()
+{
+	for(auto& entry : active)
+		for(CURL* handle : entry.second.download->getHandles())
+			curl_multi_remove_handle(multi, handle);
+	active.clear();
+	curl_multi_cleanup(multi);
+}
+
+void DownloadEngine::setSegmentation(unsigned segments, std::uint64_t threshold)
+{
+	this->segments = segments ? segments : 1;
+	segmentThreshold = threshold;
+	curl_multi_setopt(multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, (long)(maxTransfers * this->segments));
+	if(maxTransfersPerHost)
+		curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long)(maxTransfersPerHost * this->segments));
+}
+
+void DownloadEngine::add(std::string uri, std::filesystem::path filename, unsigned priority, Callback callback)
+{
+	enqueue(Job{uri, TransferContext::hostOf(uri), filename, priority, callback, nullptr, 0, MediaStore::Entry(), CURLE_OK, CURLE_OK, 0, std::chrono::steady_clock::time_point(), 0, 0});
+}
+
+void DownloadEngine::enqueue(Job job)
+{
+	// Keep pending jobs sorted by priority, first come first served among equals
+	auto iter = pending.end();
+	while(iter != pending.begin() && (iter - 1)->priority < job.priority)
+		iter--;
+	pending.insert(iter, std::move(job));
+}
+
+void DownloadEngine::run()
+{
+	startTransfers();
+	while(!active.empty() || !pending.empty())
+	{
+		int running;
+		CURLMcode mc = curl_multi_perform(multi, &running);
+		if(mc != CURLM_OK)
+			throw std::runtime_error(std::string("Error while downloading: ") + curl_multi_strerror(mc));
+
+		// Collect finished transfers and start new ones in their place (before waiting, a finished transfer has no more activity to wait for)
+		CURLMsg* msg;
+		int remaining;
+		while((msg = curl_multi_info_read(multi, &remaining)))
+			if(msg->msg == CURLMSG_DONE)
+				finishTransfer(msg->easy_handle, msg->data.result);
+		startTransfers();
+		startSegments();
+		if(active.empty() && pending.empty())
+			break;
+
+		// Wait for activity, but not longer than until paused transfers may continue or a retry is due
+		int timeout = scheduler.waitTime(), retryTimeout = retryWaitTime();
+		if(retryTimeout >= 0 && (timeout < 0 || retryTimeout < timeout))
+			timeout = retryTimeout;
+		if(timeout != 0)
+			mc = curl_multi_poll(multi, NULL, 0, timeout < 0 || timeout > 1000 ? 1000 : timeout, NULL);
+		if(mc != CURLM_OK)
+			throw std::runtime_error(std::string("Error while downloading: ") + curl_multi_strerror(mc));
+
+		// Resume transfers that were paused to keep within the bandwidth limit
+		for(unsigned id : scheduler.refill())
+		{
+			auto iter = active.find(scheduledHandles[id]);
+			if(iter != active.end())
+				for(CURL* handle : iter->second.download->getHandles())
+					curl_easy_pause(handle, CURLPAUSE_CONT);
+		}
+	}
+	syncSeconds = writer->sync();
+}
+
+bool DownloadEngine::retrieve(Job& job, DownloadStats& stats)
+{
+	if(!store->lookup(job.uri, job.stored))
+		return false;
+	if(!MediaStore::isFresh(job.stored))
+		return false; // The server is asked whether the stored file is still current
+
+	auto start = std::chrono::steady_clock::now();
+	try
+	{
+		store->retrieve(job.stored, job.filename);
+	}
+	catch(std::runtime_error& e)
+	{
+		job.stored = MediaStore::Entry();
+		return false; // Download it instead
+	}
+	stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	stats.fromMediaStore = true;
+	return true;
+}
+
+bool DownloadEngine::retry(Job& job, const DownloadStats& stats)
+{
+	// Only the server is to blame for a transient failure
+	bool transient = RetryPolicy::isTransient(job.result != CURLE_OK ? job.result : job.failure, stats.responseCode);
+	CircuitBreaker* breaker = TransferContext::get().getCircuitBreaker();
+	if(breaker && transient)
+		breaker->failed(job.host, std::time(NULL));
+	else if(breaker && stats.responseCode > 0)
+		breaker->succeeded(job.host);
+	else if(breaker)
+		breaker->inconclusive(job.host, std::time(NULL));
+
+	RetryPolicy& policy = TransferContext::get().getRetryPolicy();
+	if(!transient || job.attempts >= policy.getRetries())
+		return false;
+
+	// The partial file is kept, so the next attempt continues where this one broke off
+	job.attempts++;
+	job.notBefore = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(policy.backoff(job.attempts)));
+	job.bytes += stats.bytes;
+	job.seconds += stats.seconds;
+	job.result = job.failure = CURLE_OK;
+	enqueue(std::move(job));
+	return true;
+}
+
+int DownloadEngine::retryWaitTime() const
+{
+	auto now = std::chrono::steady_clock::now();
+	int timeout = -1;
+	for(const Job& job : pending)
+	{
+		// Jobs that are due only wait for a free slot, i.e. for activity of the running transfers
+		if(job.notBefore <= now)
+			continue;
+		int wait = std::chrono::duration_cast<std::chrono::milliseconds>(job.notBefore - now).count() + 1;
+		if(timeout < 0 || wait < timeout)
+			timeout = wait;
+	}
+	return timeout;
+}
+
+void DownloadEngine::startTransfers()
+{
+	auto now = std::chrono::steady_clock::now();
+	CircuitBreaker* breaker = TransferContext::get().getCircuitBreaker();
+
+	// Callbacks may queue downloads, so they are only called once the queue is not iterated anymore
+	std::vector<std::function<void()>> callbacks;
+	for(auto iter = pending.begin(); iter != pending.end() && active.size() < maxTransfers;)
+	{
+		// Skip jobs that wait for their retry
+		if(iter->notBefore > now)
+		{
+			iter++;
+			continue;
+		}
+
+		// Skip jobs whose host is busy, they will be picked up later
+		if(maxTransfersPerHost && activePerHost[iter->host] >= maxTransfersPerHost)
+		{
+			iter++;
+			continue;
+		}
+
+		// The same file for another feed waits until it is in the store
+		if(store && activeUris.count(iter->uri))
+		{
+			iter++;
+			continue;
+		}
+
+		// Jobs for a host that is being probed wait for the outcome
+		if(breaker && breaker->isProbing(iter->host, std::time(NULL)))
+		{
+			iter++;
+			continue;
+		}
+
+		Job job = std::move(*iter);
+		iter = pending.erase(iter);
+		DownloadStats stats;
+		if(store && retrieve(job, stats))
+		{
+			callbacks.push_back([callback = std::move(job.callback), stats] {callback(NULL, stats);});
+			continue;
+		}
+
+		// Do not even try a host that is known to be down
+		std::time_t openUntil = breaker ? breaker->admit(job.host, std::time(NULL)) : 0;
+		if(openUntil)
+		{
+			std::runtime_error e("Skipped, the server \"" + job.host + "\" failed repeatedly and is not contacted for another " + std::to_string((openUntil - std::time(NULL) + 59) / 60) + " minutes");
+			stats.bytes = job.bytes;
+			stats.seconds = job.seconds;
+			stats.retries = job.attempts;
+			callbacks.push_back([callback = std::move(job.callback), e, stats] {callback(&e, stats);});
+			continue;
+		}
+		try
+		{
+			job.download = std::make_unique<Download>(job.uri, job.filename, *writer, job.stored.etag, job.stored.lastModified);
+		}
+		catch(std::runtime_error& e)
+		{
+			if(breaker)
+				breaker->inconclusive(job.host, std::time(NULL));
+			callbacks.push_back([callback = std::move(job.callback), e] {callback(&e, DownloadStats());});
+			continue;
+		}
+		CURL* handle = job.download->getHandle();
+		CURLMcode mc = curl_multi_add_handle(multi, handle);
+		if(mc != CURLM_OK)
+		{
+			if(breaker)
+				breaker->inconclusive(job.host, std::time(NULL));
+			std::runtime_error e(std::string("Unable to start download: ") + curl_multi_strerror(mc));
+			callbacks.push_back([callback = std::move(job.callback), e] {callback(&e, DownloadStats());});
+			continue;
+		}
+		if(segments > 1)
+			job.download->setSegmentation(segments, segmentThreshold);
+		activePerHost[job.host]++;
+		if(store)
+			activeUris.insert(job.uri);
+		job.schedulerId = scheduler.add(job.host, job.priority);
+		job.download->setScheduler(&scheduler, job.schedulerId);
+		scheduledHandles[job.schedulerId] = handle;
+		active.emplace(handle, std::move(job));
+	}
+	for(const auto& callback : callbacks)
+		callback();
+
+	// Start what the callbacks have queued
+	if(!callbacks.empty())
+		startTransfers();
+}
+
+void DownloadEngine::startSegments()
+{
+	std::vector<CURL*> failed;
+	for(auto& entry : active)
+		for(CURL* handle : entry.second.download->takeNewHandles())
+			if(curl_multi_add_handle(multi, handle) != CURLM_OK)
+				failed.push_back(handle);
+	for(CURL* handle : failed)
+		finishTransfer(handle, CURLE_FAILED_INIT);
+}
+
+void DownloadEngine::finishTransfer(CURL* handle, CURLcode result)
+{
+	// Segments belong to the job of the download's own handle
+	char* download = NULL;
+	curl_easy_getinfo(handle, CURLINFO_PRIVATE, &download);
+	if(!download)
+		return;
+	auto iter = active.find(((Download*)download)->getHandle());
+	if(iter == active.end())
+		return;
+	curl_multi_remove_handle(multi, handle);
+	if(handle == iter->first)
+		iter->second.result = result == CURLE_WRITE_ERROR && iter->second.download->wasHandedOver() ? CURLE_OK : result; // Stopped on purpose, the segments tell
+	else if(result != CURLE_OK && !RetryPolicy::isTransient(iter->second.failure, 0))
+		iter->second.failure = result; // A failure worth a retry takes precedence
+	if(!iter->second.download->ended(handle, result))
+		return; // Other transfers of the download are still running
+	Job job = std::move(iter->second);
+	active.erase(iter);
+	activePerHost[job.host]--;
+	scheduler.remove(job.schedulerId);
+	scheduledHandles.erase(job.schedulerId);
+
+	activeUris.erase(job.uri);
+
+	// The statistics are taken after finish(), which waits for the disk
+	DownloadStats stats;
+	try
+	{
+		std::filesystem::path path = job.download->finish(job.result);
+		if(path.empty())
+		{
+			// The server confirmed the stored file
+			store->verified(job.stored);
+			store->retrieve(job.stored, job.filename);
+		}
+		else if(store)
+		{
+			const ResponseHeaders& headers = job.download->getResponseHeaders();
+			store->add(job.uri, path, path.string().substr(job.filename.string().size()), headers.etag, headers.lastModified);
+		}
+	}
+	catch(std::runtime_error& e)
+	{
+		stats = job.download->getStats();
+		if(job.download->wasRejected())
+			job.result = job.failure = CURLE_OK; // Aborted on purpose, the status tells what went wrong
+		job.download.reset();
+		if(retry(job, stats))
+			return;
+		stats.bytes += job.bytes;
+		stats.seconds += job.seconds;
+		stats.retries = job.attempts;
+		job.callback(&e, stats);
+		return;
+	}
+	stats = job.download->getStats();
+	job.download.reset();
+	CircuitBreaker* breaker = TransferContext::get().getCircuitBreaker();
+	if(breaker)
+		breaker->succeeded(job.host);
+	stats.bytes += job.bytes;
+	stats.seconds += job.seconds;
+	stats.retries = job.attempts;
+	job.callback(NULL, stats);
+}
@@ -0,0 +1,166 @@
+/**
+ * \file downloadengine.h
+ * \brief Defines the DownloadEngine class
+ */
+
+#ifndef DOWNLOADENGINE_H
+#define DOWNLOADENGINE_H
+
+#include<string>
+#include<chrono>
+#include<deque>
+#include<map>
+#include<set>
+#include<memory>
+#include<functional>
+#include<stdexcept>
+#include<filesystem>
+#include<curl/curl.h>
+#include"download.h"
+#include"bandwidthscheduler.h"
+#include"mediastore.h"
+#include"diskwriter.h"
+
+/**
+ * \brief Runs many downloads concurrently
+ * \details Downloads are queued with add() and performed by run() using the
+ * CURL multi interface, i.e. all transfers are driven from a single thread.
+ * The number of transfers in flight is limited globally and per host.
+ * Queued downloads are started in order of their priority, and the bandwidth
+ * is shared among the running ones by a BandwidthScheduler.
+ * With a MediaStore, files that are already in the store are placed from
+ * there, downloaded files are added to it, and a URI that is being downloaded
+ * is not requested again at the same time (the second job waits and then
+ * finds the file in the store).
+ * The received data is written by a DiskWriter, so the disk works while the
+ * transfers continue, and the files are flushed according to a SyncPolicy.
+ * Large files may be split into segments that are transferred in parallel
+ * (see setSegmentation()); the limits on transfers then count downloads, not
+ * connections.
+ * A download that fails for a reason that may go away by itself is queued
+ * again after a delay, following the RetryPolicy of the TransferContext, and
+ * continues where it broke off. Every failure of a host is reported to the
+ * context's CircuitBreaker, and downloads from a host it says to skip fail
+ * right away.
+ */
+class DownloadEngine
+{
+public:
+	/**
+	 * \brief Function that is called once a download has ended
+	 * \details The first parameter is NULL if the download succeeded.
+	 * Otherwise it points to an exception describing the problem. The second
+	 * one describes the transfer (it is empty if the transfer never started).
+	 */
+	typedef std::function<void(const std::runtime_error* error, const DownloadStats& stats)> Callback;
+
+private:
+	struct Job
+	{
+		std::string uri, host;
+		std::filesystem::path filename;
+		unsigned priority;
+		Callback callback;
+		std::unique_ptr<Download> download;
+		unsigned schedulerId;
+		MediaStore::Entry stored;
+		CURLcode result, failure;
+		unsigned attempts;
+		std::chrono::steady_clock::time_point notBefore;
+		std::uint64_t bytes;
+		double seconds;
+	};
+
+	CURLM* multi;
+	unsigned maxTransfers, maxTransfersPerHost;
+	BandwidthScheduler scheduler;
+	std::unique_ptr<DiskWriter> writer;
+	double syncSeconds;
+	unsigned segments;
+	std::uint64_t segmentThreshold;
+	std::map<unsigned, CURL*> scheduledHandles;
+	std::deque<Job> pending;
+	std::map<CURL*, Job> active;
+	std::map<std::string, unsigned> activePerHost;
+	const MediaStore* store;
+	std::set<std::string> activeUris;
+
+	void enqueue(Job job);
+	bool retrieve(Job& job, DownloadStats& stats);
+	bool retry(Job& job, const DownloadStats& stats);
+	int retryWaitTime() const;
+	void startTransfers();
+	void startSegments();
+	void finishTransfer(CURL* handle, CURLcode result);
+public:
+	/**
+	 * \brief Creates a DownloadEngine
+	 * \param maxTransfers Maximum number of transfers in flight at the same
+	 * time. 0 is treated as 1.
+	 * \param maxTransfersPerHost Maximum number of transfers in flight to the
+	 * same host at the same time. 0 means no per-host limit.
+	 * \param maxRate Maximum total download rate in bytes per second. 0 means
+	 * no limit.
+	 * \param sync When the downloaded files are flushed to disk.
+	 * \throws std::runtime_error If CURL could not be initialized.
+	 */
+	DownloadEngine(unsigned maxTransfers, unsigned maxTransfersPerHost, std::uint64_t maxRate = 0, SyncPolicy sync = SyncPolicy::RUN);
+
+	/**
+	 * \brief Destructor
+	 * \details Downloads that have not been performed are dropped without
+	 * calling their callbacks.
+	 */
+	~DownloadEngine();
+
+	DownloadEngine(const DownloadEngine&) = delete;
+	DownloadEngine& operator=(const DownloadEngine&) = delete;
+
+	/**
+	 * \brief Shares the downloaded files through a media store
+	 * \param store The store, or NULL for none. It must stay alive until
+	 * run() has returned.
+	 */
+	void setMediaStore(const MediaStore* store) {this->store = store;}
+
+	/**
+	 * \brief Splits large files into segments that are transferred in parallel
+	 * \details See Download#setSegmentation(). The connection limits are
+	 * raised accordingly.
+	 * \param segments Maximum number of connections per download, 1 or 0
+	 * to never split files.
+	 * \param threshold Minimum size of a file that is split in bytes.
+	 */
+	void setSegmentation(unsigned segments, std::uint64_t threshold);
+
+	/**
+	 * \brief Queues a download
+	 * \details Nothing is transferred until run() is called.
+	 * \param uri The URI of the file to download.
+	 * \param filename The name (including path, excluding extension) of the
+	 * file where the downloaded data should be written. See Download.
+	 * \param priority Downloads with a higher priority are started before
+	 * those with a lower one and get a larger share of the bandwidth.
+	 * \param callback Function that is called (from within run()) once the
+	 * download has ended.
+	 */
+	void add(std::string uri, std::filesystem::path filename, unsigned priority, Callback callback);
+
+	/**
+	 * \brief Performs all queued downloads
+	 * \details Returns once every download (including those queued by
+	 * callbacks while running, and retries) has ended. Failures of individual
+	 * downloads are reported to their callbacks only. With SyncPolicy::RUN,
+	 * the files are flushed to disk before it returns.
+	 * \throws std::runtime_error If the CURL multi interface fails.
+	 */
+	void run();
+
+	/**
+	 * \brief Returns the time spent flushing the files at the end of run()
+	 * \return The duration in seconds, 0 unless the policy is SyncPolicy::RUN.
+	 */
+	double getSyncSeconds() const {return syncSeconds;}
+};
+
+#endif //DOWNLOADENGINE_H
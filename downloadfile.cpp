@@ -0,0 +1,206 @@
+/**
+ * \file downloadfile.cpp
+ * \brief Implementation for downloadfile.h
+ */
+
+#include<stdexcept>
+#include<algorithm>
+#include<fstream>
+#include<chrono>
+#include<cstdlib>
+#include<fcntl.h>
+#include"downloadfile.h"
+
+DownloadFile::DownloadFile(std::filesystem::path filename, std::string uri, DiskWriter& writer)
+: filename(filename), uri(uri), writer(writer), resumeOffset(0), size(0), expectedSize(0), opened(false), failed(false), committed(false), sparse(false), diskSeconds(0)
+{
+	std::filesystem::path partialDir = filename.parent_path() / ".partial";
+	partPath = partialDir / (filename.filename().string() + ".part");
+	metaPath = partialDir / (filename.filename().string() + ".meta");
+
+	// Look for an earlier, interrupted download of the same URI
+	std::ifstream ifs(metaPath);
+	std::string line, metaUri;
+	std::uint64_t metaSize = 0;
+	bool metaSparse = false;
+	while(std::getline(ifs, line))
+	{
+		std::size_t pos = line.find('=');
+		if(pos == std::string::npos)
+			continue;
+		std::string key = line.substr(0, pos), value = line.substr(pos + 1);
+		if(key == "uri") metaUri = value;
+		else if(key == "etag") etag = value;
+		else if(key == "last-modified") lastModified = value;
+		else if(key == "size") metaSize = std::strtoull(value.c_str(), NULL, 10);
+		else if(key == "sparse") metaSparse = value == "1";
+	}
+	std::error_code ec;
+	std::uint64_t partSize = std::filesystem::file_size(partPath, ec);
+	if(!ec && metaUri == uri && !getResumeValidator().empty() && !metaSparse && (metaSize == 0 || partSize < metaSize))
+	{
+		resumeOffset = partSize;
+		expectedSize = metaSize;
+	}
+	else
+	{
+		etag.clear();
+		lastModified.clear();
+	}
+}
+
+DownloadFile::~DownloadFile()
+{
+	if(committed || !opened)
+		return;
+	closeFile(false);
+
+	// Keep what has been downloaded if it can be resumed later (a file written in several ranges may have holes)
+	if(failed || sparse || size == 0 || getResumeValidator().empty() || (expectedSize > 0 && size >= expectedSize))
+		removePartial();
+}
+
+void DownloadFile::open(const std::string& contentType, bool resume, std::uint64_t expectedSize, std::string etag, std::string lastModified)
+{
+	extension = extensionForContentType(contentType);
+	this->expectedSize = expectedSize;
+	this->etag = etag;
+	this->lastModified = lastModified;
+
+	std::error_code ec;
+	std::filesystem::create_directories(partPath.parent_path(), ec);
+	int fd = ::open(partPath.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC | (resume ? 0 : O_TRUNC), 0666);
+	if(fd < 0)
+		throw std::runtime_error("Unable to create temporary file \"" + partPath.string() + "\".");
+	streams.assign(1, fd);
+	opened = true;
+	size = resume ? resumeOffset : 0;
+	writeMeta();
+
+	// Reserve the space in one piece; the file keeps its size, so an interrupted download can still be resumed
+	if(expectedSize > size)
+		fallocate(fd, FALLOC_FL_KEEP_SIZE, size, expectedSize - size);
+}
+
+bool DownloadFile::write(const char* data, std::size_t size)
+{
+	return writeAt(0, this->size, data, size);
+}
+
+unsigned DownloadFile::addStream()
+{
+	if(streams.empty() || streams[0] < 0)
+		throw std::runtime_error("The temporary file \"" + partPath.string() + "\" is not open.");
+	int fd = ::open(partPath.c_str(), O_WRONLY | O_CLOEXEC);
+	if(fd < 0)
+		throw std::runtime_error("Unable to open temporary file \"" + partPath.string() + "\".");
+	streams.push_back(fd);
+
+	// Until truncate() or commit(), the file must not be resumed
+	if(!sparse)
+	{
+		sparse = true;
+		writeMeta();
+	}
+	return streams.size() - 1;
+}
+
+bool DownloadFile::writeAt(unsigned stream, std::uint64_t offset, const char* data, std::size_t size)
+{
+	if(stream >= streams.size() || streams[stream] < 0)
+		return false;
+	auto start = std::chrono::steady_clock::now();
+	failed = !writer.write(streams[stream], offset, data, size) || failed;
+	diskSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	this->size = std::max(this->size, offset + size);
+	return !failed;
+}
+
+void DownloadFile::closeStream(unsigned stream, bool keep)
+{
+	if(stream >= streams.size() || streams[stream] < 0)
+		return;
+	auto start = std::chrono::steady_clock::now();
+	failed = !writer.close(streams[stream], keep) || failed;
+	diskSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	streams[stream] = -1;
+}
+
+void DownloadFile::closeFile(bool keep)
+{
+	for(std::size_t i = streams.size(); i > 0; i--)
+		closeStream(i - 1, keep && i == 1);
+	streams.clear();
+}
+
+void DownloadFile::truncate(std::uint64_t length)
+{
+	closeFile(false);
+	std::error_code ec;
+	std::filesystem::resize_file(partPath, length, ec);
+	if(ec)
+		failed = true;
+	size = length;
+	sparse = false;
+	writeMeta();
+}
+
+void DownloadFile::discard()
+{
+	closeFile(false);
+	failed = false;
+	removePartial();
+	resumeOffset = 0;
+	opened = false;
+}
+
+std::filesystem::path DownloadFile::commit()
+{
+	if(streams.empty() || streams[0] < 0)
+		throw std::runtime_error("No data has been received for \"" + filename.string() + "\".");
+	closeFile(!failed && (expectedSize == 0 || size == expectedSize));
+	if(failed)
+		throw std::runtime_error("Unable to write temporary file \"" + partPath.string() + "\".");
+
+	// Make sure the file is complete (the destructor decides whether to keep it)
+	if(expectedSize > 0 && size != expectedSize)
+		throw std::runtime_error("Download is incomplete, got " + std::to_string(size) + " of " + std::to_string(expectedSize) + " bytes");
+
+	std::filesystem::path finalPath = filename;
+	finalPath += extension;
+	std::error_code ec;
+	std::filesystem::rename(partPath, finalPath, ec);
+	if(ec)
+		throw std::runtime_error("Unable to store episode in \"" + finalPath.string() + "\": " + ec.message());
+	std::filesystem::remove(metaPath, ec);
+	committed = true;
+	return finalPath;
+}
+
+void DownloadFile::writeMeta()
+{
+	std::ofstream meta(metaPath, std::ios::trunc);
+	meta
+		<< "uri=" << uri << std::endl
+		<< "etag=" << etag << std::endl
+		<< "last-modified=" << lastModified << std::endl
+		<< "size=" << expectedSize << std::endl
+		<< "sparse=" << (sparse ? 1 : 0) << std::endl;
+}
+
+void DownloadFile::removePartial()
+{
+	std::error_code ec;
+	std::filesystem::remove(partPath, ec);
+	std::filesystem::remove(metaPath, ec);
+}
+
+std::string DownloadFile::extensionForContentType(const std::string& contentType)
+{
+	std::string type = contentType.substr(0, contentType.find(';'));
+	if(type.compare("audio/mpeg") == 0) return ".mp3";
+	else if(type.compare("audio/mp4") == 0) return ".mp4";
+	else if(type.compare("audio/ogg") == 0) return ".ogg";
+	else if(type.compare("audio/wav") == 0) return ".wav";
+	return "";
+}
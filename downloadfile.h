@@ -0,0 +1,188 @@
+/**
+ * \file downloadfile.h
+ * \brief Defines the DownloadFile class
+ */
+
+#ifndef DOWNLOADFILE_H
+#define DOWNLOADFILE_H
+
+#include<string>
+#include<vector>
+#include<cstdint>
+#include<filesystem>
+#include"diskwriter.h"
+
+/**
+ * \brief A file that an episode is streamed into while it is being downloaded
+ * \details Data is written to a partial file (`<name>.part`) in the hidden
+ * subdirectory `.partial` of the target directory as it arrives. Only once the
+ * download is complete and its size has been verified, commit() moves the file
+ * to its final name (by an atomic rename within the same file system). Thus,
+ * memory usage does not depend on the size of the episode and an interrupted
+ * download never leaves a truncated file under the final name.
+ *
+ * Next to the partial file, a metadata file (`<name>.meta`) records the URI,
+ * the validators (ETag, Last-Modified) and the expected size. If a download is
+ * interrupted and the server sent validators, the partial file is kept so a
+ * later download of the same URI can resume where it stopped.
+ *
+ * The data goes through a DiskWriter, so it can be written behind the
+ * network. If the size of the file is known, the space for it is reserved up
+ * front, which keeps large episodes from being fragmented.
+ *
+ * Parts of the file can also be received in parallel: every part gets a
+ * stream of its own (see addStream()) and is written at its own offset. Such
+ * a file may contain holes, so it is not resumed unless truncate() has cut it
+ * back to the part that is complete.
+ */
+class DownloadFile
+{
+private:
+	std::filesystem::path filename, partPath, metaPath;
+	std::string uri, extension, etag, lastModified;
+	DiskWriter& writer;
+	std::vector<int> streams;
+	std::uint64_t resumeOffset, size, expectedSize;
+	bool opened, failed, committed, sparse;
+	double diskSeconds;
+
+	void writeMeta();
+	void closeFile(bool keep);
+	void removePartial();
+public:
+	/**
+	 * \brief Creates a DownloadFile
+	 * \details If a partial file from an earlier, interrupted download of the
+	 * same URI exists, it can be resumed (see getResumeOffset()). Nothing is
+	 * written until open() is called.
+	 * \param filename The name (including path) of the final file, without
+	 * extension. The extension is determined later from the content type.
+	 * \param uri The URI the file is downloaded from.
+	 * \param writer The writer for the data.
+	 */
+	DownloadFile(std::filesystem::path filename, std::string uri, DiskWriter& writer);
+
+	/**
+	 * \brief Destructor
+	 * \details Unless commit() has been called, the partial file is kept for
+	 * resuming if possible and removed otherwise.
+	 */
+	~DownloadFile();
+
+	DownloadFile(const DownloadFile&) = delete;
+	DownloadFile& operator=(const DownloadFile&) = delete;
+
+	/**
+	 * \brief Returns how much of an earlier download can be resumed
+	 * \return The size of the partial file left by an earlier download of the
+	 * same URI, or 0 if there is nothing to resume.
+	 */
+	std::uint64_t getResumeOffset() const {return resumeOffset;}
+
+	/**
+	 * \brief Returns the validator to resume an earlier download with
+	 * \return The ETag or, if there is none, the Last-Modified date of the
+	 * partial file, suitable for an If-Range header.
+	 */
+	std::string getResumeValidator() const {return etag.empty() ? lastModified : etag;}
+
+	/**
+	 * \brief Opens the partial file for writing
+	 * \details Should be called as soon as the response headers are known,
+	 * i.e. before the first chunk of data is written.
+	 * \param contentType The MIME type reported by the server. It is used to
+	 * choose the extension of the final file.
+	 * \param resume True if the server sent the rest of the partial file
+	 * (starting at getResumeOffset()), false if it sent the whole file.
+	 * \param expectedSize The size of the whole file, or 0 if unknown. If
+	 * known, the space for the file is preallocated.
+	 * \param etag The ETag reported by the server (may be empty).
+	 * \param lastModified The Last-Modified date reported by the server (may
+	 * be empty).
+	 * \throws std::runtime_error If the partial file could not be opened.
+	 */
+	void open(const std::string& contentType, bool resume, std::uint64_t expectedSize, std::string etag, std::string lastModified);
+
+	/**
+	 * \brief Returns whether open() has been called
+	 * \return True if the partial file has been opened.
+	 */
+	bool isOpen() const {return opened;}
+
+	/**
+	 * \brief Appends a chunk of data to the partial file
+	 * \param data Pointer to the data.
+	 * \param size Number of bytes to write.
+	 * \return True if successful, false if the data could not be written.
+	 */
+	bool write(const char* data, std::size_t size);
+
+	/**
+	 * \brief Opens another stream for writing a part of the file
+	 * \details Must be called after open().
+	 * \return The number of the stream for writeAt(). The stream that open()
+	 * created is number 0.
+	 * \throws std::runtime_error If the partial file could not be opened.
+	 */
+	unsigned addStream();
+
+	/**
+	 * \brief Writes a chunk of data at a given position
+	 * \param stream The number of the stream (see addStream()).
+	 * \param offset The position in the file.
+	 * \param data Pointer to the data.
+	 * \param size Number of bytes to write.
+	 * \return True if successful, false if the data could not be written.
+	 */
+	bool writeAt(unsigned stream, std::uint64_t offset, const char* data, std::size_t size);
+
+	/**
+	 * \brief Closes a stream once its part of the file has been written
+	 * \param stream The number of the stream, other than 0.
+	 * \param keep False if the data is going to be discarded anyway.
+	 */
+	void closeStream(unsigned stream, bool keep = true);
+
+	/**
+	 * \brief Cuts the partial file back to the part that is complete
+	 * \details Closes all streams. Used if a file written in parts could not
+	 * be completed, so a later download can resume after length bytes.
+	 * \param length The number of bytes at the beginning of the file that
+	 * have been received.
+	 */
+	void truncate(std::uint64_t length);
+
+	/**
+	 * \brief Returns the time spent waiting for the disk
+	 * \return The seconds that write() and commit() were blocked by the
+	 * DiskWriter.
+	 */
+	double getDiskSeconds() const {return diskSeconds;}
+
+	/**
+	 * \brief Removes the partial file of an earlier download
+	 * \details Used if the partial file turns out to be unusable, so the
+	 * next attempt starts from the beginning.
+	 */
+	void discard();
+
+	/**
+	 * \brief Moves the completely downloaded file to its final name
+	 * \return The final name (including path and extension) of the file.
+	 * \throws std::runtime_error If the file could not be written or renamed,
+	 * or if it is smaller or larger than the expected size. In the latter
+	 * case, the partial file is kept for resuming.
+	 */
+	std::filesystem::path commit();
+
+	/**
+	 * \brief Determines the file extension for a MIME type
+	 * \param contentType The MIME type as reported by the server (parameters
+	 * like "; charset=..." are ignored).
+	 * \return The extension including the dot, or an empty string if the type
+	 * is not recognized.
+	 */
+	static std::string extensionForContentType(const std::string& contentType);
+};
+
+#endif //DOWNLOADFILE_H
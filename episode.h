@@ -7,60 +7,108 @@
 #define EPISODE_H
 
 #include<string>
-#include<filesystem>
+#include<string_view>
 #include<ctime>
-#include<mrss.h>
-
-class Feed;
+#include"arena.h"
+#include"feedparser.h"
 
 /**
  * \brief Represents a single episode within a podcast feed
+ * \details An Episode does not own its strings, it only refers to them. Right
+ * after construction, they are those of the feed item; once the episode is
+ * kept, keep() moves them to an Arena (usually the one of the Feed, so they
+ * stay valid until the feed is updated again or destroyed). Episodes are
+ * cheap to copy.
  */
 class Episode
 {
 private:
-	Feed*		feed;
-	std::string	title, description, uri;
-	std::tm		pubDate;
-
-	static std::tm parseTime(std::string timeStr);
+	std::string_view	feedTitle, feedDescription, title, description, uri, guid;
+	std::tm			pubDate;
+	std::time_t		pubTime;
 public:
 	/**
-	 * \brief Creates an Episode instance from an RSS item
-	 * \param feed Pointer to the Feed that this episode belongs to.
-	 * \param item The RSS `<item>...</item>` containing the information for the
-	 * episode.
+	 * \brief Creates an Episode instance from a feed item
+	 * \param item The RSS `<item>` or Atom `<entry>` containing the information
+	 * for the episode. It must stay unchanged until keep() is called.
+	 * \param feedTitle The title of the feed that this episode belongs to.
+	 * \param feedDescription The description of the feed that this episode
+	 * belongs to.
 	 * \throws std::runtime_error If the publication date could not be parsed
 	 * or if the episode has no enclosed URI. Some RSS feed items come only
 	 * with text which means for the purposes of downloading podcasts, it
 	 * should be ignored.
 	 */
-	Episode(Feed* feed, mrss_item_t* item);
+	Episode(const FeedItem& item, std::string_view feedTitle, std::string_view feedDescription);
+
+	/**
+	 * \brief Copies the episode's strings into an arena
+	 * \details The feed's title and description are not copied, they are
+	 * expected to be stored there already.
+	 * \param arena The arena that takes over the strings.
+	 */
+	void keep(Arena& arena);
+
+	/**
+	 * \brief Determines the GUID of a feed item without creating an Episode
+	 * \param item The RSS `<item>` or Atom `<entry>`.
+	 * \return The GUID as returned by getGuid() for an Episode created from
+	 * the item, or an empty string if the item has neither GUID nor enclosure.
+	 */
+	static std::string_view guidOf(const FeedItem& item);
+
+	/**
+	 * \brief Returns the title of the feed the episode belongs to
+	 * \return The feed title.
+	 */
+	std::string_view getFeedTitle() const {return feedTitle;}
+
+	/**
+	 * \brief Returns the description of the feed the episode belongs to
+	 * \return The feed description.
+	 */
+	std::string_view getFeedDescription() const {return feedDescription;}
 
 	/**
 	 * \brief Returns the title of the episode
 	 * \return The episode title.
 	 */
-	std::string getTitle() const {return title;}
+	std::string_view getTitle() const {return title;}
 
 	/**
 	 * \brief Returns the description of the episode
 	 * \return The episode description.
 	 */
-	std::string getDescription() const {return description;}
+	std::string_view getDescription() const {return description;}
 
 	/**
 	 * \brief Returns the URI of the episode
 	 * \return The episode URI.
 	 */
-	std::string getUri() const {return uri;}
+	std::string_view getUri() const {return uri;}
+
+	/**
+	 * \brief Returns the GUID of the episode
+	 * \return The episode's GUID or, if the feed does not provide one, its
+	 * URI.
+	 */
+	std::string_view getGuid() const {return guid;}
 
 	/**
 	 * \brief Returns the publication date of the episode
-	 * \return The episode's publication date.
+	 * \return The episode's publication date, as written in the feed (i.e. in
+	 * the feed's time zone).
 	 */
 	const std::tm* getPubDate() const {return &pubDate;}
 
+	/**
+	 * \brief Returns the publication time of the episode
+	 * \details Unlike getPubDate(), which is in the time zone the feed uses,
+	 * this is normalized to UTC.
+	 * \return The episode's publication time as a UTC timestamp.
+	 */
+	std::time_t getPubTime() const {return pubTime;}
+
 	/**
 	 * \brief Fills the placeholders in a string with the episode's metdata
 	 * \param pattern A string that may contain certain placeholders:
@@ -73,17 +121,9 @@ public:
 	 * episode's publication date. See std::put_time() for details.
 	 * \%\% is replaced with the percent sign.
 	 * \return The pattern with all placeholders replaced.
+	 * \see PlaceholderPattern for filling the same pattern in repeatedly.
 	 */
 	std::string fillPlaceholders(std::string pattern) const;
-
-	/**
-	 * \brief Downloads an the episode
-	 * \param filename The name (including path) of the file where the
-	 * downloaded data should be written.
-	 * \throws std::runtime_error If anything at all goes wrong. This includes
-	 * failure to download and failure to create or write to the file.
-	 */
-	void download(std::filesystem::path filename) const;
 };
 
 #endif //EPISODE_H
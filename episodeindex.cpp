@@ -0,0 +1,290 @@
+/**
+ * \file episodeindex.cpp
+ * \brief Implementation for episodeindex.h
+ */
+
+#include<stdexcept>
+#include<cstring>
+#include<unordered_set>
+#include<fcntl.h>
+#include<unistd.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include"episodeindex.h"
+
+// Layout of the index file, followed by the hash table and the directories (each a 64 bit time, a 32 bit length and the relative path)
+struct IndexHeader
+{
+	char magic[8];
+	std::uint64_t directoryBytes;
+	std::uint64_t capacity, count, checksum;
+};
+
+static const char indexMagic[8] = {'J', 'P', 'O', 'D', 'I', 'D', 'X', '2'};
+
+// Returns the modification time of a directory in an arbitrary but fixed unit
+static std::int64_t directoryTime(const std::filesystem::path& directory)
+{
+	std::error_code ec;
+	auto time = std::filesystem::last_write_time(directory, ec);
+	return ec ? 0 : time.time_since_epoch().count();
+}
+
+EpisodeIndex::EpisodeIndex(std::filesystem::path filename, std::filesystem::path directory)
+: filename(filename), directory(directory), mapping(NULL), mappingSize(0), table(NULL), capacity(0), dirty(false)
+{
+	load();
+}
+
+EpisodeIndex::~EpisodeIndex()
+{
+	unmap();
+}
+
+void EpisodeIndex::load()
+{
+	int fd = open(filename.c_str(), O_RDONLY);
+	if(fd >= 0)
+	{
+		struct stat st;
+		if(fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(IndexHeader))
+		{
+			void* m = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+			if(m != MAP_FAILED)
+			{
+				mapping = m;
+				mappingSize = st.st_size;
+			}
+		}
+		close(fd);
+	}
+
+	// Check that the index is intact
+	const char* directoryData = NULL;
+	std::size_t directoryBytes = 0;
+	if(mapping)
+	{
+		const IndexHeader* header = (const IndexHeader*)mapping;
+		const Entry* entries = (const Entry*)((const char*)mapping + sizeof(IndexHeader));
+		if(std::memcmp(header->magic, indexMagic, sizeof(indexMagic)) == 0
+			&& header->capacity > 0 && (header->capacity & (header->capacity - 1)) == 0
+			&& header->capacity <= mappingSize / sizeof(Entry)
+			&& mappingSize == sizeof(IndexHeader) + header->capacity * sizeof(Entry) + header->directoryBytes)
+		{
+			directoryData = (const char*)(entries + header->capacity);
+			directoryBytes = header->directoryBytes;
+			if(header->checksum == checksum(entries, header->capacity, directoryData, directoryBytes))
+			{
+				table = entries;
+				capacity = header->capacity;
+			}
+		}
+		if(!table)
+			unmap();
+	}
+
+	// Check that no directory of the tree has changed since
+	bool upToDate = table != NULL;
+	for(std::size_t pos = 0; upToDate && pos < directoryBytes;)
+	{
+		std::int64_t time;
+		std::uint32_t length;
+		if(directoryBytes - pos < sizeof(time) + sizeof(length))
+		{
+			upToDate = false;
+			break;
+		}
+		std::memcpy(&time, directoryData + pos, sizeof(time));
+		std::memcpy(&length, directoryData + pos + sizeof(time), sizeof(length));
+		pos += sizeof(time) + sizeof(length);
+		if(directoryBytes - pos < length)
+		{
+			upToDate = false;
+			break;
+		}
+		std::string path(directoryData + pos, length);
+		pos += length;
+		upToDate = directoryTime(directory / path) == time;
+		directories[path] = time;
+	}
+	if(!upToDate || directories.empty())
+		rebuild();
+}
+
+void EpisodeIndex::unmap()
+{
+	if(mapping)
+		munmap(mapping, mappingSize);
+	mapping = NULL;
+	mappingSize = 0;
+	table = NULL;
+	capacity = 0;
+}
+
+bool EpisodeIndex::find(std::uint64_t key) const
+{
+	if(added.count(key))
+		return true;
+	if(!table)
+		return false;
+	for(std::uint64_t i = key & (capacity - 1);; i = (i + 1) & (capacity - 1))
+	{
+		if(table[i].key == key)
+			return true;
+		if(table[i].key == 0)
+			return false;
+	}
+}
+
+bool EpisodeIndex::contains(std::string_view key, std::string_view file) const
+{
+	return find(hash('k', key)) || find(hash('f', file));
+}
+
+void EpisodeIndex::add(std::string_view key, std::string_view file)
+{
+	// The directories the file was placed in become part of the tree
+	for(std::size_t pos = file.find('/'); pos != std::string_view::npos; pos = file.find('/', pos + 1))
+		directories.emplace(std::string(file.substr(0, pos)), 0);
+
+	std::uint64_t fileHash = hash('f', file);
+	std::uint64_t keyHash = hash('k', key);
+	if(!find(keyHash))
+		added.emplace(keyHash, fileHash);
+	if(!find(fileHash))
+		added.emplace(fileHash, fileHash);
+	dirty = true;
+}
+
+std::vector<EpisodeIndex::Entry> EpisodeIndex::entries() const
+{
+	std::vector<Entry> result;
+	for(std::uint64_t i = 0; i < capacity; i++)
+		if(table[i].key != 0)
+			result.push_back(table[i]);
+	for(const auto& entry : added)
+		result.push_back(Entry{entry.first, entry.second});
+	return result;
+}
+
+void EpisodeIndex::rebuild()
+{
+	// Collect the relative paths of all files in the tree
+	std::unordered_set<std::uint64_t> files;
+	directories.clear();
+	directories.emplace("", 0);
+	std::error_code ec;
+	for(std::filesystem::recursive_directory_iterator iter(directory, std::filesystem::directory_options::skip_permission_denied, ec); !ec && iter != std::filesystem::recursive_directory_iterator(); iter.increment(ec))
+	{
+		std::filesystem::path relative = iter->path().lexically_relative(directory);
+		if(iter->is_directory(ec))
+		{
+			if(iter->path().filename().string()[0] == '.')
+				iter.disable_recursion_pending();
+			else
+				directories.emplace(relative.generic_string(), 0);
+		}
+		else if(iter->is_regular_file(ec))
+		{
+			files.insert(hash('f', relative.generic_string()));
+			files.insert(hash('f', relative.replace_extension().generic_string()));
+		}
+		ec.clear();
+	}
+
+	// Keep episodes whose files still exist, then add all files
+	std::unordered_map<std::uint64_t, std::uint64_t> result;
+	for(const Entry& entry : entries())
+		if(files.count(entry.file))
+			result.emplace(entry.key, entry.file);
+	for(std::uint64_t file : files)
+		result.emplace(file, file);
+
+	unmap();
+	added = std::move(result);
+	dirty = true;
+}
+
+void EpisodeIndex::save()
+{
+	if(!dirty)
+		return;
+
+	// Build the hash table with a load factor of at most 1/2
+	std::vector<Entry> all = entries();
+	std::uint64_t newCapacity = 16;
+	while(newCapacity < 2 * all.size())
+		newCapacity *= 2;
+	std::vector<Entry> newTable(newCapacity, Entry{0, 0});
+	for(const Entry& entry : all)
+	{
+		std::uint64_t i = entry.key & (newCapacity - 1);
+		while(newTable[i].key != 0 && newTable[i].key != entry.key)
+			i = (i + 1) & (newCapacity - 1);
+		newTable[i] = entry;
+	}
+	// Take the times of the directories now that all files are in place
+	std::string directoryData;
+	for(auto iter = directories.begin(); iter != directories.end();)
+	{
+		iter->second = directoryTime(directory / iter->first);
+		if(iter->second == 0 && !iter->first.empty())
+		{
+			iter = directories.erase(iter); // Removed since
+			continue;
+		}
+		std::uint32_t length = iter->first.size();
+		directoryData.append((const char*)&iter->second, sizeof(iter->second));
+		directoryData.append((const char*)&length, sizeof(length));
+		directoryData += iter->first;
+		iter++;
+	}
+
+	IndexHeader header;
+	std::memcpy(header.magic, indexMagic, sizeof(indexMagic));
+	header.directoryBytes = directoryData.size();
+	header.capacity = newCapacity;
+	header.count = all.size();
+	header.checksum = checksum(newTable.data(), newCapacity, directoryData.data(), directoryData.size());
+
+	// Write to a temporary file and replace the index atomically
+	std::error_code ec;
+	std::filesystem::create_directories(filename.parent_path(), ec);
+	std::filesystem::path tempName = filename;
+	tempName += ".new";
+	int fd = open(tempName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if(fd < 0)
+		throw std::runtime_error("Unable to write episode index \"" + tempName.string() + "\".");
+	bool ok = write(fd, &header, sizeof(header)) == (ssize_t)sizeof(header)
+		&& write(fd, newTable.data(), newCapacity * sizeof(Entry)) == (ssize_t)(newCapacity * sizeof(Entry))
+		&& write(fd, directoryData.data(), directoryData.size()) == (ssize_t)directoryData.size()
+		&& fsync(fd) == 0;
+	close(fd);
+	if(ok)
+		std::filesystem::rename(tempName, filename, ec);
+	if(!ok || ec)
+	{
+		std::filesystem::remove(tempName, ec);
+		throw std::runtime_error("Unable to write episode index \"" + filename.string() + "\".");
+	}
+	dirty = false;
+}
+
+std::uint64_t EpisodeIndex::hash(char kind, std::string_view str)
+{
+	// FNV-1a of kind followed by str, 0 is reserved for empty slots
+	std::uint64_t h = (14695981039346656037ull ^ (unsigned char)kind) * 1099511628211ull;
+	for(unsigned char c : str)
+		h = (h ^ c) * 1099511628211ull;
+	return h ? h : 1;
+}
+
+std::uint64_t EpisodeIndex::checksum(const Entry* entries, std::uint64_t count, const char* directoryData, std::size_t directoryBytes)
+{
+	std::uint64_t h = 14695981039346656037ull;
+	for(std::uint64_t i = 0; i < count; i++)
+		h = ((h ^ entries[i].key) * 1099511628211ull ^ entries[i].file) * 1099511628211ull;
+	for(std::size_t i = 0; i < directoryBytes; i++)
+		h = (h ^ (unsigned char)directoryData[i]) * 1099511628211ull;
+	return h;
+}
@@ -0,0 +1,118 @@
+/**
+ * \file episodeindex.h
+ * \brief Defines the EpisodeIndex class
+ */
+
+#ifndef EPISODEINDEX_H
+#define EPISODEINDEX_H
+
+#include<string>
+#include<string_view>
+#include<vector>
+#include<map>
+#include<unordered_map>
+#include<cstdint>
+#include<filesystem>
+
+/**
+ * \brief Persistent record of the episodes of a feed that have been downloaded
+ * \details The index answers whether an episode has already been downloaded
+ * without looking at the download directory. It is keyed by both the episode's
+ * GUID (or enclosure URI) and the name of the file it was downloaded to,
+ * relative to the download directory (episodes may be placed in
+ * subdirectories, see Feed).
+ *
+ * On disk, the index is an open-addressing hash table of 64-bit hashes that is
+ * memory-mapped for lookups, so it is not parsed into memory and a lookup is
+ * O(1). It is rewritten atomically by save() (write to a temporary file,
+ * fsync, rename) and protected by a checksum over the table and the stored
+ * directory data, which is verified when the index is loaded. Loading thus
+ * reads the whole file once, 16 bytes per slot of the table.
+ *
+ * The modification times of the download directory and of all directories
+ * below it are stored with the index. Adding, removing or renaming anything
+ * changes the time of the directory it happens in, so if one of them differs
+ * when the index is loaded (because files were added or removed by someone
+ * else, or JPod was interrupted before it could save the index), the index is
+ * rebuilt from the directory tree: entries whose file no longer exists are
+ * dropped and every file is added by its relative path. Checking the times
+ * takes one stat() per directory, no matter how many files there are.
+ * Hidden directories (like the ".partial" directories of unfinished
+ * downloads) are left out.
+ */
+class EpisodeIndex
+{
+private:
+	struct Entry
+	{
+		std::uint64_t key, file;
+	};
+
+	std::filesystem::path filename, directory;
+	void* mapping;
+	std::size_t mappingSize;
+	const Entry* table;
+	std::uint64_t capacity;
+	std::unordered_map<std::uint64_t, std::uint64_t> added;
+	std::map<std::string, std::int64_t> directories;
+	bool dirty;
+
+	void load();
+	void unmap();
+	bool find(std::uint64_t key) const;
+	static std::uint64_t hash(char kind, std::string_view str);
+	static std::uint64_t checksum(const Entry* entries, std::uint64_t count, const char* directoryData, std::size_t directoryBytes);
+	std::vector<Entry> entries() const;
+public:
+	/**
+	 * \brief Opens the index of a feed
+	 * \details The index is rebuilt if it does not exist, is corrupt, or is
+	 * out of date with respect to the directory.
+	 * \param filename The file where the index is stored.
+	 * \param directory The directory where the episodes are downloaded to.
+	 */
+	EpisodeIndex(std::filesystem::path filename, std::filesystem::path directory);
+
+	/**
+	 * \brief Destructor
+	 * \details Unmaps the index. Changes are lost unless save() was called.
+	 */
+	~EpisodeIndex();
+
+	EpisodeIndex(const EpisodeIndex&) = delete;
+	EpisodeIndex& operator=(const EpisodeIndex&) = delete;
+
+	/**
+	 * \brief Checks whether an episode has been downloaded
+	 * \param key The GUID or enclosure URI of the episode.
+	 * \param file The name of the file for the episode, without extension,
+	 * relative to the download directory and with '/' as separator.
+	 * \return True if an episode with the same key has been downloaded (and
+	 * its file still existed when the index was last rebuilt) or if a file
+	 * with the same name (ignoring the extension) exists.
+	 */
+	bool contains(std::string_view key, std::string_view file) const;
+
+	/**
+	 * \brief Records that an episode has been downloaded
+	 * \param key The GUID or enclosure URI of the episode.
+	 * \param file The name of the file for the episode, without extension,
+	 * relative to the download directory and with '/' as separator.
+	 */
+	void add(std::string_view key, std::string_view file);
+
+	/**
+	 * \brief Rebuilds the index from the contents of the directory tree
+	 * \details Entries whose file no longer exists are dropped and every file
+	 * in the tree is added by its relative path (with and without extension).
+	 */
+	void rebuild();
+
+	/**
+	 * \brief Writes the index to disk if it has changed
+	 * \throws std::runtime_error If the index could not be written.
+	 */
+	void save();
+};
+
+#endif //EPISODEINDEX_H
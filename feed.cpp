@@ -4,14 +4,31 @@
  */
 
 #include<stdexcept>
-#include<iostream>
 #include<algorithm>
-#include<mrss.h>
+#include<chrono>
+#include<thread>
+#include<ctime>
+#include<exception>
+#include<unordered_map>
+#include<unordered_set>
+#include<curl/curl.h>
 #include"feed.h"
+#include"responseheaders.h"
+#include"transfercontext.h"
+#include"dateparser.h"
+#include"feedparser.h"
+#include"catalog.h"
 
-Feed::Feed(std::string uid, std::string uri, std::filesystem::path basePath, std::string filenamePattern, std::vector<Filter> filters)
-: uid(uid), uri(uri), basePath(basePath), filenamePattern(filenamePattern), filters(filters), updated(false)
+Feed::Feed(std::string uid, std::string uri, std::filesystem::path basePath, std::string filenamePattern, std::filesystem::path statePath, unsigned priority, std::vector<Filter> filters)
+: uid(uid), uri(uri), filenamePattern(filenamePattern), filenameTemplates(PlaceholderPattern::splitPath(filenamePattern)), basePath(basePath), statePath(statePath), priority(priority), maxAge(-1), filters(filters), updated(false), basePathChecked(false), partialList(false), pendingDownloads(0), downloadFailed(false)
 {
+}
+
+void Feed::checkBasePath()
+{
+	if(basePathChecked)
+		return;
+
 	// Make sure basePath exists and is accessible
 	if(!std::filesystem::exists(basePath))
 	{
@@ -26,61 +43,169 @@ Feed::Feed(std::string uid, std::string uri, std::filesystem::path basePath, std
 	}
 	else if(!std::filesystem::is_directory(basePath))
 		throw std::runtime_error(std::string("Base path for RSS feed is not a directory: ") + basePath.string());
+	basePathChecked = true;
 }
 
-void Feed::update()
+/// Returns the time that has passed since start in seconds
+static double secondsSince(std::chrono::steady_clock::time_point start)
 {
-	// Retrieve feed
-	mrss_t* mrss;
-	mrss_error_t err = mrss_parse_url(&uri[0], &mrss);
-	if(err != MRSS_OK)
-		throw std::runtime_error(std::string("Error parsing podcast RSS feed: ") + mrss_strerror(err));
-
-	// Extract title & description
-	title = mrss->title;
-	description = mrss->description;
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
 
-	// Get Episodes
+void Feed::update(bool incremental)
+{
+	auto start = std::chrono::steady_clock::now();
+	metrics = FeedMetrics();
 	episodes.clear();
-	mrss_item_t* item = mrss->item;
-	while(item)
+	itemTimes.clear();
+	arena = std::make_shared<Arena>();
+	cache = std::make_shared<FeedCache>(statePath);
+	bool cached = cache->exists();
+
+	// The catalog needs every episode once
+	std::error_code ec;
+	if(incremental && !std::filesystem::exists(getCatalogPath(), ec))
+		incremental = false;
+	partialList = incremental;
+
+	// Items up to the newest one of the cached document are new, the rest have been processed before
+	std::string lastItem = incremental && cached ? cache->getLastItem() : "";
+	std::string firstItem;
+	bool firstSeen = false, lastSeen = false;
+	FeedParser parser([&](const FeedItem& item)
 	{
+		std::string_view guid = Episode::guidOf(item);
+		if(!firstSeen)
+		{
+			firstSeen = true;
+			firstItem = guid;
+			if(firstItem == lastItem)
+				lastItem = ""; // Nothing new at the top, so the document changed elsewhere (or lists the oldest item first)
+
+			// Filters may refer to the feed's title and description, which come before the items
+			title = arena->store(parser.getTitle());
+			description = arena->store(parser.getDescription());
+			updated = true;
+		}
+
+		// The items processed before still tell how often the feed publishes
+		if(lastSeen || (!lastItem.empty() && guid == lastItem))
+		{
+			lastSeen = true;
+			std::tm date;
+			std::time_t time;
+			if(DateParser::parse(item.pubDate.c_str(), date, time))
+				itemTimes.push_back(time);
+			return;
+		}
+
+		metrics.items++;
 		try
 		{
 			// Create an Episode object
-			Episode episode(this, item);
+			Episode episode(item, title, description);
+			itemTimes.push_back(episode.getPubTime());
 
 			// Include this episode unless it gets filtered out
+			auto filterStart = std::chrono::steady_clock::now();
 			FilterResult filterResult = FilterResult::INCONCLUSIVE;
-			for(Filter filter : filters)
+			for(const Filter& filter : filters)
 			{
 				filterResult = filter.apply(episode);
 				if(filterResult != FilterResult::INCONCLUSIVE)
 					break;
 			}
+			metrics.filterSeconds += secondsSince(filterStart);
 			if(filterResult != FilterResult::EXCLUDE) // Include by default
+			{
+				// Only the strings of episodes that are kept are copied
+				episode.keep(*arena);
 				episodes.push_back(episode);
+			}
 		}
 		catch(std::runtime_error& e) {} // If an error occurs, ignore this episode and continue with the next one. 
+	});
 
-		// Move on to next episode
-		item = item->next;
-	}
+	double parseSeconds = 0;
+	auto parse = [&](const char* data, std::size_t size, bool last)
+	{
+		auto parseStart = std::chrono::steady_clock::now();
+		try
+		{
+			if(last)
+				parser.finish();
+			else
+				parser.parse(data, size);
+		}
+		catch(std::runtime_error& e)
+		{
+			throw std::runtime_error(std::string("Error parsing podcast RSS feed: ") + e.what());
+		}
+		parseSeconds += secondsSince(parseStart);
+	};
 
-	// Free resources
-	mrss_free(mrss);
+	// Retrieve feed, only if it has changed since the cached copy, and parse it as it arrives
+	ResponseHeaders responseHeaders;
+	long responseCode = fetch(uri, cached ? cache->getEtag() : "", cached ? cache->getLastModified() : "", [&](const char* data, std::size_t size)
+	{
+		metrics.documentBytes += size;
+		cache->write(data, size); // The new document becomes the cached one once its episodes are downloaded
+		parse(data, size, false);
+	}, responseHeaders, metrics.retries);
+	maxAge = responseHeaders.getMaxAge();
+	metrics.responseCode = responseCode;
+	metrics.cacheHit = responseCode == 304;
+	if(responseCode == 304)
+	{
+		// Nothing new, no need to even look at the document
+		if(incremental)
+		{
+			metrics.fetchSeconds = secondsSince(start);
+			title = arena->store(cache->getTitle());
+			description = arena->store(cache->getDescription());
+			updated = true;
+			metrics.updated = true;
+			metrics.updateSeconds = secondsSince(start);
+			return;
+		}
+		cache->readDocument([&](const char* data, std::size_t size) {parse(data, size, false);});
+	}
+	else if(responseCode != 200 && responseCode != 0) // 0 for non-HTTP URIs like file://
+		throw std::runtime_error("Error retrieving podcast RSS feed, got response code " + std::to_string(responseCode));
+	parse(nullptr, 0, true);
+	partialList = lastSeen;
+	metrics.fetchSeconds = secondsSince(start);
+	metrics.parseSeconds = parseSeconds - metrics.filterSeconds;
 
+	// The title and description may also come after the items
+	if(title != parser.getTitle())
+		title = arena->store(parser.getTitle());
+	if(description != parser.getDescription())
+		description = arena->store(parser.getDescription());
 	updated = true;
+
+	if(responseCode != 304)
+	{
+		try
+		{
+			cache->stage(responseHeaders.etag, responseHeaders.lastModified, std::string(title), std::string(description), firstItem);
+		}
+		catch(std::runtime_error& e) {} // The cache is only an optimization
+	}
+
+	metrics.episodes = episodes.size();
+	metrics.updated = true;
+	metrics.updateSeconds = secondsSince(start);
 }
 
-std::string Feed::getTitle() const
+std::string_view Feed::getTitle() const
 {
 	if(!updated)
 		throw std::runtime_error("Feed must be updated before its title is available");
 	return title;
 }
 
-std::string Feed::getDescription() const
+std::string_view Feed::getDescription() const
 {
 	if(!updated)
 		throw std::runtime_error("Feed must be updated before its description is available");
@@ -94,48 +219,355 @@ const std::vector<Episode>& Feed::getEpisodes() const
 	return episodes;
 }
 
-void Feed::download()
+void Feed::download(DownloadEngine& engine, std::ostream& log)
 {
 	if(!updated)
 		throw std::runtime_error("Feed must be updated before its episode list is available");
+	checkBasePath();
+	pendingDownloads = 0;
+	downloadFailed = false;
+	auto indexStart = std::chrono::steady_clock::now();
+	index = std::make_shared<EpisodeIndex>(statePath / "index", basePath);
+	metrics.indexSeconds = secondsSince(indexStart);
+	std::string filename;
 	for(const Episode& ep : getEpisodes())
 	{
 		// Create a filename for the episode
-		std::string filename = cleanupFilename(ep.fillPlaceholders(filenamePattern));
+		makeFilename(ep, filenameTemplates, filename);
 
 		// Find out if the episode is already downloaded (ignore file extension since we don't know that without downloading)
-		bool found = false;
-		for(std::filesystem::directory_iterator iter(basePath); iter != std::filesystem::directory_iterator(); iter++)
+		indexStart = std::chrono::steady_clock::now();
+		bool downloaded = index->contains(ep.getGuid(), filename);
+		metrics.indexSeconds += secondsSince(indexStart);
+		if(downloaded)
 		{
-			if(std::filesystem::is_regular_file(*iter) && iter->path().stem() == filename)
-				found = true;
+			metrics.skipped++;
+			continue;
 		}
-		if(found) continue;
 
-		// Download the episode
+		// Queue the episode for download
 		std::filesystem::path episodePath = basePath;
 		episodePath.append(filename);
-		try
+		std::string_view episodeTitle = ep.getTitle(), episodeGuid = ep.getGuid();
+		pendingDownloads++;
+		engine.add(std::string(ep.getUri()), episodePath, priority, [this, episodeTitle, episodeGuid, filename, &log](const std::runtime_error* e, const DownloadStats& stats)
 		{
-			ep.download(episodePath);
+			EpisodeMetrics episodeMetrics;
+			episodeMetrics.title = episodeTitle;
+			episodeMetrics.guid = episodeGuid;
+			episodeMetrics.filename = filename;
+			episodeMetrics.success = !e;
+			episodeMetrics.error = e ? e->what() : "";
+			episodeMetrics.transfer = stats;
+			metrics.downloads.push_back(episodeMetrics);
+			if(e)
+			{
+				log << "The episode \"" << episodeTitle << "\" from the feed \"" << getTitle() << "\" could not be downloaded: " << e->what() << std::endl;
+				downloadFailed = true;
+			}
+			else
+				index->add(episodeGuid, filename);
+			if(--pendingDownloads == 0)
+				finishDownloads(log);
+		});
+	}
+	if(pendingDownloads == 0)
+		finishDownloads(log);
+}
+
+void Feed::finishDownloads(std::ostream& log)
+{
+	try
+	{
+		index->save();
+	}
+	catch(std::runtime_error& e)
+	{
+		log << "A problem ocurred when updating the feed with UID \"" << uid << "\": " << e.what() << std::endl;
+	}
+	try
+	{
+		updateCatalog();
+	}
+	catch(std::runtime_error& e)
+	{
+		log << "A problem ocurred when updating the feed with UID \"" << uid << "\": " << e.what() << std::endl;
+	}
+	// Once everything is downloaded, the next update only needs to look for changes
+	if(!downloadFailed)
+		cache->commit();
+}
+
+void Feed::updateCatalog()
+{
+	if(!updated)
+		throw std::runtime_error("Feed must be updated before its episode list is available");
+	std::filesystem::path catalogPath = getCatalogPath();
+	Catalog previous(catalogPath);
+	if(partialList && !previous.isValid())
+	{
+		// Without the episodes seen before, the next update has to look at all of them again
+		std::error_code ec;
+		std::filesystem::remove(catalogPath, ec);
+		return;
+	}
+	if(partialList && episodes.empty())
+		return;
+
+	// The download state comes from the index that download() used, if there is one
+	std::shared_ptr<EpisodeIndex> downloaded = index ? index : std::make_shared<EpisodeIndex>(statePath / "index", basePath);
+	std::vector<CatalogEpisode> list;
+	std::unordered_set<std::string_view> guids;
+	std::string filename;
+	for(const Episode& ep : episodes)
+	{
+		makeFilename(ep, filenameTemplates, filename);
+		std::tm date = *ep.getPubDate();
+		long utcOffset = timegm(&date) - ep.getPubTime();
+		list.push_back(CatalogEpisode{ep.getTitle(), ep.getDescription(), ep.getUri(), ep.getGuid(), ep.getPubTime(), utcOffset, downloaded->contains(ep.getGuid(), filename)});
+		guids.insert(ep.getGuid());
+	}
+	if(partialList)
+	{
+		for(std::size_t i = 0; i < previous.size(); i++)
+		{
+			CatalogEpisode ep = previous.getEpisode(i);
+			if(guids.insert(ep.guid).second)
+				list.push_back(ep);
 		}
-		catch(std::runtime_error& e)
+	}
+	Catalog::write(catalogPath, title, description, list);
+}
+
+void Feed::reindex()
+{
+	checkBasePath();
+	EpisodeIndex index(statePath / "index", basePath);
+	index.rebuild();
+	index.save();
+}
+
+unsigned Feed::migrate(std::string fromPattern, std::ostream& log)
+{
+	if(!updated)
+		throw std::runtime_error("Feed must be updated before its episode list is available");
+	checkBasePath();
+
+	// Earlier versions removed every '/' from the filled in pattern
+	if(fromPattern.empty())
+	{
+		for(std::size_t i = 0; i < filenamePattern.length(); i++)
 		{
-			std::cerr << "The episode \"" << ep.getTitle() << "\" from the feed \"" << getTitle() << "\" could not be downloaded: " << e.what() << std::endl;
+			if(filenamePattern[i] == '%' && i + 1 < filenamePattern.length())
+				fromPattern += filenamePattern[i++];
+			else if(filenamePattern[i] == '/')
+				continue;
+			fromPattern += filenamePattern[i];
 		}
 	}
+	std::vector<PlaceholderPattern> fromTemplates = PlaceholderPattern::splitPath(fromPattern);
+
+	// Find the files by their relative path without extension
+	std::unordered_map<std::string, std::filesystem::path> files;
+	std::error_code ec;
+	for(std::filesystem::recursive_directory_iterator iter(basePath, std::filesystem::directory_options::skip_permission_denied, ec); !ec && iter != std::filesystem::recursive_directory_iterator(); iter.increment(ec))
+	{
+		if(iter->is_directory(ec) && iter->path().filename().string()[0] == '.')
+			iter.disable_recursion_pending();
+		else if(iter->is_regular_file(ec))
+			files.emplace(iter->path().lexically_relative(basePath).replace_extension().generic_string(), iter->path());
+		ec.clear();
+	}
+
+	unsigned moved = 0;
+	std::string from, to;
+	std::vector<std::pair<std::string_view, std::string>> migrated;
+	for(const Episode& ep : getEpisodes())
+	{
+		makeFilename(ep, fromTemplates, from);
+		makeFilename(ep, filenameTemplates, to);
+		auto iter = files.find(from);
+		if(from == to || iter == files.end())
+			continue;
+		std::filesystem::path source = iter->second, target = basePath / (to + source.extension().string());
+		if(std::filesystem::exists(target, ec))
+		{
+			log << "Unable to move \"" << source.string() << "\" to \"" << target.string() << "\": the file exists" << std::endl;
+			continue;
+		}
+		std::filesystem::create_directories(target.parent_path(), ec);
+		std::filesystem::rename(source, target, ec);
+		if(ec)
+		{
+			log << "Unable to move \"" << source.string() << "\" to \"" << target.string() << "\": " << ec.message() << std::endl;
+			continue;
+		}
+		files.erase(iter);
+		moved++;
+		migrated.emplace_back(ep.getGuid(), to);
+
+		// Remove the directories that were emptied (but for the leftover directory of partial files), up to the base path
+		for(std::filesystem::path directory = source.parent_path(); directory != basePath && directory.string().size() > basePath.string().size(); directory = directory.parent_path())
+		{
+			std::filesystem::remove(directory / ".partial", ec);
+			if(!std::filesystem::remove(directory, ec))
+				break;
+		}
+	}
+
+	// The index learns the new names, and that the old ones are gone
+	EpisodeIndex index(statePath / "index", basePath);
+	index.rebuild();
+	for(const auto& entry : migrated)
+		index.add(entry.first, entry.second);
+	index.save();
+	return moved;
 }
 
-std::string Feed::cleanupFilename(std::string filename)
+void Feed::makeFilename(const Episode& episode, const std::vector<PlaceholderPattern>& templates, std::string& filename)
 {
-	// Remove all characters that might be problematic in a filename
-	std::string result;
-	std::remove_copy_if(filename.begin(), filename.end(), std::back_inserter(result), [](char c) {return std::string("!#$^&=+*{}:;\"'<>?|/\\").find(c) != std::string::npos;});
+	filename.clear();
+	if(templates.size() == 1)
+	{
+		templates[0].fill(episode, filename);
+		cleanupFilename(filename);
+		return;
+	}
+
+	// Every part is cleaned up on its own, so values of placeholders cannot add or leave directories
+	std::string part;
+	for(std::size_t i = 0; i < templates.size(); i++)
+	{
+		part.clear();
+		templates[i].fill(episode, part);
+		cleanupFilename(part);
+		if(i + 1 < templates.size())
+		{
+			// Directories are neither hidden nor "." or ".."
+			part.erase(0, part.find_first_not_of('.'));
+			if(part.empty())
+				part = "_";
+			part += '/';
+		}
+		filename += part;
+	}
+}
+
+/// State of a feed retrieval, passed to curlWrite()
+struct FetchContext
+{
+	CURL* curl;
+	const std::function<void(const char*, std::size_t)>* consumer;
+	std::exception_ptr exception;
+	bool consumed;
+};
+
+// Callback function for CURL to write data
+static size_t curlWrite(void* ptr, size_t size, size_t nmemb, FetchContext* context)
+{
+	// Only a document that is going to be used is passed on, not an error page
+	long responseCode = 0;
+	curl_easy_getinfo(context->curl, CURLINFO_RESPONSE_CODE, &responseCode);
+	if(responseCode != 200 && responseCode != 0)
+		return size * nmemb;
 
-	// Cut filename to 250 characters maximum (255 is the limit, leave some space for extension)
-	if(result.length() > 250)
-		result = result.substr(0, 250);
+	// Exceptions must not pass through curl, they are rethrown once the transfer is aborted
+	context->consumed = true;
+	try
+	{
+		(*context->consumer)((char*)ptr, size * nmemb);
+	}
+	catch(...)
+	{
+		context->exception = std::current_exception();
+		return 0;
+	}
+	return size * nmemb;
+}
+
+long Feed::fetch(const std::string& uri, const std::string& etag, const std::string& lastModified, const std::function<void(const char*, std::size_t)>& consumer, ResponseHeaders& responseHeaders, unsigned& retries)
+{
+	TransferContext& transferContext = TransferContext::get();
+	std::string host = TransferContext::hostOf(uri);
+	CircuitBreaker* breaker = transferContext.getCircuitBreaker();
+
+	// Make the request conditional if validators are known
+	struct curl_slist* headers = NULL;
+	if(!etag.empty())
+		headers = curl_slist_append(headers, ("If-None-Match: " + etag).c_str());
+	if(!lastModified.empty())
+		headers = curl_slist_append(headers, ("If-Modified-Since: " + lastModified).c_str());
+
+	for(retries = 0;; retries++)
+	{
+		std::time_t openUntil = breaker ? breaker->admit(host, std::time(NULL)) : 0;
+		if(openUntil)
+		{
+			curl_slist_free_all(headers);
+			throw std::runtime_error("Skipped, the server \"" + host + "\" failed repeatedly and is not contacted for another " + std::to_string((openUntil - std::time(NULL) + 59) / 60) + " minutes");
+		}
 
-	return result;
+		CURL* curl = transferContext.acquire(TransferKind::FEED);
+		FetchContext context{curl, &consumer, nullptr, false};
+		responseHeaders = ResponseHeaders();
+		curl_easy_setopt(curl, CURLOPT_URL, uri.c_str());
+		curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+		curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
+		curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, curlWrite);
+		curl_easy_setopt(curl, CURLOPT_WRITEDATA, &context);
+		curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, ResponseHeaders::curlHeader);
+		curl_easy_setopt(curl, CURLOPT_HEADERDATA, &responseHeaders);
+
+		CURLcode res = curl_easy_perform(curl);
+		long responseCode = 0;
+		curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &responseCode);
+		transferContext.release(curl);
+		if(context.exception)
+		{
+			if(breaker)
+				breaker->succeeded(host); // The server answered, the document is to blame
+			curl_slist_free_all(headers);
+			std::rethrow_exception(context.exception);
+		}
+
+		bool transient = RetryPolicy::isTransient(res, responseCode);
+		if(breaker && transient)
+			breaker->failed(host, std::time(NULL));
+		else if(breaker && responseCode > 0)
+			breaker->succeeded(host);
+		else if(breaker)
+			breaker->inconclusive(host, std::time(NULL));
+
+		// Once the parser has seen a part of the document, it cannot start over
+		if(transient && !context.consumed && retries < transferContext.getRetryPolicy().getRetries())
+		{
+			std::this_thread::sleep_for(std::chrono::duration<double>(transferContext.getRetryPolicy().backoff(retries + 1)));
+			continue;
+		}
+		curl_slist_free_all(headers);
+		if(res != CURLE_OK)
+			throw std::runtime_error(std::string("Error retrieving podcast RSS feed: ") + curl_easy_strerror(res));
+		return responseCode;
+	}
+}
+
+void Feed::cleanupFilename(std::string& filename)
+{
+	// Remove all characters that might be problematic in a filename
+	static const struct Problematic
+	{
+		bool table[256] = {};
+		Problematic() {for(const char* c = "!#$^&=+*{}:;\"'<>?|/\\"; *c; c++) table[(unsigned char)*c] = true;}
+	} problematic;
+	filename.erase(std::remove_if(filename.begin(), filename.end(), [](char c) {return problematic.table[(unsigned char)c];}), filename.end());
+
+	// Cut filename to 250 bytes maximum (255 is the limit, leave some space for extension), without splitting a UTF-8 sequence
+	if(filename.length() > 250)
+	{
+		std::size_t length = 250;
+		while(length > 0 && (filename[length] & 0xC0) == 0x80)
+			length--;
+		filename.resize(length);
+	}
 }
 
@@ -7,67 +7,117 @@
 #define FEED_H
 
 #include<string>
+#include<string_view>
 #include<vector>
+#include<memory>
+#include<ostream>
 #include<filesystem>
+#include<ctime>
+#include<functional>
 #include"episode.h"
+#include"arena.h"
 #include"filter.h"
+#include"placeholderpattern.h"
+#include"metrics.h"
+#include"downloadengine.h"
+#include"feedcache.h"
+#include"episodeindex.h"
+
+struct ResponseHeaders;
 
 /**
  * \brief Represents a podcast feed
+ * \details The strings of the feed and its episodes are kept in an Arena that
+ * is replaced by every update(), so they stay valid until the next update()
+ * or until the last copy of the Feed is destroyed. Feeds are best passed by
+ * reference or moved.
  */
 class Feed
 {
 private:
 	std::string uid, uri, filenamePattern;
-	std::filesystem::path basePath;
-	std::string title, description;
+	std::vector<PlaceholderPattern> filenameTemplates;
+	std::filesystem::path basePath, statePath;
+	unsigned priority;
+	std::shared_ptr<Arena> arena;
+	std::string_view title, description;
 	std::vector<Episode> episodes;
+	std::vector<std::time_t> itemTimes;
+	long maxAge;
 	std::vector<Filter> filters;
-	bool updated;
+	bool updated, basePathChecked, partialList;
+	std::shared_ptr<FeedCache> cache;
+	std::shared_ptr<EpisodeIndex> index;
+	unsigned pendingDownloads;
+	bool downloadFailed;
+	FeedMetrics metrics;
 
-	static std::string cleanupFilename(std::string filename);
+	void checkBasePath();
+	static void makeFilename(const Episode& episode, const std::vector<PlaceholderPattern>& templates, std::string& filename);
+	void finishDownloads(std::ostream& log);
+	static long fetch(const std::string& uri, const std::string& etag, const std::string& lastModified, const std::function<void(const char*, std::size_t)>& consumer, ResponseHeaders& responseHeaders, unsigned& retries);
 public:
 	/**
 	 * \brief Constructs a Feed object
 	 * \details No internet connectivity is needed at this point. The URI is
-	 * not accessed until update() is called.
+	 * not accessed until update() is called, and the base path is not
+	 * accessed until download() or reindex() is called.
 	 * \param uid Unique ID for this podcast feed. This string is mainly used
 	 * to identify the podcast from the command line.
 	 * \param uri The URI of the RSS feed.
 	 * \param basePath Path to the directory where downloaded episodes should
-	 * be placed. If this path does not exist, it is created.
+	 * be placed. If this path does not exist, it is created when needed.
 	 * \param filenamePattern Used to create filenames for downloaded episodes.
-	 * See Episode#fillPlaceholders() for details.
+	 * See Episode#fillPlaceholders() for details. A '/' in the pattern (but
+	 * not in the values of its placeholders) separates directories below the
+	 * base path, e.g. "%Y/%m/%T".
+	 * \param statePath Path to the directory where JPod keeps data about this
+	 * feed between runs (e.g. the cached RSS document). It is created when
+	 * needed.
+	 * \param priority Episodes of feeds with a higher priority are downloaded
+	 * before those of feeds with a lower one and get a larger share of the
+	 * bandwidth (see DownloadEngine).
 	 * \param filters A list of filters that are applied to each episode in
 	 * this feed.
-	 * \throws std::runtime_error If the base path could not be accessed or
-	 * created.
 	 */
-	Feed(std::string uid, std::string uri, std::filesystem::path basePath, std::string filenamePattern, std::vector<Filter> filters = std::vector<Filter>());
+	Feed(std::string uid, std::string uri, std::filesystem::path basePath, std::string filenamePattern, std::filesystem::path statePath, unsigned priority, std::vector<Filter> filters = std::vector<Filter>());
 
 	/**
 	 * \brief Returns the feed's unique id
 	 * \return The unique identifier string for this feed.
 	 */
-	std::string getUid() const {return uid;}
+	const std::string& getUid() const {return uid;}
 
 	/**
 	 * \brief Returns the feed's URI
 	 * \return The URI of the RSS feed.
 	 */
-	std::string getUri() const {return uri;}
+	const std::string& getUri() const {return uri;}
 
 	/**
 	 * \brief Returns the feed's base path
 	 * \return The base path where downloaded episodes are stored.
 	 */
-	std::filesystem::path getBasePath() const {return basePath;}
+	const std::filesystem::path& getBasePath() const {return basePath;}
 
 	/**
 	 * \brief Returns the feed's filename pattern
 	 * \return The pattern used to generate filenames for downloaded episodes.
 	 */
-	std::string getFilenamePattern() const {return filenamePattern;}
+	const std::string& getFilenamePattern() const {return filenamePattern;}
+
+	/**
+	 * \brief Returns the feed's priority
+	 * \return The priority of the feed's downloads.
+	 */
+	unsigned getPriority() const {return priority;}
+
+	/**
+	 * \brief Returns what happened to the feed during update() and download()
+	 * \details The episodes are added as their downloads finish.
+	 * \return Timings, sizes and status of the feed and its downloads.
+	 */
+	const FeedMetrics& getMetrics() const {return metrics;}
 
 	/**
 	 * \brief Updates the feed from the URI
@@ -76,24 +126,39 @@ public:
 	 * </item>` section contains invalid data) but the rest of the RSS feed is
 	 * still readable, the episode is ignored and the method continues with the
 	 * next one.
+	 * The document is parsed while it is being retrieved (see FeedParser),
+	 * RSS and Atom feeds are supported.
+	 * The last retrieved document is cached (see FeedCache) and the
+	 * request is made conditional on it, so an unchanged document is not
+	 * transferred again.
+	 * A new document only becomes the cached one once all of its new episodes
+	 * have been downloaded.
+	 * A retrieval that fails before any of the document has arrived is
+	 * retried as the RetryPolicy of the TransferContext says, and a host that
+	 * its CircuitBreaker says to skip is not contacted at all.
+	 * \param incremental If true, only changes since the last successful
+	 * download() matter: if the document has not changed, it is not parsed at
+	 * all and the episode list stays empty. Otherwise, processing stops at the
+	 * item that was the newest one in the cached document, so the episode list
+	 * only contains new episodes. Ignored if the feed has no Catalog yet.
 	 * \throws std::runtime_error If an error occurs while downloading or
 	 * parsing the RSS feed.
 	 */
-	void update();
+	void update(bool incremental = false);
 
 	/**
 	 * \brief Returns the feed's title
 	 * \return The tite of the feed.
 	 * \throws std::runtime_error If update() has not been called before.
 	 */
-	std::string getTitle() const;
+	std::string_view getTitle() const;
 
 	/**
 	 * \brief Returns the feed's description
 	 * \return The description of the feed.
 	 * \throws std::runtime_error If update() has not been called before.
 	 */
-	std::string getDescription() const;
+	std::string_view getDescription() const;
 
 	/**
 	 * \brief Returns the feed's episode list
@@ -103,16 +168,111 @@ public:
 	const std::vector<Episode>& getEpisodes() const;
 
 	/**
-	 * \brief Downloads all missing episodes
-	 * \details To determine whether an episode has already been downloaded,
-	 * the method looks for a file with the same name (but not necessarily file
-	 * extension). If this file exists, regardless of its contents, that
-	 * episode is not (re)downloaded.
-	 * If the download of an episode fails, an error is printed to stderr but
-	 * the method continues with the next episode.
-	 * \throws std::runtime_error If update() has not been called before.
+	 * \brief Returns the publication times of the items seen in update()
+	 * \details Unlike getEpisodes(), this includes items that were filtered
+	 * out and, in incremental mode, the items that were processed before, so
+	 * it reflects how often the feed publishes. It is empty if the document
+	 * has not changed. Items with an invalid date are left out.
+	 * \return The UTC timestamps, in the order of the document.
+	 */
+	const std::vector<std::time_t>& getItemTimes() const {return itemTimes;}
+
+	/**
+	 * \brief Returns how long the server considers the feed fresh
+	 * \details See ResponseHeaders#getMaxAge(). Only valid after update().
+	 * \return The freshness lifetime in seconds, or -1 if unknown.
+	 */
+	long getMaxAge() const {return maxAge;}
+
+	/**
+	 * \brief Queues all missing episodes for download
+	 * \details Each part of the filename pattern is filled in and cleaned up
+	 * (see cleanupFilename()) on its own, and directories whose names would
+	 * begin with a dot lose the dots, so every episode ends up below the base
+	 * path. Directories are created as needed.
+	 * To determine whether an episode has already been downloaded,
+	 * the method consults the feed's EpisodeIndex: an episode is not
+	 * (re)downloaded if a file with the same name (but not necessarily file
+	 * extension) exists, regardless of its contents, or if the same episode
+	 * has been downloaded before and its file still exists.
+	 * The downloads are performed once DownloadEngine#run() is called. If the
+	 * download of an episode fails, an error is written to log but the
+	 * remaining episodes are downloaded nonetheless. Once all downloads have
+	 * finished, the catalog is updated (see updateCatalog()). The Feed and the
+	 * log must stay alive until the engine has finished.
+	 * \param engine The engine that performs the downloads.
+	 * \param log Stream that receives error messages, e.g. std::cerr.
+	 * \throws std::runtime_error If update() has not been called before or
+	 * the base path could not be accessed or created.
+	 */
+	void download(DownloadEngine& engine, std::ostream& log);
+
+	/**
+	 * \brief Returns where the feed's catalog is stored
+	 * \return The path of the Catalog written by updateCatalog().
+	 */
+	std::filesystem::path getCatalogPath() const {return getCatalogPath(statePath);}
+
+	/**
+	 * \brief Returns where the catalog of a feed is stored
+	 * \details Does not need the Feed object, see Config#getStatePaths().
+	 * \param statePath The directory where JPod keeps data about the feed.
+	 * \return The path of the Catalog written by updateCatalog().
+	 */
+	static std::filesystem::path getCatalogPath(const std::filesystem::path& statePath) {return statePath / "catalog";}
+
+	/**
+	 * \brief Writes the feed's title, description and episodes to its Catalog
+	 * \details Each episode is recorded with whether it has been downloaded.
+	 * If update() only found the new episodes (see its incremental
+	 * parameter), the others are taken over from the previous catalog; if the
+	 * document had not changed at all, the catalog is left alone.
+	 * download() calls this method itself.
+	 * \throws std::runtime_error If update() has not been called before or
+	 * the catalog could not be written.
+	 */
+	void updateCatalog();
+
+	/**
+	 * \brief Rebuilds the index of downloaded episodes from the base path
+	 * \details This is only necessary if the index has been damaged, since it
+	 * is rebuilt automatically whenever the base path has been modified by
+	 * someone else.
+	 * \throws std::runtime_error If the base path could not be accessed or
+	 * created, or the index could not be written.
+	 */
+	void reindex();
+
+	/**
+	 * \brief Moves downloaded episodes to where the filename pattern puts them
+	 * \details For every episode of the feed, the file that the old pattern
+	 * names (with any extension) is looked for below the base path and moved
+	 * to the name that the feed's filename pattern gives it, creating
+	 * directories as needed. Directories that are left empty are removed.
+	 * Files that are not found, or whose new name is taken, stay where they
+	 * are. Finally, the index of downloaded episodes is rebuilt.
+	 * update() should have been called with incremental set to false, so all
+	 * episodes are known.
+	 * \param fromPattern The pattern the files were named with. If empty, the
+	 * feed's pattern without its '/' is used, which gives the names that
+	 * versions of JPod without subdirectories created from it.
+	 * \param log Stream that receives a line for every file that could not
+	 * be moved, e.g. std::cerr.
+	 * \return The number of files moved.
+	 * \throws std::runtime_error If update() has not been called before, the
+	 * base path could not be accessed, or the index could not be written.
+	 */
+	unsigned migrate(std::string fromPattern, std::ostream& log);
+
+	/**
+	 * \brief Turns a string into a valid filename
+	 * \details Removes characters that are problematic in filenames
+	 * (including '/', so the result is always a single name) and truncates
+	 * the name to 250 bytes (without splitting UTF-8 sequences), so
+	 * there is room for an extension.
+	 * \param filename The string, modified in place.
 	 */
-	void download();
+	static void cleanupFilename(std::string& filename);
 };
 
 #endif //FEED_H
@@ -0,0 +1,134 @@
+/**
+ * \file feedcache.cpp
+ * \brief Implementation for feedcache.h
+ */
+
+#include<stdexcept>
+#include<fstream>
+#include<memory>
+#include"feedcache.h"
+
+FeedCache::FeedCache(std::filesystem::path directory)
+: directory(directory), writing(false), writeFailed(false), staged(false)
+{
+	std::ifstream ifs(directory / "feed.meta");
+	std::string line;
+	while(std::getline(ifs, line))
+	{
+		std::size_t pos = line.find('=');
+		if(pos == std::string::npos)
+			continue;
+		std::string key = line.substr(0, pos), value = unescape(line.substr(pos + 1));
+		if(key == "etag") etag = value;
+		else if(key == "last-modified") lastModified = value;
+		else if(key == "title") title = value;
+		else if(key == "description") description = value;
+		else if(key == "last-item") lastItem = value;
+	}
+}
+
+bool FeedCache::exists() const
+{
+	std::error_code ec;
+	return std::filesystem::is_regular_file(directory / "feed.meta", ec) && std::filesystem::is_regular_file(directory / "feed.xml", ec);
+}
+
+void FeedCache::readDocument(const std::function<void(const char*, std::size_t)>& consumer) const
+{
+	std::ifstream ifs(directory / "feed.xml", std::ios::binary);
+	if(!ifs.is_open())
+		throw std::runtime_error("Unable to read cached feed from \"" + (directory / "feed.xml").string() + "\".");
+	static const std::size_t CHUNK_SIZE = 64 * 1024;
+	std::unique_ptr<char[]> chunk(new char[CHUNK_SIZE]);
+	while(ifs.read(chunk.get(), CHUNK_SIZE) || ifs.gcount() > 0)
+		consumer(chunk.get(), ifs.gcount());
+	if(ifs.bad())
+		throw std::runtime_error("Unable to read cached feed from \"" + (directory / "feed.xml").string() + "\".");
+}
+
+void FeedCache::write(const char* data, std::size_t size)
+{
+	if(!writing)
+	{
+		std::error_code ec;
+		std::filesystem::create_directories(directory, ec);
+		staging.open(directory / "feed.xml.new", std::ios::binary | std::ios::trunc);
+		writing = true;
+		writeFailed = !staging.is_open();
+	}
+	if(!writeFailed && !staging.write(data, size))
+		writeFailed = true;
+}
+
+void FeedCache::stage(std::string etag, std::string lastModified, std::string title, std::string description, std::string lastItem)
+{
+	if(!writing)
+		throw std::runtime_error("No feed document has been written to the cache.");
+	staging.close();
+	writing = false;
+	if(writeFailed || staging.fail())
+		throw std::runtime_error("Unable to write cached feed to \"" + (directory / "feed.xml.new").string() + "\".");
+
+	this->etag = etag;
+	this->lastModified = lastModified;
+	this->title = title;
+	this->description = description;
+	this->lastItem = lastItem;
+	writeMeta(directory / "feed.meta.new");
+	staged = true;
+}
+
+void FeedCache::commit()
+{
+	if(!staged)
+		return;
+	// Replace the document first: a stale feed.meta with a new feed.xml at worst causes a full download next time
+	std::error_code ec;
+	std::filesystem::rename(directory / "feed.xml.new", directory / "feed.xml", ec);
+	if(!ec)
+		std::filesystem::rename(directory / "feed.meta.new", directory / "feed.meta", ec);
+	staged = false;
+}
+
+void FeedCache::writeMeta(std::filesystem::path filename) const
+{
+	std::ofstream ofs(filename, std::ios::trunc);
+	ofs
+		<< "etag=" << escape(etag) << std::endl
+		<< "last-modified=" << escape(lastModified) << std::endl
+		<< "title=" << escape(title) << std::endl
+		<< "description=" << escape(description) << std::endl
+		<< "last-item=" << escape(lastItem) << std::endl;
+	ofs.close();
+	if(ofs.fail())
+		throw std::runtime_error("Unable to write cache metadata to \"" + filename.string() + "\".");
+}
+
+std::string FeedCache::escape(const std::string& str)
+{
+	std::string result;
+	for(char c : str)
+	{
+		if(c == '\\') result += "\\\\";
+		else if(c == '\n') result += "\\n";
+		else if(c == '\r') result += "\\r";
+		else result += c;
+	}
+	return result;
+}
+
+std::string FeedCache::unescape(const std::string& str)
+{
+	std::string result;
+	for(std::size_t i = 0; i < str.length(); i++)
+	{
+		if(str[i] == '\\' && i + 1 < str.length())
+		{
+			i++;
+			result += str[i] == 'n' ? '\n' : str[i] == 'r' ? '\r' : str[i];
+		}
+		else
+			result += str[i];
+	}
+	return result;
+}
@@ -0,0 +1,120 @@
+/**
+ * \file feedcache.h
+ * \brief Defines the FeedCache class
+ */
+
+#ifndef FEEDCACHE_H
+#define FEEDCACHE_H
+
+#include<string>
+#include<fstream>
+#include<functional>
+#include<filesystem>
+
+/**
+ * \brief Stores the last retrieved RSS document of a feed on disk
+ * \details Besides the document itself, the cache keeps the HTTP validators
+ * (ETag and Last-Modified) the server sent with it, so the next request can
+ * be made conditional, as well as the feed's title and description, so they
+ * are available without parsing the document, and the GUID of its newest item,
+ * so a changed document only needs to be parsed up to that item.
+ * New contents are first staged and only replace the cached contents once
+ * commit() is called. This way, the cache can be kept at the old state until
+ * all episodes of the new document have been downloaded. Documents are
+ * written and read in pieces, so they never have to be held in memory as a
+ * whole.
+ */
+class FeedCache
+{
+private:
+	std::filesystem::path directory;
+	std::string etag, lastModified, title, description, lastItem;
+	std::ofstream staging;
+	bool writing, writeFailed, staged;
+
+	static std::string escape(const std::string& str);
+	static std::string unescape(const std::string& str);
+	void writeMeta(std::filesystem::path filename) const;
+public:
+	/**
+	 * \brief Creates a FeedCache and loads the validators if they exist
+	 * \param directory The directory where the cache files are kept. It is
+	 * created when the first document is staged.
+	 */
+	FeedCache(std::filesystem::path directory);
+
+	/**
+	 * \brief Returns whether a document is cached
+	 * \return True if a document and its metadata are available.
+	 */
+	bool exists() const;
+
+	/**
+	 * \brief Returns the ETag of the cached document
+	 * \return The ETag or an empty string if the server did not send one.
+	 */
+	const std::string& getEtag() const {return etag;}
+
+	/**
+	 * \brief Returns the Last-Modified date of the cached document
+	 * \return The date (as sent by the server) or an empty string.
+	 */
+	const std::string& getLastModified() const {return lastModified;}
+
+	/**
+	 * \brief Returns the feed title stored with the cached document
+	 * \return The title.
+	 */
+	const std::string& getTitle() const {return title;}
+
+	/**
+	 * \brief Returns the feed description stored with the cached document
+	 * \return The description.
+	 */
+	const std::string& getDescription() const {return description;}
+
+	/**
+	 * \brief Returns the GUID of the newest item of the cached document
+	 * \return The GUID (see Episode#getGuid()) of the first item in the
+	 * document, or an empty string.
+	 */
+	const std::string& getLastItem() const {return lastItem;}
+
+	/**
+	 * \brief Reads the cached document
+	 * \param consumer Called with each piece of the document in order.
+	 * \throws std::runtime_error If the document could not be read.
+	 */
+	void readDocument(const std::function<void(const char*, std::size_t)>& consumer) const;
+
+	/**
+	 * \brief Writes the next piece of a new document
+	 * \details The first call starts a new document, which is completed by
+	 * stage(). Errors are remembered and reported by stage().
+	 * \param data The next bytes of the document.
+	 * \param size Number of bytes.
+	 */
+	void write(const char* data, std::size_t size);
+
+	/**
+	 * \brief Completes the document passed to write() without making it current
+	 * \param etag The ETag sent with the document (may be empty).
+	 * \param lastModified The Last-Modified date sent with the document (may
+	 * be empty).
+	 * \param title The title of the feed.
+	 * \param description The description of the feed.
+	 * \param lastItem The GUID of the first item in the document.
+	 * \throws std::runtime_error If the files could not be written or no
+	 * document has been written.
+	 */
+	void stage(std::string etag, std::string lastModified, std::string title, std::string description, std::string lastItem);
+
+	/**
+	 * \brief Makes the staged document the current one
+	 * \details Does nothing if no document has been staged. Errors are
+	 * ignored since the cache is only an optimization.
+	 */
+	void commit();
+};
+
+#endif //FEEDCACHE_H
@@ -0,0 +1,531 @@
+/**
+ * \file feedparser.cpp
+ * \brief Implementation for feedparser.h
+ */
+
+#include<stdexcept>
+#include<cstring>
+#include<strings.h>
+#include"feedparser.h"
+
+/// Returns whether text begins with prefix
+static bool startsWith(std::string_view text, std::string_view prefix)
+{
+	return text.compare(0, prefix.size(), prefix) == 0;
+}
+
+/// Returns whether text is shorter than prefix but might become it with more data
+static bool mightStartWith(std::string_view text, std::string_view prefix)
+{
+	return text.size() < prefix.size() && prefix.compare(0, text.size(), text) == 0;
+}
+
+static bool isSpace(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+/// Removes leading and trailing whitespace
+static void trim(std::string& str)
+{
+	std::size_t end = str.size();
+	while(end > 0 && isSpace(str[end - 1]))
+		end--;
+	str.resize(end);
+	std::size_t start = 0;
+	while(start < str.size() && isSpace(str[start]))
+		start++;
+	str.erase(0, start);
+}
+
+/// Code points of the bytes 0x80 to 0x9F in Windows-1252, the undefined ones are kept
+static const unsigned short WINDOWS_1252[32] =
+{
+	0x20AC, 0x0081, 0x201A, 0x0192, 0x201E, 0x2026, 0x2020, 0x2021, 0x02C6, 0x2030, 0x0160, 0x2039, 0x0152, 0x008D, 0x017D, 0x008F,
+	0x0090, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014, 0x02DC, 0x2122, 0x0161, 0x203A, 0x0153, 0x009D, 0x017E, 0x0178
+};
+
+/// Appends a code point in UTF-8
+static void appendUtf8(std::string& out, unsigned long c)
+{
+	if(c < 0x80)
+		out += (char)c;
+	else if(c < 0x800)
+	{
+		out += (char)(0xC0 | (c >> 6));
+		out += (char)(0x80 | (c & 0x3F));
+	}
+	else if(c < 0x10000)
+	{
+		out += (char)(0xE0 | (c >> 12));
+		out += (char)(0x80 | ((c >> 6) & 0x3F));
+		out += (char)(0x80 | (c & 0x3F));
+	}
+	else
+	{
+		out += (char)(0xF0 | (c >> 18));
+		out += (char)(0x80 | ((c >> 12) & 0x3F));
+		out += (char)(0x80 | ((c >> 6) & 0x3F));
+		out += (char)(0x80 | (c & 0x3F));
+	}
+}
+
+/// Appends the character an entity reference (without & and ;) stands for, returns false if unknown
+static bool decodeEntity(std::string_view entity, std::string& out)
+{
+	if(entity == "lt") out += '<';
+	else if(entity == "gt") out += '>';
+	else if(entity == "amp") out += '&';
+	else if(entity == "quot") out += '"';
+	else if(entity == "apos") out += '\'';
+	else if(entity.size() >= 2 && entity[0] == '#')
+	{
+		bool hex = entity[1] == 'x' || entity[1] == 'X';
+		std::string_view digits = entity.substr(hex ? 2 : 1);
+		if(digits.empty())
+			return false;
+		unsigned long c = 0;
+		for(char d : digits)
+		{
+			int value = d >= '0' && d <= '9' ? d - '0' : hex && d >= 'a' && d <= 'f' ? d - 'a' + 10 : hex && d >= 'A' && d <= 'F' ? d - 'A' + 10 : -1;
+			if(value < 0)
+				return false;
+			c = c * (hex ? 16 : 10) + value;
+			if(c > 0x10FFFF)
+				return false;
+		}
+		if(c == 0)
+			return false;
+		appendUtf8(out, c);
+	}
+	else
+		return false;
+	return true;
+}
+
+FeedParser::FeedParser(ItemCallback callback)
+: callback(callback), mode(Mode::CONTENT), latin1(false), root(false), channelDepth(0), itemDepth(0), captureDepth(0), capture(nullptr)
+{
+}
+
+void FeedParser::parse(const char* data, std::size_t size)
+{
+	buffer.append(data, size);
+	process(false);
+}
+
+void FeedParser::finish()
+{
+	process(true);
+	if(!root)
+		throw std::runtime_error("Document is empty or not an RSS or Atom feed");
+	if(!stack.empty() || mode != Mode::CONTENT)
+		throw std::runtime_error("Document ends unexpectedly");
+}
+
+void FeedParser::process(bool last)
+{
+	const char* data = buffer.data();
+	std::size_t size = buffer.size(), pos = 0;
+	while(pos < size)
+	{
+		// CDATA sections and comments can be long, so they are consumed piece by piece
+		if(mode != Mode::CONTENT)
+		{
+			std::size_t end = buffer.find(mode == Mode::CDATA ? "]]>" : "-->", pos);
+			// Without the terminator, keep the last two bytes in case they start it
+			std::size_t stop = end != std::string::npos ? end : last ? size : size - pos > 2 ? size - 2 : pos;
+			if(mode == Mode::CDATA && capture)
+				appendText(*capture, std::string_view(data + pos, stop - pos), false);
+			pos = stop;
+			if(end == std::string::npos)
+				break;
+			pos += 3;
+			mode = Mode::CONTENT;
+			continue;
+		}
+
+		// Text up to the next markup
+		if(data[pos] != '<')
+		{
+			std::size_t end = buffer.find('<', pos);
+			if(end == std::string::npos)
+			{
+				end = size;
+				// Keep an entity reference that may continue in the next piece
+				std::size_t amp = buffer.rfind('&');
+				if(!last && amp != std::string::npos && amp >= pos && size - amp < 12 && buffer.find(';', amp) == std::string::npos)
+					end = amp;
+			}
+			if(capture)
+				appendText(*capture, std::string_view(data + pos, end - pos), true);
+			pos = end;
+			if(pos == size || data[pos] != '<')
+				break;
+			continue;
+		}
+
+		// Markup
+		std::string_view rest(data + pos, size - pos);
+		if(startsWith(rest, "<!--"))
+		{
+			mode = Mode::COMMENT;
+			pos += 4;
+			continue;
+		}
+		if(startsWith(rest, "<![CDATA["))
+		{
+			mode = Mode::CDATA;
+			pos += 9;
+			continue;
+		}
+		if(!last && (mightStartWith(rest, "<!--") || mightStartWith(rest, "<![CDATA[")))
+			break;
+
+		std::size_t end = std::string::npos;
+		if(startsWith(rest, "<?"))
+		{
+			end = rest.find("?>");
+			if(end != std::string::npos)
+			{
+				processDeclaration(rest.substr(2, end - 2));
+				end++;
+			}
+		}
+		else if(startsWith(rest, "<!"))
+		{
+			// DOCTYPE, possibly with an internal subset in brackets
+			int brackets = 0;
+			for(std::size_t i = 2; i < rest.size() && end == std::string::npos; i++)
+			{
+				if(rest[i] == '[') brackets++;
+				else if(rest[i] == ']') brackets--;
+				else if(rest[i] == '>' && brackets <= 0) end = i;
+			}
+		}
+		else
+		{
+			// A tag, where '>' may appear in quoted attribute values
+			char quote = 0;
+			for(std::size_t i = 1; i < rest.size() && end == std::string::npos; i++)
+			{
+				if(quote)
+				{
+					if(rest[i] == quote)
+						quote = 0;
+				}
+				else if(rest[i] == '"' || rest[i] == '\'')
+					quote = rest[i];
+				else if(rest[i] == '>')
+					end = i;
+			}
+			if(end != std::string::npos)
+			{
+				std::string_view tag = rest.substr(1, end - 1);
+				if(startsWith(tag, "/"))
+					endElement(tag.substr(1));
+				else
+					startElement(tag);
+			}
+		}
+		if(end == std::string::npos)
+		{
+			if(rest.size() > MAX_MARKUP_SIZE)
+				throw std::runtime_error("Document contains markup that is too long");
+			break;
+		}
+		pos += end + 1;
+	}
+
+	buffer.erase(0, pos);
+	if(last && !buffer.empty())
+		throw std::runtime_error("Document ends unexpectedly");
+}
+
+void FeedParser::processDeclaration(std::string_view declaration)
+{
+	if(!startsWith(declaration, "xml") || declaration.size() < 4 || !isSpace(declaration[3]))
+		return;
+	std::size_t pos = declaration.find("encoding");
+	if(pos == std::string::npos)
+		return;
+	std::size_t start = declaration.find_first_of("\"'", pos);
+	if(start == std::string::npos)
+		return;
+	std::size_t end = declaration.find(declaration[start], start + 1);
+	std::string encoding(declaration.substr(start + 1, end == std::string::npos ? std::string::npos : end - start - 1));
+	latin1 = strcasecmp(encoding.c_str(), "ISO-8859-1") == 0 || strcasecmp(encoding.c_str(), "latin1") == 0 || strcasecmp(encoding.c_str(), "windows-1252") == 0;
+}
+
+void FeedParser::startElement(std::string_view tag)
+{
+	bool selfClosing = !tag.empty() && tag.back() == '/';
+	std::size_t i = 0;
+	while(i < tag.size() && !isSpace(tag[i]) && tag[i] != '/')
+		i++;
+	std::string_view name = tag.substr(0, i);
+
+	// Attributes
+	attributes.clear();
+	while(i < tag.size())
+	{
+		while(i < tag.size() && isSpace(tag[i]))
+			i++;
+		std::size_t nameStart = i;
+		while(i < tag.size() && tag[i] != '=' && !isSpace(tag[i]) && tag[i] != '/')
+			i++;
+		if(i == nameStart)
+		{
+			i++;
+			continue;
+		}
+		attributes.emplace_back(std::string(tag.substr(nameStart, i - nameStart)), std::string());
+		while(i < tag.size() && isSpace(tag[i]))
+			i++;
+		if(i >= tag.size() || tag[i] != '=')
+			continue;
+		i++;
+		while(i < tag.size() && isSpace(tag[i]))
+			i++;
+		std::size_t valueStart = i, valueEnd;
+		if(i < tag.size() && (tag[i] == '"' || tag[i] == '\''))
+		{
+			valueStart++;
+			valueEnd = tag.find(tag[i], valueStart);
+			if(valueEnd == std::string::npos)
+				valueEnd = tag.size();
+			i = valueEnd + 1;
+		}
+		else
+		{
+			while(i < tag.size() && !isSpace(tag[i]))
+				i++;
+			valueEnd = i;
+		}
+		appendText(attributes.back().second, tag.substr(valueStart, valueEnd - valueStart), true);
+	}
+
+	// Namespace declarations apply to the element itself and its descendants
+	std::size_t bound = 0;
+	for(const auto& attr : attributes)
+	{
+		if(attr.first == "xmlns")
+			bindings.emplace_back("", classify(attr.second));
+		else if(startsWith(attr.first, "xmlns:"))
+			bindings.emplace_back(attr.first.substr(6), classify(attr.second));
+		else
+			continue;
+		bound++;
+	}
+	std::size_t colon = name.find(':');
+	Namespace ns = resolve(colon == std::string::npos ? std::string_view() : name.substr(0, colon));
+	std::string_view local = colon == std::string::npos ? name : name.substr(colon + 1);
+	bool rss = ns == Namespace::NONE || ns == Namespace::RSS;
+	stack.push_back({std::string(name), bound});
+	std::size_t depth = stack.size();
+
+	if(depth == 1)
+	{
+		if(!(rss && local == "rss") && !(ns == Namespace::RDF && local == "RDF") && !(ns == Namespace::ATOM && local == "feed"))
+			throw std::runtime_error("Document is not an RSS or Atom feed");
+		root = true;
+		if(ns == Namespace::ATOM)
+			channelDepth = 1;
+	}
+	else if(itemDepth == 0 && ((rss && local == "item") || (ns == Namespace::ATOM && local == "entry")))
+	{
+		itemDepth = depth;
+		item.title.clear();
+		item.description.clear();
+		item.guid.clear();
+		item.enclosureUrl.clear();
+		item.pubDate.clear();
+		itemSummary.clear();
+		itemDate.clear();
+	}
+	else if(channelDepth == 0 && itemDepth == 0 && rss && local == "channel")
+		channelDepth = depth;
+	else if(!capture)
+	{
+		if(itemDepth != 0 && depth == itemDepth + 1)
+			capture = itemField(ns, local);
+		else if(itemDepth == 0 && channelDepth != 0 && depth == channelDepth + 1)
+			capture = channelField(ns, local);
+		if(capture)
+		{
+			capture->clear();
+			captureDepth = depth;
+		}
+	}
+
+	if(selfClosing)
+		popElement();
+}
+
+void FeedParser::endElement(std::string_view name)
+{
+	while(!name.empty() && isSpace(name.back()))
+		name.remove_suffix(1);
+
+	// Close everything up to the matching element, ignore the end tag if there is none
+	std::size_t i = stack.size();
+	while(i > 0 && stack[i - 1].name != name)
+		i--;
+	if(i == 0)
+		return;
+	while(stack.size() >= i)
+		popElement();
+}
+
+void FeedParser::popElement()
+{
+	std::size_t depth = stack.size();
+	if(capture && depth == captureDepth)
+	{
+		if(capture->size() > MAX_FIELD_SIZE)
+		{
+			// Cut without splitting a UTF-8 sequence
+			std::size_t length = MAX_FIELD_SIZE;
+			while(length > 0 && ((*capture)[length] & 0xC0) == 0x80)
+				length--;
+			capture->resize(length);
+		}
+		trim(*capture);
+		capture = nullptr;
+	}
+	if(depth == itemDepth)
+	{
+		itemDepth = 0;
+		if(item.description.empty())
+			item.description.swap(itemSummary);
+		if(item.pubDate.empty())
+			item.pubDate.swap(itemDate);
+		callback(item);
+	}
+	if(depth == channelDepth)
+		channelDepth = 0;
+	bindings.resize(bindings.size() - stack.back().bindings);
+	stack.pop_back();
+}
+
+std::string* FeedParser::channelField(Namespace ns, std::string_view name)
+{
+	bool rss = ns == Namespace::NONE || ns == Namespace::RSS;
+	if((rss || ns == Namespace::ATOM) && name == "title")
+		return &title;
+	if(rss && name == "description")
+		return &description;
+	if(ns == Namespace::ATOM && (name == "subtitle" || name == "tagline"))
+		return &description;
+	if(ns == Namespace::ITUNES && name == "summary")
+		return &summary;
+	return nullptr;
+}
+
+std::string* FeedParser::itemField(Namespace ns, std::string_view name)
+{
+	if(ns == Namespace::NONE || ns == Namespace::RSS)
+	{
+		if(name == "title") return &item.title;
+		if(name == "description") return &item.description;
+		if(name == "guid") return &item.guid;
+		if(name == "pubDate") return &item.pubDate;
+		if(name == "enclosure" && item.enclosureUrl.empty() && attribute("url"))
+			item.enclosureUrl = *attribute("url");
+	}
+	else if(ns == Namespace::ATOM)
+	{
+		if(name == "title") return &item.title;
+		if(name == "summary") return &item.description;
+		if(name == "content") return &itemSummary;
+		if(name == "id") return &item.guid;
+		if(name == "published" || name == "issued") return &item.pubDate;
+		if(name == "updated" || name == "modified") return &itemDate;
+		const std::string* rel = attribute("rel");
+		if(name == "link" && item.enclosureUrl.empty() && rel && *rel == "enclosure" && attribute("href"))
+			item.enclosureUrl = *attribute("href");
+	}
+	else if(ns == Namespace::ITUNES && name == "summary")
+		return &itemSummary;
+	else if(ns == Namespace::DUBLIN_CORE && name == "date")
+		return &itemDate;
+	return nullptr;
+}
+
+const std::string* FeedParser::attribute(std::string_view name) const
+{
+	for(const auto& attr : attributes)
+		if(attr.first == name)
+			return &attr.second;
+	return nullptr;
+}
+
+FeedParser::Namespace FeedParser::resolve(std::string_view prefix) const
+{
+	for(auto iter = bindings.rbegin(); iter != bindings.rend(); iter++)
+		if(iter->first == prefix)
+			return iter->second;
+
+	// Undeclared, but the meaning of these is obvious
+	if(prefix.empty()) return Namespace::NONE;
+	if(prefix == "itunes") return Namespace::ITUNES;
+	if(prefix == "dc") return Namespace::DUBLIN_CORE;
+	if(prefix == "atom") return Namespace::ATOM;
+	if(prefix == "rdf") return Namespace::RDF;
+	return Namespace::OTHER;
+}
+
+FeedParser::Namespace FeedParser::classify(std::string_view uri)
+{
+	static const char ITUNES_URI[] = "http://www.itunes.com/dtds/podcast-1.0.dtd";
+	if(uri.empty())
+		return Namespace::NONE;
+	if(uri == "http://purl.org/rss/1.0/" || uri == "http://my.netscape.com/rdf/simple/0.9/" || uri == "http://backend.userland.com/rss2")
+		return Namespace::RSS;
+	if(uri == "http://www.w3.org/2005/Atom" || uri == "http://purl.org/atom/ns#")
+		return Namespace::ATOM;
+	if(uri.size() == sizeof(ITUNES_URI) - 1 && strncasecmp(uri.data(), ITUNES_URI, uri.size()) == 0) // Some feeds capitalize it
+		return Namespace::ITUNES;
+	if(uri == "http://purl.org/dc/elements/1.1/")
+		return Namespace::DUBLIN_CORE;
+	if(uri == "http://www.w3.org/1999/02/22-rdf-syntax-ns#")
+		return Namespace::RDF;
+	return Namespace::OTHER;
+}
+
+void FeedParser::appendText(std::string& out, std::string_view text, bool decode) const
+{
+	// Text beyond the limit is dropped, popElement() cuts the field to size
+	if(out.size() > MAX_FIELD_SIZE)
+		return;
+	std::size_t pos = 0;
+	while(pos < text.size())
+	{
+		std::size_t amp = decode ? text.find('&', pos) : std::string::npos;
+		appendRaw(out, text.substr(pos, amp == std::string::npos ? std::string::npos : amp - pos));
+		if(amp == std::string::npos)
+			break;
+		std::size_t semicolon = text.find(';', amp + 1);
+		if(semicolon != std::string::npos && semicolon - amp <= 10 && decodeEntity(text.substr(amp + 1, semicolon - amp - 1), out))
+			pos = semicolon + 1;
+		else
+		{
+			out += '&'; // Unknown entities are kept as written
+			pos = amp + 1;
+		}
+	}
+}
+
+void FeedParser::appendRaw(std::string& out, std::string_view text) const
+{
+	if(!latin1)
+	{
+		out.append(text);
+		return;
+	}
+	for(char c : text)
+	{
+		unsigned char byte = c;
+		appendUtf8(out, byte >= 0x80 && byte < 0xA0 ? WINDOWS_1252[byte - 0x80] : byte);
+	}
+}
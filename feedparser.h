@@ -0,0 +1,146 @@
+/**
+ * \file feedparser.h
+ * \brief Defines the FeedParser class and the FeedItem structure
+ */
+
+#ifndef FEEDPARSER_H
+#define FEEDPARSER_H
+
+#include<string>
+#include<string_view>
+#include<vector>
+#include<utility>
+#include<functional>
+#include<cstddef>
+
+/**
+ * \brief The data of an RSS `<item>` or Atom `<entry>` that JPod uses
+ * \details Missing values are empty strings.
+ */
+struct FeedItem
+{
+	/// The title
+	std::string title;
+	/// The description (RSS), summary or content (Atom), or iTunes summary
+	std::string description;
+	/// The GUID (RSS) or id (Atom)
+	std::string guid;
+	/// URI of the enclosure (RSS) or the link with rel="enclosure" (Atom)
+	std::string enclosureUrl;
+	/// The publication date as written (pubDate, dc:date, published or updated)
+	std::string pubDate;
+};
+
+/**
+ * \brief Streaming parser for RSS and Atom feeds
+ * \details The document is passed to parse() in pieces as it arrives, and
+ * every item is handed to a callback as soon as its end tag has been read. No
+ * tree of the document is built: only the current piece of markup, the
+ * current item and the feed's title and description are kept in memory, so
+ * the memory needed does not depend on the size of the document. Text fields
+ * are truncated to MAX_FIELD_SIZE bytes.
+ *
+ * Understands RSS 0.9x and 2.0 (`<rss><channel>`), RSS 0.90 and 1.0
+ * (`<rdf:RDF>`), and Atom 0.3 and 1.0 (`<feed>`), and uses the iTunes
+ * podcast extensions (itunes:summary) and Dublin Core dates (dc:date) where
+ * the standard elements are missing. Namespaces are resolved properly; the
+ * common prefixes "itunes", "dc", "atom" and "rdf" also work when a feed
+ * forgets to declare them.
+ *
+ * The XML parser is lenient where feeds are commonly broken: unknown entities
+ * are kept as written, and end tags that do not match any open element are
+ * ignored. Documents in ISO-8859-1 or Windows-1252 are converted to UTF-8,
+ * everything else is taken as UTF-8. Like browsers do, ISO-8859-1 is read as
+ * Windows-1252, so the bytes 0x80 to 0x9F become curly quotes, dashes, the
+ * euro sign etc. rather than control characters. DTDs are skipped.
+ */
+class FeedParser
+{
+public:
+	/// Receives each item; the item is only valid during the call
+	typedef std::function<void(const FeedItem&)> ItemCallback;
+
+	/// Maximum length of a text field of the feed or an item
+	static constexpr std::size_t MAX_FIELD_SIZE = 1024 * 1024;
+	/// Maximum length of a single tag, comment, processing instruction or DTD
+	static constexpr std::size_t MAX_MARKUP_SIZE = 1024 * 1024;
+private:
+	enum class Namespace {NONE, RSS, ATOM, ITUNES, DUBLIN_CORE, RDF, OTHER};
+	enum class Mode {CONTENT, CDATA, COMMENT};
+
+	struct Element
+	{
+		std::string name;
+		std::size_t bindings;
+	};
+
+	ItemCallback callback;
+	std::string buffer;
+	Mode mode;
+	bool latin1, root;
+	std::vector<Element> stack;
+	std::vector<std::pair<std::string, Namespace>> bindings;
+	std::vector<std::pair<std::string, std::string>> attributes;
+	std::size_t channelDepth, itemDepth, captureDepth;
+	std::string* capture;
+	std::string title, description, summary;
+	FeedItem item;
+	std::string itemSummary, itemDate;
+
+	void process(bool last);
+	void processDeclaration(std::string_view declaration);
+	void startElement(std::string_view tag);
+	void endElement(std::string_view name);
+	void popElement();
+	std::string* channelField(Namespace ns, std::string_view name);
+	std::string* itemField(Namespace ns, std::string_view name);
+	const std::string* attribute(std::string_view name) const;
+	Namespace resolve(std::string_view prefix) const;
+	void appendText(std::string& out, std::string_view text, bool decode) const;
+	void appendRaw(std::string& out, std::string_view text) const;
+	static Namespace classify(std::string_view uri);
+public:
+	/**
+	 * \brief Creates a FeedParser
+	 * \param callback Called for every item in the order of the document.
+	 * Exceptions thrown by it are passed on to the caller of parse() or
+	 * finish().
+	 */
+	FeedParser(ItemCallback callback);
+
+	/**
+	 * \brief Parses the next piece of the document
+	 * \details The pieces may be split anywhere, even inside a tag or a
+	 * UTF-8 sequence.
+	 * \param data The next bytes of the document.
+	 * \param size Number of bytes.
+	 * \throws std::runtime_error If the document is not an RSS or Atom feed
+	 * or is malformed beyond repair.
+	 */
+	void parse(const char* data, std::size_t size);
+
+	/**
+	 * \brief Tells the parser that the document is complete
+	 * \throws std::runtime_error If the document is empty, not an RSS or
+	 * Atom feed, or ends prematurely.
+	 */
+	void finish();
+
+	/**
+	 * \brief Returns the title of the feed
+	 * \details Usually known before the first item, since feeds put it at the
+	 * top; after finish() in any case.
+	 * \return The title, or an empty string if it is not known (yet).
+	 */
+	const std::string& getTitle() const {return title;}
+
+	/**
+	 * \brief Returns the description of the feed
+	 * \details See getTitle().
+	 * \return The description (RSS), subtitle (Atom) or iTunes summary, or
+	 * an empty string.
+	 */
+	const std::string& getDescription() const {return description.empty() ? summary : description;}
+};
+
+#endif //FEEDPARSER_H
@@ -5,14 +5,18 @@
 
 #include"filter.h"
 
-Filter::Filter(FilterType type, std::regex regex, std::string match)
+Filter::Filter(FilterType type, const std::string& regex, const std::string& match)
 : type(type), regex(regex), match(match)
 {
 }
 
-FilterResult Filter::apply(const Episode& episode)
+FilterResult Filter::apply(const Episode& episode) const
 {
-	bool matched = regex_match(episode.fillPlaceholders(match), regex);
+	// Reuse the buffer, filters are applied to every episode of every feed
+	thread_local std::string str;
+	str.clear();
+	match.fill(episode, str);
+	bool matched = regex.match(str);
 	if((matched && type == FilterType::EXCLUDE_IF_MATCH) || (!matched && type == FilterType::EXCLUDE_IF_NOT_MATCH))
 		return FilterResult::EXCLUDE;
 	else if((matched && type == FilterType::INCLUDE_IF_MATCH) || (!matched && type == FilterType::INCLUDE_IF_NOT_MATCH))
@@ -7,8 +7,9 @@
 #define FILTER_H
 
 #include<string>
-#include<regex>
 #include"episode.h"
+#include"compiledregex.h"
+#include"placeholderpattern.h"
 
 /**
  * \brief Determines the type of a filter
@@ -41,14 +42,16 @@ enum class FilterResult
 /**
  * \brief Filters decide whether an episode is to be downloaded or ignored
  * \details A Filter consists of a regular expression that gets matched against
- * a string which is constructed from the metadata of an episode.
+ * a string which is constructed from the metadata of an episode. Both are
+ * compiled once, when the filter is created, so applying it to an episode only
+ * fills in the metadata and runs the matcher.
  */
 class Filter
 {
 private:
 	FilterType type;
-	std::regex regex;
-	std::string match;
+	CompiledRegex regex;
+	PlaceholderPattern match;
 public:
 	/**
 	 * \brief Creates a filter
@@ -60,8 +63,9 @@ public:
 	 * May contain certain placeholders that get replaced with the
 	 * corresponding metadata entries of the episode. See
 	 * Episode#fillPlaceholders() for details.
+	 * \throws std::regex_error If regex is not a valid regular expression.
 	 */
-	Filter(FilterType type, std::regex regex, std::string match);
+	Filter(FilterType type, const std::string& regex, const std::string& match);
 
 	/**
 	 * \brief Applies the filter to an episode
@@ -71,7 +75,7 @@ public:
 	 * \return Returns whether - according to this filter - the episode
 	 * should definitely be included, definitely be excluded, or neither.
 	 */
-	FilterResult apply(const Episode& episode);
+	FilterResult apply(const Episode& episode) const;
 };
 
 #endif //FILTER_H
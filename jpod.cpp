@@ -6,13 +6,28 @@
 #include<string>
 #include<vector>
 #include<iostream>
+#include<sstream>
 #include<stdexcept>
-#include<functional>
 #include<cstdlib>
-#include<nxml.h>
+#include<chrono>
+#include<thread>
+#include<algorithm>
+#include<ctime>
+#include<csignal>
+#include<memory>
+#include<filesystem>
 #include"filter.h"
 #include"episode.h"
 #include"feed.h"
+#include"downloadengine.h"
+#include"mediastore.h"
+#include"options.h"
+#include"config.h"
+#include"workerpool.h"
+#include"transfercontext.h"
+#include"metrics.h"
+#include"pollscheduler.h"
+#include"catalog.h"
 
 /**
  * \brief Print the help/usage message, then terminate
@@ -29,8 +44,35 @@ void printHelp()
 		<< "  list                   List the uids of all feeds." << std::endl
 		<< "  info UID               Show information about the given feed." << std::endl
 		<< "  episodes UID           List all the episodes (that get past the filter) of the given feed." << std::endl
-		<< "  update [UID]           Update one or all feeds and download new episodes." << std::endl
+		<< "                         Both show the feed as of its last update, the feed is only" << std::endl
+		<< "                         retrieved if it has never been updated." << std::endl
+		<< "  search WORD...         List the episodes of all feeds that contain every WORD" << std::endl
+		<< "                         (or a word beginning with it) in their title or" << std::endl
+		<< "                         description, or in the title of their feed, as of" << std::endl
+		<< "                         the last update." << std::endl
+		<< "  update [--full] [--metrics-json=FILE] [--metrics-prom=FILE] [UID]" << std::endl
+		<< "                         Update one or all feeds and download new episodes." << std::endl
 		<< "                         If no UID is given, all feeds are updated." << std::endl
+		<< "                         Normally, only items that are newer than those seen" << std::endl
+		<< "                         in the previous update are considered. With --full," << std::endl
+		<< "                         all items are checked again (e.g. after changing the" << std::endl
+		<< "                         filters or deleting episodes)." << std::endl
+		<< "                         With --metrics-json and --metrics-prom, timings and" << std::endl
+		<< "                         sizes of the feeds and downloads are written to FILE" << std::endl
+		<< "                         as JSON or for the Prometheus textfile collector." << std::endl
+		<< "  daemon [--metrics-json=FILE] [--metrics-prom=FILE]" << std::endl
+		<< "                         Keep running and update each feed on its own schedule," << std::endl
+		<< "                         depending on how often it publishes. Stops on SIGINT or" << std::endl
+		<< "                         SIGTERM. The metrics files are rewritten after every" << std::endl
+		<< "                         round of updates." << std::endl
+		<< "  reindex [UID]          Rebuild the index of downloaded episodes of one or all" << std::endl
+		<< "                         feeds from the contents of their directories." << std::endl
+		<< "  migrate [--from=PATTERN] [UID]" << std::endl
+		<< "                         Move the downloaded episodes of one or all feeds from" << std::endl
+		<< "                         the names PATTERN gives them to those of the current" << std::endl
+		<< "                         filename pattern, e.g. into subdirectories. Without" << std::endl
+		<< "                         --from, PATTERN is the current one without its '/'," << std::endl
+		<< "                         i.e. the flat names that earlier versions used." << std::endl
 		<< std::endl
 		<< "The feeds are obtained from the .jpodconf file in the current user's home" << std::endl
 		<< "directory. If this file does not exist, the program will fail. You can create" << std::endl
@@ -40,178 +82,205 @@ void printHelp()
 }
 
 /**
- * \brief Helper class for automatically freeing C-style objects when they go
- * out of scope
- * \details Used for libnxml objects.
+ * \brief Prints an episode of a catalog for the info, episodes and search
+ * commands
+ * \param episode The episode.
  */
-class Finalizer
+void printEpisode(const CatalogEpisode& episode)
 {
-private:
-	std::function<void()> finalize;
-public:
-	/**
-	 * \brief Constructs a Finalizer
-	 * \param finalize Function that is called when this instance does out of
-	 * scope.
-	 */
-	Finalizer(std::function<void()> finalize): finalize(finalize) {}
-
-	/**
-	 * \brief Destructor that calls the finalize() function.
-	 */
-	~Finalizer() {finalize();}
-};
+	std::tm date = episode.getPubDate();
+	std::cout
+		<< "Title:\t" << episode.title << std::endl
+		<< "URI:\t" << episode.uri << std::endl
+		<< "Published:\t" << std::put_time(&date, "%c") << std::endl
+		<< "Downloaded:\t" << (episode.downloaded ? "yes" : "no") << std::endl
+		<< "Description:\t" << episode.description << std::endl
+		<< std::endl;
+}
 
 /**
- * \brief Parse the configuration file and extract a list of all feeds
- * \param configFile Name of the configuration file.
- * \return List of all the feeds.
- * \throws std::runtime_error If a problem occurs while parsing the config file.
+ * \brief Searches for a feed by UID
+ * \details If the feed cannot be found, a message is written to stdout and the
+ * program terminates with exit code 1.
+ * \param config The configuration.
+ * \param uid The unique identifier string of a podcast feed.
+ * \return The Feed with the UID.
  */
-std::vector<Feed> readConfigFile(std::string configFile)
+Feed findFeed(const Config& config, std::string uid)
 {
-	std::filesystem::path homeDir(getenv("HOME"));
-
-	nxml_t* xmlData;
-	nxml_error_t rc;
+	if(!config.contains(uid))
+	{
+		std::cout << "No feed with UID \"" << uid << "\" exists. Use \"jpod list\" for a list f all UIDs." << std::endl;
+		exit(1);
+	}
+	try
+	{
+		return config.getFeed(uid);
+	}
+	catch(std::runtime_error& e) {std::cout << e.what() << std::endl; exit(1);}
+}
 
-	// Initlialize nxml library
-	rc = nxml_new(&xmlData);
-	if(rc != NXML_OK)
-		throw std::runtime_error("Error initializing libnxml.");
-	Finalizer f1([xmlData]{nxml_free(xmlData);});
+/**
+ * \brief Returns the feeds of the configuration
+ * \details If the feeds cannot be created, a message is written to stdout and
+ * the program terminates with exit code 1.
+ * \param config The configuration.
+ * \return All feeds.
+ */
+std::vector<Feed> allFeeds(const Config& config)
+{
+	try
+	{
+		return config.getFeeds();
+	}
+	catch(std::runtime_error& e) {std::cout << e.what() << std::endl; exit(1);}
+}
 
-	// Parse config file
-	rc = nxml_parse_file(xmlData, configFile.data());
-	if(rc != NXML_OK)
-		throw std::runtime_error("Error reading config file " + configFile + ": " + nxml_strerror(xmlData, rc));
+/**
+ * \brief Returns the feeds that a command applies to
+ * \details Terminates the program like findFeed() and allFeeds() if the feeds
+ * cannot be created.
+ * \param config The configuration.
+ * \param args The command line arguments. If there is a second one, it is the
+ * UID of the only feed, otherwise all feeds are returned.
+ * \return The feeds.
+ */
+std::vector<Feed> selectFeeds(const Config& config, const std::vector<std::string>& args)
+{
+	if(args.size() < 2)
+		return allFeeds(config);
+	std::vector<Feed> feedList;
+	feedList.push_back(findFeed(config, args[1]));
+	return feedList;
+}
 
-	// Get <podlist>...</podlist> root element
-	nxml_data_t* xmlPodlist;
-	nxml_root_element(xmlData, &xmlPodlist);
-	if(xmlPodlist->type != NXML_TYPE_ELEMENT || std::string(xmlPodlist->value) != "podlist")
-		throw std::runtime_error("Invalid config file. Root node is not <podlist>...</podlist>");
+/**
+ * \brief Returns where the snapshot of the configuration file is kept
+ * \return $XDG_CACHE_HOME/jpod/config.snapshot, or ~/.cache/jpod/config.snapshot
+ * if XDG_CACHE_HOME is not set.
+ */
+std::filesystem::path snapshotFile()
+{
+	if(getenv("XDG_CACHE_HOME") && std::string(getenv("XDG_CACHE_HOME")) != "")
+		return std::filesystem::path(getenv("XDG_CACHE_HOME")) / "jpod" / "config.snapshot";
+	return std::filesystem::path(getenv("HOME")) / ".cache" / "jpod" / "config.snapshot";
+}
 
-	// Go through <feed>...</feed> elements
-	std::vector<Feed> feedList;
-	nxml_data_t* xmlFeed = xmlPodlist->children;
-	while(xmlFeed)
+/**
+ * \brief Updates feeds and downloads their new episodes
+ * \details The feeds are retrieved and parsed in parallel, then the new
+ * episodes of all of them are downloaded concurrently. Problems with a single
+ * feed or episode are written to stderr in the order of the feeds.
+ * \param feeds The feeds to update.
+ * \param options Global settings.
+ * \param incremental See Feed#update().
+ * \param syncSeconds Receives the time spent flushing the downloads to disk.
+ * \return For each feed, whether its update failed.
+ * \throws std::runtime_error If the downloads could not be performed at all.
+ */
+std::vector<char> updateFeeds(const std::vector<Feed*>& feeds, const Options& options, bool incremental, double& syncSeconds)
+{
+	DownloadEngine engine(options.maxDownloads, options.maxDownloadsPerHost, (std::uint64_t)options.maxRate * 1024, options.sync);
+	engine.setSegmentation(options.segments, (std::uint64_t)options.segmentThreshold * 1024 * 1024);
+	std::unique_ptr<MediaStore> store;
+	if(!options.mediaStore.empty())
 	{
-		if(xmlFeed->type != NXML_TYPE_COMMENT)
-		{
-			if(xmlFeed->type != NXML_TYPE_ELEMENT || std::string(xmlFeed->value) != "feed")
-				throw std::runtime_error("Invalid config file. Podlist contains something other than <feed>...</feed>");
-
-			// Get the uid attribute
-			nxml_attr_t* xmlUid;
-			rc = nxml_find_attribute(xmlFeed, std::string("uid").data(), &xmlUid);
-			if(rc != NXML_OK || xmlUid == NULL)
-				throw std::runtime_error("Invalid feed in config file. Attribute uid is missing.");
-			std::string uid(xmlUid->value);
-			if(uid.empty() || uid.find_first_of(" \t\r\n") != std::string::npos)
-				throw std::runtime_error("Invalid feed in config file. Attribute uid must not be empty or contain whitespaces.");
-
-			// Get the uri attribute
-			nxml_attr_t* xmlUri;
-			rc = nxml_find_attribute(xmlFeed, std::string("uri").data(), &xmlUri);
-			if(rc != NXML_OK || xmlUri == NULL)
-				throw std::runtime_error("Invalid feed in config file. Attribute uri is missing in the feed with uid \"" + uid + "\".");
-			std::string uri(xmlUri->value);
-			if(uri.empty())
-				throw std::runtime_error("Invalid feed in config file. Attribute uri is empty in the feed with uid \"" + uid + "\".");
-
-			// Get the basedir
-			nxml_attr_t* xmlBasedir;
-			rc = nxml_find_attribute(xmlFeed, std::string("basedir").data(), &xmlBasedir);
-			if(rc != NXML_OK || xmlBasedir == NULL)
-				throw std::runtime_error("Invalid feed in config file. Attribute basedir is missing in the feed with uid \"" + uid + "\".");
-			std::string basedir(xmlBasedir->value);
-
-			// Get the filename pattern
-			nxml_attr_t* xmlFilename;
-			rc = nxml_find_attribute(xmlFeed, std::string("filename").data(), &xmlFilename);
-			std::string filename = "%Y-%m-%d_%T";
-			if(rc == NXML_OK && xmlFilename != NULL)
-			{
-				filename = xmlFilename->value;
-				if(filename.empty())
-					throw std::runtime_error("Invalid feed in config file. Attribute filename is invalid in the feed with uid \"" + uid + "\".");
-			}
+		store = std::make_unique<MediaStore>(options.mediaStore);
+		engine.setMediaStore(store.get());
+	}
 
-			// Get the filters
-			std::vector<Filter> filterList;
-			nxml_data_t* xmlFilter = xmlFeed->children;
-			while(xmlFilter)
+	// Messages are collected per feed and printed in the order of the feeds
+	std::vector<std::ostringstream> logs(feeds.size());
+	std::vector<char> failed(feeds.size(), false);
+
+	// Update all feeds in parallel
+	{
+		WorkerPool pool(options.updateThreads);
+		for(std::size_t i = 0; i < feeds.size(); i++)
+			pool.submit([&feeds, &logs, &failed, incremental, i]
 			{
-				if(xmlFilter->type != NXML_TYPE_COMMENT)
+				try
 				{
-					if(xmlFilter->type != NXML_TYPE_ELEMENT || std::string(xmlFilter->value) != "filter")
-						throw std::runtime_error("Invalid config file. <feed>...</feed> contains something other than <filter ... />");
-
-					// Get the type attribute
-					nxml_attr_t* xmlType;
-					rc = nxml_find_attribute(xmlFilter, std::string("type").data(), &xmlType);
-					if(rc != NXML_OK || xmlType == NULL)
-						throw std::runtime_error("Invalid filter in feed with uid \"" + uid + "\". Attribute type is missing.");
-					std::string strType(xmlType->value);
-					FilterType type;
-					if(strType == "include-if-match")
-						type = FilterType::INCLUDE_IF_MATCH;
-					else if(strType == "include-if-not-match")
-						type = FilterType::INCLUDE_IF_NOT_MATCH;
-					else if(strType == "exclude-if-match")
-						type = FilterType::EXCLUDE_IF_MATCH;
-					else if(strType == "exclude-if-not-match")
-						type = FilterType::EXCLUDE_IF_NOT_MATCH;
-					else
-						throw std::runtime_error("Invalid filter in feed with uid \"" + uid + "\". Attribute type must be one of \"include-if-match\", \"include-if-not-match\", \"exclude-if-match\", \"exclude-if-not-match\".");
-
-					// Get the regex attribute
-					nxml_attr_t* xmlRegex;
-					rc = nxml_find_attribute(xmlFilter, std::string("regex").data(), &xmlRegex);
-					if(rc != NXML_OK || xmlRegex == NULL)
-						throw std::runtime_error("Invalid filter in feed with uid \"" + uid + "\". Attribute regex is missing.");
-					std::regex regex;
-					try {regex = xmlRegex->value;}
-					catch(std::regex_error& e) {throw std::runtime_error("Invalid filter in feed with uid \"" + uid + "\". Attribute regex is not a valid regular expression: " + e.what());}
-
-					// Get the match attribute
-					nxml_attr_t* xmlMatch;
-					rc = nxml_find_attribute(xmlFilter, std::string("match").data(), &xmlMatch);
-					if(rc != NXML_OK || xmlMatch == NULL)
-						throw std::runtime_error("Invalid filter in feed with uid \"" + uid + "\". Attribute match is missing.");
-					std::string match(xmlMatch->value);
-						
-					// Add filter to list
-					filterList.push_back(Filter(type, regex, match));
+					feeds[i]->update(incremental);
 				}
-				xmlFilter = xmlFilter->next;
-			}
+				catch(std::runtime_error& e)
+				{
+					// If one fails, continue with the others
+					failed[i] = true;
+					logs[i] << "A problem ocurred when updating the feed with UID \"" << feeds[i]->getUid() << "\": " << e.what() << std::endl;
+				}
+			});
+	}
 
-			// Add Feed to list
-			feedList.push_back(Feed(uid, uri, homeDir / basedir, filename, filterList));
+	// Queue new episodes of all feeds for download
+	for(std::size_t i = 0; i < feeds.size(); i++)
+	{
+		if(failed[i])
+			continue;
+		try
+		{
+			feeds[i]->download(engine, logs[i]);
+		}
+		catch(std::runtime_error& e)
+		{
+			logs[i] << "A problem ocurred when updating the feed with UID \"" << feeds[i]->getUid() << "\": " << e.what() << std::endl;
 		}
-		xmlFeed = xmlFeed->next;
 	}
 
-	return feedList;
+	// Download new episodes of all feeds concurrently
+	engine.run();
+	syncSeconds = engine.getSyncSeconds();
+
+	// The next run skips the hosts that are down right away
+	try
+	{
+		if(TransferContext::get().getCircuitBreaker())
+			TransferContext::get().getCircuitBreaker()->save();
+	}
+	catch(std::runtime_error& e)
+	{
+		std::cerr << e.what() << std::endl;
+	}
+
+	for(std::ostringstream& log : logs)
+		std::cerr << log.str();
+	return failed;
 }
 
 /**
- * \brief Searches for a feed by UID
- * \details If the feed cannot be found, a message is written to stderr and the
- * program terminates with exit code 1.
- * \param feedList List of all the feeds (obtained from readConfigFile()).
- * \param uid The unique identifier string of a podcast feed.
- * \return The Feed with the UID from feedList.
+ * \brief Writes the metrics of the feeds' last updates
+ * \param feedList The feeds to report on.
+ * \param duration Duration of the run in seconds.
+ * \param syncSeconds Time spent flushing the downloads to disk in seconds.
+ * \param jsonFile File that receives the metrics as JSON, or empty.
+ * \param prometheusFile File that receives the metrics in Prometheus text
+ * format, or empty.
+ * \throws std::runtime_error If a file could not be written.
+ */
+void writeMetrics(const std::vector<Feed>& feedList, double duration, double syncSeconds, const std::string& jsonFile, const std::string& prometheusFile)
+{
+	Metrics metrics;
+	for(const Feed& feed : feedList)
+		metrics.addFeed(feed.getUid(), feed.getMetrics());
+	metrics.setDuration(duration);
+	metrics.setSyncDuration(syncSeconds);
+	if(TransferContext::get().getCircuitBreaker())
+		metrics.setUnavailableHosts(TransferContext::get().getCircuitBreaker()->countOpen(std::time(NULL)));
+	if(!jsonFile.empty())
+		metrics.writeJson(jsonFile);
+	if(!prometheusFile.empty())
+		metrics.writePrometheus(prometheusFile);
+}
+
+/// Set by stopDaemon() to end the daemon after the current round
+static volatile std::sig_atomic_t stopRequested = 0;
+
+/**
+ * \brief Signal handler that asks the daemon to stop
  */
-Feed findFeed(std::vector<Feed> feedList, std::string uid)
+void stopDaemon(int)
 {
-	for(Feed feed : feedList)
-		if(feed.getUid() == uid)
-			return feed;
-	std::cout << "No feed with UID \"" << uid << "\" exists. Use \"jpod list\" for a list f all UIDs." << std::endl;
-	exit(1);
+	stopRequested = 1;
 }
 
 /**
@@ -231,19 +300,55 @@ int main(int argc, char** argv)
 	if(args.size() == 0 || args[0] == "help" || args[0] == "--help" || args[0] == "-h")
 		printHelp();
 
-	// Read the feed list from the configuration file
-	std::vector<Feed> feedList;
+	// Extract flags
+	bool full = false;
+	std::string metricsJson, metricsProm, fromPattern;
+	for(auto iter = args.begin() + 1; iter != args.end();)
+	{
+		if(*iter == "--full")
+			full = true;
+		else if(iter->compare(0, 15, "--metrics-json=") == 0)
+			metricsJson = iter->substr(15);
+		else if(iter->compare(0, 15, "--metrics-prom=") == 0)
+			metricsProm = iter->substr(15);
+		else if(iter->compare(0, 7, "--from=") == 0)
+			fromPattern = iter->substr(7);
+		else
+		{
+			iter++;
+			continue;
+		}
+		iter = args.erase(iter);
+	}
+
+	// Set up CURL before any threads are started
 	try
 	{
-		feedList = readConfigFile(std::string(getenv("HOME")) + "/.jpodconf");
+		TransferContext::get();
 	}
 	catch(std::runtime_error& e) {std::cout << e.what() << std::endl; exit(1);}
 
+	// Read the configuration file (or its snapshot), feeds are only created when needed
+	std::shared_ptr<Config> config;
+	try
+	{
+		config = std::make_shared<Config>(std::string(getenv("HOME")) + "/.jpodconf", snapshotFile());
+	}
+	catch(std::runtime_error& e) {std::cout << e.what() << std::endl; exit(1);}
+	const Options& options = config->getOptions();
+
+	// Every transfer is bounded in time, and hosts that failed in earlier runs are remembered
+	TransferContext& transferContext = TransferContext::get();
+	transferContext.setTimeouts(options.connectTimeout, options.stallTimeout, options.feedTimeout, options.downloadTimeout);
+	transferContext.getRetryPolicy().configure(options.retries, options.retryDelay);
+	CircuitBreaker breaker(options.dataDir / "hosts", options.breakerThreshold, options.breakerCooldown * 60);
+	transferContext.setCircuitBreaker(&breaker);
+
 	// List all uids
 	if(args[0] == "list")
 	{
-		for(Feed f : feedList)
-			std::cout << f.getUid() << " ";
+		for(const std::string& uid : config->getUids())
+			std::cout << uid << " ";
 		std::cout << std::endl;
 		exit(0);
 	}
@@ -259,54 +364,190 @@ int main(int argc, char** argv)
 		}
 
 		// Find feed
-		Feed feed = findFeed(feedList, args[1]);
-		// Update feed
-		feed.update();
+		Feed feed = findFeed(*config, args[1]);
+		// The catalog of the last update answers without going online, the feed is only retrieved if there is none
+		std::unique_ptr<Catalog> catalog = std::make_unique<Catalog>(feed.getCatalogPath());
+		if(!catalog->isValid())
+		{
+			try
+			{
+				feed.update();
+				feed.updateCatalog();
+			}
+			catch(std::runtime_error& e)
+			{
+				std::cerr << e.what() << std::endl;
+				exit(1);
+			}
+			catalog = std::make_unique<Catalog>(feed.getCatalogPath());
+		}
 
 		// Show requested information
 		if(args[0] == "info")
+		{
+			std::time_t updateTime = catalog->getUpdateTime();
 			std::cout
 				<< "UID:\t" << feed.getUid() << std::endl
 				<< "URI:\t" << feed.getUri() << std::endl
 				<< "Download directory:\t" << feed.getBasePath().string() << std::endl
 				<< "Filename pattern:\t" << feed.getFilenamePattern() << std::endl
-				<< "Title:\t" << feed.getTitle() << std::endl
-				<< "Description:\t" << feed.getDescription() << std::endl;
+				<< "Title:\t" << catalog->getTitle() << std::endl
+				<< "Description:\t" << catalog->getDescription() << std::endl
+				<< "Episodes:\t" << catalog->size() << std::endl
+				<< "Last update:\t" << std::put_time(std::localtime(&updateTime), "%c") << std::endl;
+		}
 		else
-			for(Episode ep : feed.getEpisodes())
-				std::cout
-					<< "Title:\t" << ep.getTitle() << std::endl
-					<< "URI:\t" << ep.getUri() << std::endl
-					<< "Published:\t" << std::put_time(ep.getPubDate(), "%c") << std::endl
-					<< "Description:\t" << ep.getDescription() << std::endl
-					<< std::endl;
+			for(std::size_t i = 0; i < catalog->size(); i++)
+				printEpisode(catalog->getEpisode(i));
+		exit(0);
+	}
+
+	// Search the episodes of all feeds
+	if(args[0] == "search")
+	{
+		if(args.size() < 2)
+		{
+			std::cout << "Missing words to search for. Use \"jpod help\" for more information." << std::endl;
+			exit(1);
+		}
+		std::string query;
+		for(std::size_t i = 1; i < args.size(); i++)
+			query += args[i] + " ";
+
+		// Only the catalogs are needed, not the feeds. They stay open while the hits are printed, newest first
+		std::vector<std::pair<std::string, std::filesystem::path>> statePaths;
+		try
+		{
+			statePaths = config->getStatePaths();
+		}
+		catch(std::runtime_error& e) {std::cout << e.what() << std::endl; exit(1);}
+		std::vector<std::unique_ptr<Catalog>> catalogs;
+		std::vector<std::pair<const std::string*, CatalogEpisode>> hits;
+		for(const auto& feed : statePaths)
+		{
+			catalogs.push_back(std::make_unique<Catalog>(Feed::getCatalogPath(feed.second)));
+			for(std::size_t i : catalogs.back()->search(query))
+				hits.emplace_back(&feed.first, catalogs.back()->getEpisode(i));
+		}
+		std::stable_sort(hits.begin(), hits.end(), [](const auto& a, const auto& b) {return a.second.pubTime > b.second.pubTime;});
+		for(const auto& hit : hits)
+		{
+			std::cout << "Feed:\t" << *hit.first << std::endl;
+			printEpisode(hit.second);
+		}
 		exit(0);
 	}
 
 	// Download missing episodes
 	if(args[0] == "update")
 	{
-		// Only feeds that should be updated remain in feedList
-		if(args.size() >= 2)
+		// Only create the feeds that should be updated
+		std::vector<Feed> feedList = selectFeeds(*config, args);
+
+		auto start = std::chrono::steady_clock::now();
+		try
+		{
+			std::vector<Feed*> feeds;
+			for(Feed& feed : feedList)
+				feeds.push_back(&feed);
+			double syncSeconds;
+			updateFeeds(feeds, options, !full, syncSeconds);
+
+			// Report how the run went
+			writeMetrics(feedList, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), syncSeconds, metricsJson, metricsProm);
+		}
+		catch(std::runtime_error& e)
+		{
+			std::cerr << e.what() << std::endl;
+			exit(1);
+		}
+		exit(0);
+	}
+
+	// Keep polling the feeds
+	if(args[0] == "daemon")
+	{
+		std::signal(SIGINT, stopDaemon);
+		std::signal(SIGTERM, stopDaemon);
+
+		// Every feed is polled on its own schedule, all that are due are updated together
+		std::vector<Feed> feedList = allFeeds(*config);
+		PollScheduler scheduler(feedList.size(), options.minPollInterval * 60, options.maxPollInterval * 60, std::time(NULL));
+		while(!stopRequested)
+		{
+			std::time_t now = std::time(NULL);
+			std::vector<std::size_t> due = scheduler.due(now);
+			if(due.empty())
+			{
+				// Wake up regularly to notice signals
+				std::this_thread::sleep_for(std::chrono::seconds(std::min<std::time_t>(scheduler.getNext() - now, 1)));
+				continue;
+			}
+
+			auto start = std::chrono::steady_clock::now();
+			std::vector<Feed*> feeds;
+			for(std::size_t i : due)
+				feeds.push_back(&feedList[i]);
+			std::vector<char> failed(feeds.size(), true);
+			double syncSeconds = 0;
+			try
+			{
+				failed = updateFeeds(feeds, options, true, syncSeconds);
+			}
+			catch(std::runtime_error& e) {std::cerr << e.what() << std::endl;}
+
+			now = std::time(NULL);
+			for(std::size_t i = 0; i < due.size(); i++)
+			{
+				if(failed[i])
+					scheduler.failed(due[i], now);
+				else
+					scheduler.polled(due[i], now, feeds[i]->getItemTimes(), feeds[i]->getMaxAge());
+			}
+
+			// Feeds that were not due keep the metrics of their last update
+			try
+			{
+				writeMetrics(feedList, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), syncSeconds, metricsJson, metricsProm);
+			}
+			catch(std::runtime_error& e) {std::cerr << e.what() << std::endl;}
+		}
+		exit(0);
+	}
+
+	// Rebuild the index of downloaded episodes
+	if(args[0] == "reindex")
+	{
+		std::vector<Feed> feedList = selectFeeds(*config, args);
+		for(Feed& feed : feedList)
 		{
-			Feed feed = findFeed(feedList, args[1]);
-			feedList = std::vector<Feed>(1, feed);
+			try
+			{
+				feed.reindex();
+			}
+			catch(std::runtime_error& e)
+			{
+				std::cerr << "A problem ocurred when reindexing the feed with UID \"" << feed.getUid() << "\": " << e.what() << std::endl;
+			}
 		}
+		exit(0);
+	}
 
-		// Go over feeds
-		for(Feed feed : feedList)
+	// Move downloaded episodes to the names of the current filename pattern
+	if(args[0] == "migrate")
+	{
+		std::vector<Feed> feedList = selectFeeds(*config, args);
+		for(Feed& feed : feedList)
 		{
 			try
 			{
-				// Update feed
 				feed.update();
-				// Download new episodes
-				feed.download();
+				unsigned moved = feed.migrate(fromPattern, std::cerr);
+				std::cout << feed.getUid() << ": " << moved << " file(s) moved" << std::endl;
 			}
 			catch(std::runtime_error& e)
 			{
-				// If one fails, continue with the next one
-				std::cerr << "A problem ocurred when updating the feed with UID \"" << feed.getUid() << "\": " << e.what() << std::endl;
+				std::cerr << "A problem ocurred when migrating the feed with UID \"" << feed.getUid() << "\": " << e.what() << std::endl;
 			}
 		}
 		exit(0);
@@ -0,0 +1,222 @@
+/**
+ * \file mediastore.cpp
+ * \brief Implementation for mediastore.h
+ */
+
+#include<stdexcept>
+#include<fstream>
+#include<cerrno>
+#include<cstdio>
+#include<cstdlib>
+#include<fcntl.h>
+#include<unistd.h>
+#include<sys/ioctl.h>
+#include<linux/fs.h>
+#include"mediastore.h"
+
+/// Computes the 64 bit FNV-1a hash of a string
+static std::uint64_t fnv1a(const std::string& str)
+{
+	std::uint64_t hash = 14695981039346656037ULL;
+	for(char c : str)
+		hash = (hash ^ (unsigned char)c) * 1099511628211ULL;
+	return hash;
+}
+
+/// Copies the rest of one file to another, within the kernel if possible
+static bool copyContents(int in, int out)
+{
+	// copy_file_range() is not available everywhere and did not work across file systems before Linux 5.3
+	while(true)
+	{
+		ssize_t copied = copy_file_range(in, NULL, out, NULL, 1 << 30, 0);
+		if(copied == 0)
+			return true;
+		if(copied < 0 && errno != EINTR)
+		{
+			if(errno != EXDEV && errno != ENOSYS && errno != EINVAL && errno != EOPNOTSUPP)
+				return false;
+			break;
+		}
+	}
+	char buffer[64 * 1024];
+	while(true)
+	{
+		ssize_t length = read(in, buffer, sizeof(buffer));
+		if(length == 0)
+			return true;
+		if(length < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			return false;
+		}
+		for(ssize_t written = 0; written < length;)
+		{
+			ssize_t result = write(out, buffer + written, length - written);
+			if(result < 0 && errno != EINTR)
+				return false;
+			if(result > 0)
+				written += result;
+		}
+	}
+}
+
+MediaStore::MediaStore(std::filesystem::path directory)
+: directory(directory)
+{
+}
+
+std::filesystem::path MediaStore::pathOf(const std::string& uri) const
+{
+	char name[17];
+	std::snprintf(name, sizeof(name), "%016llx", (unsigned long long)fnv1a(uri));
+	return directory / name;
+}
+
+bool MediaStore::lookup(const std::string& uri, Entry& entry) const
+{
+	std::filesystem::path base = pathOf(uri);
+	entry = Entry();
+	std::ifstream ifs(base.string() + ".meta");
+	std::string line;
+	while(std::getline(ifs, line))
+	{
+		std::size_t pos = line.find('=');
+		if(pos == std::string::npos)
+			continue;
+		std::string key = line.substr(0, pos), value = line.substr(pos + 1);
+		if(key == "uri") entry.uri = value;
+		else if(key == "etag") entry.etag = value;
+		else if(key == "last-modified") entry.lastModified = value;
+		else if(key == "extension") entry.extension = value;
+		else if(key == "size") entry.size = std::strtoull(value.c_str(), NULL, 10);
+		else if(key == "verified") entry.verified = std::strtoll(value.c_str(), NULL, 10);
+	}
+
+	// Different URIs may share a hash, and the data may be in the middle of being replaced
+	if(entry.uri != uri)
+		return false;
+	entry.data = base.string() + ".data";
+	std::error_code ec;
+	std::uint64_t size = std::filesystem::file_size(entry.data, ec);
+	return !ec && size == entry.size;
+}
+
+bool MediaStore::isFresh(const Entry& entry)
+{
+	if(entry.etag.empty() && entry.lastModified.empty())
+		return true;
+	std::time_t now = std::time(NULL);
+	return entry.verified <= now && now - entry.verified < FRESH_SECONDS;
+}
+
+void MediaStore::verified(Entry entry) const
+{
+	entry.verified = std::time(NULL);
+	try
+	{
+		writeMeta(entry);
+	}
+	catch(std::runtime_error& e) {} // The store is only an optimization
+}
+
+std::filesystem::path MediaStore::retrieve(const Entry& entry, const std::filesystem::path& filename) const
+{
+	std::filesystem::path target = filename;
+	target += entry.extension;
+	place(entry.data, target);
+	return target;
+}
+
+void MediaStore::add(const std::string& uri, const std::filesystem::path& file, const std::string& extension, const std::string& etag, const std::string& lastModified) const
+{
+	try
+	{
+		std::error_code ec;
+		std::filesystem::create_directories(directory, ec);
+		Entry entry;
+		entry.uri = uri;
+		entry.etag = etag;
+		entry.lastModified = lastModified;
+		entry.extension = extension;
+		entry.size = std::filesystem::file_size(file);
+		entry.verified = std::time(NULL);
+		entry.data = pathOf(uri).string() + ".data";
+		place(file, entry.data);
+
+		// Others sharing the store need to be able to read it
+		std::filesystem::permissions(entry.data, std::filesystem::perms::owner_read | std::filesystem::perms::group_read | std::filesystem::perms::others_read, std::filesystem::perm_options::add, ec);
+		writeMeta(entry);
+	}
+	catch(std::exception& e) {} // The store is only an optimization
+}
+
+void MediaStore::writeMeta(const Entry& entry) const
+{
+	// Written under a name of its own and renamed, so readers never see half of it
+	std::filesystem::path metaPath = entry.data;
+	metaPath.replace_extension(".meta");
+	std::filesystem::path tempPath = metaPath.string() + "." + std::to_string(getpid());
+	std::ofstream ofs(tempPath, std::ios::trunc);
+	ofs
+		<< "uri=" << entry.uri << std::endl
+		<< "etag=" << entry.etag << std::endl
+		<< "last-modified=" << entry.lastModified << std::endl
+		<< "extension=" << entry.extension << std::endl
+		<< "size=" << entry.size << std::endl
+		<< "verified=" << entry.verified << std::endl;
+	ofs.close();
+	std::error_code ec;
+	if(!ofs.fail())
+		std::filesystem::rename(tempPath, metaPath, ec);
+	if(ofs.fail() || ec)
+	{
+		std::filesystem::remove(tempPath, ec);
+		throw std::runtime_error("Unable to write media store metadata to \"" + metaPath.string() + "\".");
+	}
+}
+
+MediaStore::Method MediaStore::place(const std::filesystem::path& source, const std::filesystem::path& target)
+{
+	std::filesystem::path tempPath = target.parent_path() / ".partial" / (target.filename().string() + "." + std::to_string(getpid()) + ".store");
+	std::error_code ec;
+	std::filesystem::create_directories(tempPath.parent_path(), ec);
+	std::filesystem::remove(tempPath, ec);
+
+	int in = open(source.c_str(), O_RDONLY | O_CLOEXEC);
+	if(in < 0)
+		throw std::runtime_error("Unable to read \"" + source.string() + "\".");
+	Method method = Method::REFLINK;
+	bool success = true;
+	int out = open(tempPath.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+	if(out < 0 || ioctl(out, FICLONE, in) != 0)
+	{
+		if(out >= 0)
+		{
+			close(out);
+			unlink(tempPath.c_str());
+			out = -1;
+		}
+		if(link(source.c_str(), tempPath.c_str()) == 0)
+			method = Method::HARDLINK;
+		else
+		{
+			method = Method::COPY;
+			out = open(tempPath.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+			success = out >= 0 && copyContents(in, out);
+		}
+	}
+	close(in);
+	if(out >= 0 && close(out) != 0)
+		success = false;
+
+	// A hard link onto the same file leaves the temporary name in place, so it is removed either way
+	if(success)
+		std::filesystem::rename(tempPath, target, ec);
+	std::error_code removeEc;
+	std::filesystem::remove(tempPath, removeEc);
+	if(!success || ec)
+		throw std::runtime_error("Unable to store \"" + target.string() + "\".");
+	return method;
+}
@@ -0,0 +1,143 @@
+/**
+ * \file mediastore.h
+ * \brief Defines the MediaStore class
+ */
+
+#ifndef MEDIASTORE_H
+#define MEDIASTORE_H
+
+#include<string>
+#include<cstdint>
+#include<ctime>
+#include<filesystem>
+
+/**
+ * \brief A store of downloaded episode files that feeds and users share
+ * \details Every downloaded episode is added to the store, keyed by its
+ * enclosure URI and described by the validators (ETag, Last-Modified) the
+ * server sent with it. When the same URI is to be downloaded again, by another
+ * feed or by another user whose configuration names the same store, the file
+ * is placed into the feed's directory from the store instead.
+ *
+ * An entry that was verified recently, or whose server sent no validators, is
+ * used without asking the server. Otherwise the download is made conditional
+ * on the entry's validators and the server's 304 Not Modified answer confirms
+ * it, so no body is transferred.
+ *
+ * Files are placed by the cheapest means the file system offers: a reflink
+ * (copy-on-write clone, FICLONE), which shares the data but not later
+ * changes; a hard link, which shares the file itself (so files in the feed
+ * directories should not be edited in place); or a copy made by
+ * copy_file_range(), which stays within the kernel. Hard links to another
+ * user's files are usually forbidden (fs.protected_hardlinks), so between
+ * users it comes down to reflinks or copies.
+ *
+ * In the store's directory, each entry consists of a data file
+ * (`<hash>.data`) and a metadata file (`<hash>.meta`), where the hash is that
+ * of the URI. Both are replaced atomically, so several processes may use the
+ * store at the same time. For several users to share it, the directory must
+ * be writable by all of them (e.g. group-writable with the setgid bit set).
+ */
+class MediaStore
+{
+public:
+	/**
+	 * \brief The description of a stored file
+	 */
+	struct Entry
+	{
+		/// The URI the file was downloaded from
+		std::string uri;
+		/// The ETag sent with the file (may be empty)
+		std::string etag;
+		/// The Last-Modified date sent with the file (may be empty)
+		std::string lastModified;
+		/// The extension of the file, including the dot (may be empty)
+		std::string extension;
+		/// The size of the file in bytes
+		std::uint64_t size = 0;
+		/// When the server last confirmed the file
+		std::time_t verified = 0;
+		/// The name of the data file in the store
+		std::filesystem::path data;
+	};
+
+	/// How a file was placed, see place()
+	enum class Method {REFLINK, HARDLINK, COPY};
+
+	/// How long an entry is used without asking the server, in seconds
+	static constexpr std::time_t FRESH_SECONDS = 3600;
+private:
+	std::filesystem::path directory;
+
+	std::filesystem::path pathOf(const std::string& uri) const;
+	void writeMeta(const Entry& entry) const;
+public:
+	/**
+	 * \brief Creates a MediaStore
+	 * \param directory The directory of the store. It is created when the
+	 * first file is added.
+	 */
+	MediaStore(std::filesystem::path directory);
+
+	/**
+	 * \brief Looks up the stored file of a URI
+	 * \param uri The URI of the episode.
+	 * \param entry Receives the description of the stored file.
+	 * \return True if a complete file for the URI is stored.
+	 */
+	bool lookup(const std::string& uri, Entry& entry) const;
+
+	/**
+	 * \brief Returns whether an entry can be used without asking the server
+	 * \param entry An entry returned by lookup().
+	 * \return True if the entry has no validators or was verified less than
+	 * FRESH_SECONDS ago.
+	 */
+	static bool isFresh(const Entry& entry);
+
+	/**
+	 * \brief Records that the server confirmed an entry
+	 * \details Errors are ignored, the store is only an optimization.
+	 * \param entry An entry returned by lookup().
+	 */
+	void verified(Entry entry) const;
+
+	/**
+	 * \brief Places a stored file into a feed's directory
+	 * \param entry An entry returned by lookup().
+	 * \param filename The name (including path, excluding extension) of the
+	 * file to create. The extension of the stored file is appended.
+	 * \return The final name (including path and extension) of the file.
+	 * \throws std::runtime_error If the file could not be placed.
+	 */
+	std::filesystem::path retrieve(const Entry& entry, const std::filesystem::path& filename) const;
+
+	/**
+	 * \brief Adds a downloaded file to the store
+	 * \details An existing entry for the URI is replaced. Errors are ignored,
+	 * the store is only an optimization.
+	 * \param uri The URI the file was downloaded from.
+	 * \param file The downloaded file.
+	 * \param extension The extension of the file, including the dot (may be
+	 * empty).
+	 * \param etag The ETag sent with the file (may be empty).
+	 * \param lastModified The Last-Modified date sent with the file (may be
+	 * empty).
+	 */
+	void add(const std::string& uri, const std::filesystem::path& file, const std::string& extension, const std::string& etag, const std::string& lastModified) const;
+
+	/**
+	 * \brief Creates a file with the same contents as another one
+	 * \details Tries a reflink first, then a hard link, and copies the file if
+	 * neither is possible. The target is created under a temporary name and
+	 * renamed once it is complete, replacing an existing file.
+	 * \param source The existing file.
+	 * \param target The file to create.
+	 * \return How the file was created.
+	 * \throws std::runtime_error If the file could not be created.
+	 */
+	static Method place(const std::filesystem::path& source, const std::filesystem::path& target);
+};
+
+#endif //MEDIASTORE_H
@@ -0,0 +1,250 @@
+/**
+ * \file metrics.cpp
+ * \brief Implementation for metrics.h
+ */
+
+#include<stdexcept>
+#include<sstream>
+#include<fstream>
+#include<iomanip>
+#include<filesystem>
+#include<ctime>
+#include<cstdio>
+#include"metrics.h"
+
+/// Quotes a string for JSON
+static std::string jsonString(const std::string& str)
+{
+	std::string result = "\"";
+	for(char c : str)
+	{
+		if(c == '"' || c == '\\')
+			(result += '\\') += c;
+		else if(c == '\n')
+			result += "\\n";
+		else if((unsigned char)c < 0x20)
+		{
+			char buffer[8];
+			std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+			result += buffer;
+		}
+		else
+			result += c;
+	}
+	return result + "\"";
+}
+
+/// Escapes the value of a Prometheus label
+static std::string labelValue(const std::string& str)
+{
+	std::string result;
+	for(char c : str)
+	{
+		if(c == '"' || c == '\\')
+			(result += '\\') += c;
+		else if(c == '\n')
+			result += "\\n";
+		else
+			result += c;
+	}
+	return result;
+}
+
+Metrics::Metrics()
+: seconds(0), syncSeconds(0), unavailableHosts(0)
+{
+}
+
+void Metrics::addFeed(const std::string& uid, const FeedMetrics& metrics)
+{
+	feeds.push_back({uid, metrics});
+}
+
+void Metrics::writeFile(const std::string& filename, const std::string& content)
+{
+	// Write to a temporary file first, so readers never see a half-written file
+	std::string temporary = filename + ".new";
+	std::ofstream ofs(temporary, std::ios::trunc);
+	ofs << content;
+	ofs.close();
+	if(ofs.fail())
+		throw std::runtime_error("Unable to write metrics to \"" + temporary + "\"");
+	std::error_code ec;
+	std::filesystem::rename(temporary, filename, ec);
+	if(ec)
+		throw std::runtime_error("Unable to write metrics to \"" + filename + "\": " + ec.message());
+}
+
+void Metrics::writeJson(const std::string& filename) const
+{
+	std::ostringstream oss;
+	writeJson(oss);
+	writeFile(filename, oss.str());
+}
+
+void Metrics::writePrometheus(const std::string& filename) const
+{
+	std::ostringstream oss;
+	writePrometheus(oss);
+	writeFile(filename, oss.str());
+}
+
+void Metrics::writeJson(std::ostream& os) const
+{
+	std::uint64_t totalBytes = 0;
+	for(const Entry& feed : feeds)
+		for(const EpisodeMetrics& episode : feed.metrics.downloads)
+			totalBytes += episode.transfer.bytes;
+
+	os << std::setprecision(6)
+		<< "{" << std::endl
+		<< "  \"timestamp\": " << std::time(NULL) << "," << std::endl
+		<< "  \"seconds\": " << seconds << "," << std::endl
+		<< "  \"sync_seconds\": " << syncSeconds << "," << std::endl
+		<< "  \"unavailable_hosts\": " << unavailableHosts << "," << std::endl
+		<< "  \"bytes\": " << totalBytes << "," << std::endl
+		<< "  \"bytes_per_second\": " << (seconds > 0 ? totalBytes / seconds : 0) << "," << std::endl
+		<< "  \"feeds\": [";
+	for(std::size_t i = 0; i < feeds.size(); i++)
+	{
+		const FeedMetrics& m = feeds[i].metrics;
+		os << (i ? "," : "") << std::endl
+			<< "    {" << std::endl
+			<< "      \"uid\": " << jsonString(feeds[i].uid) << "," << std::endl
+			<< "      \"updated\": " << (m.updated ? "true" : "false") << "," << std::endl
+			<< "      \"http_status\": " << m.responseCode << "," << std::endl
+			<< "      \"retries\": " << m.retries << "," << std::endl
+			<< "      \"cache_hit\": " << (m.cacheHit ? "true" : "false") << "," << std::endl
+			<< "      \"document_bytes\": " << m.documentBytes << "," << std::endl
+			<< "      \"items\": " << m.items << "," << std::endl
+			<< "      \"episodes\": " << m.episodes << "," << std::endl
+			<< "      \"skipped\": " << m.skipped << "," << std::endl
+			<< "      \"update_seconds\": " << m.updateSeconds << "," << std::endl
+			<< "      \"fetch_seconds\": " << m.fetchSeconds << "," << std::endl
+			<< "      \"parse_seconds\": " << m.parseSeconds << "," << std::endl
+			<< "      \"filter_seconds\": " << m.filterSeconds << "," << std::endl
+			<< "      \"index_seconds\": " << m.indexSeconds << "," << std::endl
+			<< "      \"downloads\": [";
+		for(std::size_t j = 0; j < m.downloads.size(); j++)
+		{
+			const EpisodeMetrics& e = m.downloads[j];
+			os << (j ? "," : "") << std::endl
+				<< "        {\"title\": " << jsonString(e.title)
+				<< ", \"guid\": " << jsonString(e.guid)
+				<< ", \"filename\": " << jsonString(e.filename)
+				<< ", \"success\": " << (e.success ? "true" : "false")
+				<< ", \"error\": " << jsonString(e.error)
+				<< ", \"http_status\": " << e.transfer.responseCode
+				<< ", \"bytes\": " << e.transfer.bytes
+				<< ", \"resumed_from\": " << e.transfer.resumedFrom
+				<< ", \"from_media_store\": " << (e.transfer.fromMediaStore ? "true" : "false")
+				<< ", \"seconds\": " << e.transfer.seconds
+				<< ", \"disk_seconds\": " << e.transfer.diskSeconds
+				<< ", \"connections\": " << e.transfer.connections
+				<< ", \"retries\": " << e.transfer.retries
+				<< ", \"bytes_per_second\": " << (e.transfer.seconds > 0 ? e.transfer.bytes / e.transfer.seconds : 0) << "}";
+		}
+		os << (m.downloads.empty() ? "]" : "\n      ]") << std::endl << "    }";
+	}
+	os << (feeds.empty() ? "]" : "\n  ]") << std::endl << "}" << std::endl;
+}
+
+void Metrics::writePrometheus(std::ostream& os) const
+{
+	os << std::setprecision(9);
+	auto header = [&os](const char* name, const char* type, const char* help)
+	{
+		os << "# HELP " << name << " " << help << std::endl << "# TYPE " << name << " " << type << std::endl;
+	};
+	auto perFeed = [&](const char* name, const char* help, auto value)
+	{
+		header(name, "gauge", help);
+		for(const Entry& feed : feeds)
+			os << name << "{feed=\"" << labelValue(feed.uid) << "\"} " << value(feed.metrics) << std::endl;
+	};
+
+	std::uint64_t totalBytes = 0;
+	for(const Entry& feed : feeds)
+		for(const EpisodeMetrics& episode : feed.metrics.downloads)
+			totalBytes += episode.transfer.bytes;
+	header("jpod_run_timestamp_seconds", "gauge", "When the last run finished.");
+	os << "jpod_run_timestamp_seconds " << std::time(NULL) << std::endl;
+	header("jpod_run_duration_seconds", "gauge", "Duration of the last run.");
+	os << "jpod_run_duration_seconds " << seconds << std::endl;
+	header("jpod_run_sync_duration_seconds", "gauge", "Time spent flushing the downloaded files to disk at the end of the last run.");
+	os << "jpod_run_sync_duration_seconds " << syncSeconds << std::endl;
+	header("jpod_run_unavailable_hosts", "gauge", "Number of hosts that are skipped because they failed repeatedly, at the end of the last run.");
+	os << "jpod_run_unavailable_hosts " << unavailableHosts << std::endl;
+	header("jpod_run_download_bytes", "gauge", "Bytes downloaded in the last run.");
+	os << "jpod_run_download_bytes " << totalBytes << std::endl;
+
+	perFeed("jpod_feed_updated", "Whether the feed was retrieved and parsed successfully.", [](const FeedMetrics& m) {return m.updated ? 1 : 0;});
+	perFeed("jpod_feed_http_status", "HTTP status of the feed retrieval.", [](const FeedMetrics& m) {return m.responseCode;});
+	perFeed("jpod_feed_retries", "Number of times the feed retrieval was tried again after a transient failure.", [](const FeedMetrics& m) {return m.retries;});
+	perFeed("jpod_feed_cache_hit", "Whether the server reported the feed as not modified.", [](const FeedMetrics& m) {return m.cacheHit ? 1 : 0;});
+	perFeed("jpod_feed_document_bytes", "Size of the feed document as received.", [](const FeedMetrics& m) {return m.documentBytes;});
+	perFeed("jpod_feed_items", "Number of items looked at.", [](const FeedMetrics& m) {return m.items;});
+	perFeed("jpod_feed_episodes", "Number of episodes that got past the filters.", [](const FeedMetrics& m) {return m.episodes;});
+	perFeed("jpod_feed_episodes_skipped", "Number of episodes that had been downloaded before.", [](const FeedMetrics& m) {return m.skipped;});
+	perFeed("jpod_feed_update_duration_seconds", "Time for retrieving, parsing and filtering the feed.", [](const FeedMetrics& m) {return m.updateSeconds;});
+	perFeed("jpod_feed_fetch_duration_seconds", "Time for retrieving the feed document.", [](const FeedMetrics& m) {return m.fetchSeconds;});
+	perFeed("jpod_feed_parse_duration_seconds", "Time for parsing the feed document.", [](const FeedMetrics& m) {return m.parseSeconds;});
+	perFeed("jpod_feed_filter_duration_seconds", "Time spent evaluating filters.", [](const FeedMetrics& m) {return m.filterSeconds;});
+	perFeed("jpod_feed_index_duration_seconds", "Time for checking which episodes have been downloaded before.", [](const FeedMetrics& m) {return m.indexSeconds;});
+	perFeed("jpod_feed_downloads_succeeded", "Number of episodes downloaded.", [](const FeedMetrics& m)
+	{
+		unsigned count = 0;
+		for(const EpisodeMetrics& e : m.downloads)
+			count += e.success;
+		return count;
+	});
+	perFeed("jpod_feed_downloads_failed", "Number of episodes that could not be downloaded.", [](const FeedMetrics& m)
+	{
+		unsigned count = 0;
+		for(const EpisodeMetrics& e : m.downloads)
+			count += !e.success;
+		return count;
+	});
+	perFeed("jpod_feed_downloads_from_media_store", "Number of episodes placed from the media store instead of being transferred.", [](const FeedMetrics& m)
+	{
+		unsigned count = 0;
+		for(const EpisodeMetrics& e : m.downloads)
+			count += e.success && e.transfer.fromMediaStore;
+		return count;
+	});
+	perFeed("jpod_feed_download_bytes", "Bytes downloaded for the feed's episodes.", [](const FeedMetrics& m)
+	{
+		std::uint64_t bytes = 0;
+		for(const EpisodeMetrics& e : m.downloads)
+			bytes += e.transfer.bytes;
+		return bytes;
+	});
+	perFeed("jpod_feed_download_duration_seconds", "Total duration of the transfers of the feed's episodes.", [](const FeedMetrics& m)
+	{
+		double seconds = 0;
+		for(const EpisodeMetrics& e : m.downloads)
+			seconds += e.transfer.seconds;
+		return seconds;
+	});
+	perFeed("jpod_feed_download_connections", "Number of transfers the feed's episodes were received over, more than one per episode if they were split into segments.", [](const FeedMetrics& m)
+	{
+		unsigned count = 0;
+		for(const EpisodeMetrics& e : m.downloads)
+			count += e.transfer.connections;
+		return count;
+	});
+	perFeed("jpod_feed_download_retries", "Number of times downloads of the feed's episodes were tried again after a transient failure.", [](const FeedMetrics& m)
+	{
+		unsigned count = 0;
+		for(const EpisodeMetrics& e : m.downloads)
+			count += e.transfer.retries;
+		return count;
+	});
+	perFeed("jpod_feed_download_disk_blocked_seconds", "Time the transfers of the feed's episodes spent waiting for the disk.", [](const FeedMetrics& m)
+	{
+		double seconds = 0;
+		for(const EpisodeMetrics& e : m.downloads)
+			seconds += e.transfer.diskSeconds;
+		return seconds;
+	});
+}
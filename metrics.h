@@ -0,0 +1,140 @@
+/**
+ * \file metrics.h
+ * \brief Defines the Metrics class and the structures it reports
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include<string>
+#include<vector>
+#include<ostream>
+#include<cstdint>
+#include"download.h"
+
+/**
+ * \brief What happened to one episode during a run
+ */
+struct EpisodeMetrics
+{
+	/// Title of the episode
+	std::string title;
+	/// GUID of the episode
+	std::string guid;
+	/// Name of the file (without path and extension)
+	std::string filename;
+	/// Whether the episode was downloaded successfully
+	bool success = false;
+	/// Why the download failed (empty if it succeeded)
+	std::string error;
+	/// The transfer
+	DownloadStats transfer;
+};
+
+/**
+ * \brief What happened to one feed during a run
+ * \details Durations are in seconds.
+ */
+struct FeedMetrics
+{
+	/// Whether the feed was retrieved and parsed successfully
+	bool updated = false;
+	/// HTTP status of the feed retrieval (0 for non-HTTP URIs)
+	long responseCode = 0;
+	/// Number of times the retrieval was tried again after a transient failure
+	unsigned retries = 0;
+	/// Whether the cached copy of the feed could be used (the server answered 304 Not Modified)
+	bool cacheHit = false;
+	/// Size of the feed document as received (0 if it was not modified)
+	std::uint64_t documentBytes = 0;
+	/// Number of items looked at
+	unsigned items = 0;
+	/// Number of episodes that got past the filters
+	unsigned episodes = 0;
+	/// Number of episodes that had been downloaded before
+	unsigned skipped = 0;
+	/// Time for the whole update (retrieval, parsing and filtering)
+	double updateSeconds = 0;
+	/// Time for retrieving the feed document, which is parsed and filtered while it arrives
+	double fetchSeconds = 0;
+	/// Time for parsing the feed document (without filtering)
+	double parseSeconds = 0;
+	/// Time spent evaluating filters
+	double filterSeconds = 0;
+	/// Time for checking which episodes have been downloaded before
+	double indexSeconds = 0;
+	/// The episodes queued for download, in the order they finished
+	std::vector<EpisodeMetrics> downloads;
+};
+
+/**
+ * \brief Writes the metrics of a run to files
+ * \details Two formats are supported: JSON, which includes every episode, and
+ * the text format of Prometheus, which only includes figures per feed (so it
+ * can be picked up by the textfile collector of the node exporter without
+ * creating a time series per episode).
+ */
+class Metrics
+{
+private:
+	struct Entry
+	{
+		std::string uid;
+		FeedMetrics metrics;
+	};
+
+	std::vector<Entry> feeds;
+	double seconds, syncSeconds;
+	unsigned unavailableHosts;
+
+	static void writeFile(const std::string& filename, const std::string& content);
+	void writeJson(std::ostream& os) const;
+	void writePrometheus(std::ostream& os) const;
+public:
+	/**
+	 * \brief Creates an empty report
+	 */
+	Metrics();
+
+	/**
+	 * \brief Adds the metrics of a feed
+	 * \param uid The unique ID of the feed.
+	 * \param metrics What happened to the feed.
+	 */
+	void addFeed(const std::string& uid, const FeedMetrics& metrics);
+
+	/**
+	 * \brief Sets the duration of the whole run
+	 * \param seconds The duration in seconds.
+	 */
+	void setDuration(double seconds) {this->seconds = seconds;}
+
+	/**
+	 * \brief Sets the time spent flushing the downloaded files to disk
+	 * \param seconds The duration in seconds (see DownloadEngine#getSyncSeconds()).
+	 */
+	void setSyncDuration(double seconds) {syncSeconds = seconds;}
+
+	/**
+	 * \brief Sets the number of hosts that are skipped
+	 * \param count The number of hosts (see CircuitBreaker#countOpen()).
+	 */
+	void setUnavailableHosts(unsigned count) {unavailableHosts = count;}
+
+	/**
+	 * \brief Writes the metrics as a JSON document
+	 * \param filename The name of the file. It is replaced atomically.
+	 * \throws std::runtime_error If the file could not be written.
+	 */
+	void writeJson(const std::string& filename) const;
+
+	/**
+	 * \brief Writes the metrics in the Prometheus text format
+	 * \param filename The name of the file, which should end in ".prom" for
+	 * the textfile collector. It is replaced atomically.
+	 * \throws std::runtime_error If the file could not be written.
+	 */
+	void writePrometheus(const std::string& filename) const;
+};
+
+#endif //METRICS_H
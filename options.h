@@ -0,0 +1,60 @@
+/**
+ * \file options.h
+ * \brief Defines the Options structure
+ */
+
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include<filesystem>
+#include"diskwriter.h"
+
+/**
+ * \brief Global settings that apply to all feeds
+ * \details These are read from the attributes of the `<podlist>` root element
+ * of the configuration file. Every setting has a default value, so all of
+ * these attributes are optional.
+ */
+struct Options
+{
+	/// Maximum number of episodes downloaded at the same time (attribute "max-downloads")
+	unsigned maxDownloads = 4;
+	/// Maximum number of episodes downloaded from the same host at the same time (attribute "max-downloads-per-host")
+	unsigned maxDownloadsPerHost = 2;
+	/// Maximum total download rate in KiB/s, 0 means no limit (attribute "max-rate")
+	unsigned maxRate = 0;
+	/// Maximum number of connections a large episode is downloaded over at the same time, 1 means never split episodes (attribute "segments")
+	unsigned segments = 4;
+	/// Minimum size of an episode that is downloaded over several connections, in MiB (attribute "segment-threshold")
+	unsigned segmentThreshold = 64;
+	/// Time for establishing a connection in seconds, 0 means curl's default of 300 (attribute "connect-timeout")
+	unsigned connectTimeout = 30;
+	/// Time a transfer may go without receiving anything in seconds, 0 means no limit (attribute "stall-timeout")
+	unsigned stallTimeout = 60;
+	/// Time for retrieving a feed in seconds, 0 means no limit (attribute "feed-timeout")
+	unsigned feedTimeout = 120;
+	/// Time for downloading an episode in seconds, 0 means no limit (attribute "download-timeout")
+	unsigned downloadTimeout = 0;
+	/// How often a transfer that failed for a transient reason is tried again (attribute "retries")
+	unsigned retries = 2;
+	/// Delay before the first retry in seconds, doubled for every further one (attribute "retry-delay")
+	unsigned retryDelay = 2;
+	/// Number of failures in a row after which a host is skipped, 0 means never (attribute "breaker-threshold")
+	unsigned breakerThreshold = 3;
+	/// How long a host that keeps failing is skipped at first, in minutes (attribute "breaker-cooldown")
+	unsigned breakerCooldown = 30;
+	/// Number of feeds that are retrieved and parsed at the same time (attribute "update-threads")
+	unsigned updateThreads = 4;
+	/// Shortest time between two polls of a feed in daemon mode, in minutes (attribute "min-poll-interval")
+	unsigned minPollInterval = 10;
+	/// Longest time between two polls of a feed in daemon mode, in minutes (attribute "max-poll-interval")
+	unsigned maxPollInterval = 1440;
+	/// Directory where JPod keeps data between runs (attribute "datadir", relative to the home directory; defaults to $XDG_DATA_HOME/jpod or ~/.local/share/jpod)
+	std::filesystem::path dataDir;
+	/// Directory of a media store shared by feeds and users, empty for none (attribute "media-store", relative to the home directory)
+	std::filesystem::path mediaStore;
+	/// When downloaded episodes are flushed to disk (attribute "fsync": "none", "episode" or "run")
+	SyncPolicy sync = SyncPolicy::RUN;
+};
+
+#endif //OPTIONS_H
@@ -0,0 +1,149 @@
+/**
+ * \file placeholderpattern.cpp
+ * \brief Implementation for placeholderpattern.h
+ */
+
+#include"episode.h"
+#include"placeholderpattern.h"
+
+static const char* const WEEKDAYS[] = {"Sunday", "Monday", "Tuesday", "Wednesday", "Thursday", "Friday", "Saturday"};
+static const char* const MONTHS[] = {"January", "February", "March", "April", "May", "June", "July", "August", "September", "October", "November", "December"};
+
+/// Appends a number with at least the given number of digits
+static void appendNumber(std::string& result, long value, int digits, char pad = '0')
+{
+	if(value < 0)
+	{
+		result += '-';
+		value = -value;
+	}
+	char buffer[24];
+	int length = 0;
+	do
+	{
+		buffer[length++] = '0' + value % 10;
+		value /= 10;
+	}
+	while(value > 0);
+	for(int i = length; i < digits; i++)
+		result += pad;
+	while(length > 0)
+		result += buffer[--length];
+}
+
+/// Appends a name from a table, or a question mark if the index is out of range
+static void appendName(std::string& result, const char* const* names, int count, int index, bool abbreviated)
+{
+	if(index < 0 || index >= count)
+		result += '?';
+	else if(abbreviated)
+		result.append(names[index], 3);
+	else
+		result += names[index];
+}
+
+PlaceholderPattern::PlaceholderPattern(const std::string& pattern)
+{
+	std::string literal;
+	for(std::size_t i = 0; i < pattern.length(); i++)
+	{
+		if(pattern[i] != '%')
+		{
+			literal += pattern[i];
+			continue;
+		}
+		if(i + 1 == pattern.length() || pattern[i + 1] == '%')
+		{
+			literal += '%';
+			i++;
+			continue;
+		}
+
+		// A placeholder, unknown ones are dropped
+		char c = pattern[++i];
+		TokenType type;
+		if(c == 'P') type = TokenType::FEED_TITLE;
+		else if(c == 'C') type = TokenType::FEED_DESCRIPTION;
+		else if(c == 'T') type = TokenType::TITLE;
+		else if(c == 'D') type = TokenType::DESCRIPTION;
+		else if(std::string("YymbBWjdeaAwuHIMSp").find(c) != std::string::npos) type = TokenType::DATE;
+		else continue;
+		if(!literal.empty())
+			tokens.push_back({TokenType::LITERAL, literal, 0});
+		literal.clear();
+		tokens.push_back({type, "", type == TokenType::DATE ? c : '\0'});
+	}
+	if(!literal.empty())
+		tokens.push_back({TokenType::LITERAL, literal, 0});
+}
+
+std::vector<PlaceholderPattern> PlaceholderPattern::splitPath(const std::string& pattern)
+{
+	std::vector<PlaceholderPattern> parts;
+	std::string part;
+	for(std::size_t i = 0; i < pattern.length(); i++)
+	{
+		// The character after a '%' belongs to the placeholder, even if it is a '/'
+		if(pattern[i] == '%' && i + 1 < pattern.length())
+			part += pattern[i++];
+		else if(pattern[i] == '/')
+		{
+			if(!part.empty())
+				parts.emplace_back(part);
+			part.clear();
+			continue;
+		}
+		part += pattern[i];
+	}
+	if(!part.empty() || parts.empty())
+		parts.emplace_back(part);
+	return parts;
+}
+
+void PlaceholderPattern::fill(const Episode& episode, std::string& result) const
+{
+	for(const Token& token : tokens)
+	{
+		switch(token.type)
+		{
+			case TokenType::LITERAL: result += token.text; break;
+			case TokenType::FEED_TITLE: result += episode.getFeedTitle(); break;
+			case TokenType::FEED_DESCRIPTION: result += episode.getFeedDescription(); break;
+			case TokenType::TITLE: result += episode.getTitle(); break;
+			case TokenType::DESCRIPTION: result += episode.getDescription(); break;
+			case TokenType::DATE: appendDate(token.date, episode.getPubDate(), result); break;
+		}
+	}
+}
+
+std::string PlaceholderPattern::fill(const Episode& episode) const
+{
+	std::string result;
+	fill(episode, result);
+	return result;
+}
+
+void PlaceholderPattern::appendDate(char placeholder, const std::tm* date, std::string& result)
+{
+	switch(placeholder)
+	{
+		case 'Y': appendNumber(result, 1900L + date->tm_year, 1); break;
+		case 'y': appendNumber(result, ((1900L + date->tm_year) % 100 + 100) % 100, 2); break;
+		case 'm': appendNumber(result, date->tm_mon + 1, 2); break;
+		case 'b': appendName(result, MONTHS, 12, date->tm_mon, true); break;
+		case 'B': appendName(result, MONTHS, 12, date->tm_mon, false); break;
+		case 'W': appendNumber(result, (date->tm_yday + 7 - (date->tm_wday + 6) % 7) / 7, 2); break;
+		case 'j': appendNumber(result, date->tm_yday + 1, 3); break;
+		case 'd': appendNumber(result, date->tm_mday, 2); break;
+		case 'e': appendNumber(result, date->tm_mday, 2, ' '); break;
+		case 'a': appendName(result, WEEKDAYS, 7, date->tm_wday, true); break;
+		case 'A': appendName(result, WEEKDAYS, 7, date->tm_wday, false); break;
+		case 'w': appendNumber(result, date->tm_wday, 1); break;
+		case 'u': appendNumber(result, date->tm_wday == 0 ? 7 : date->tm_wday, 1); break;
+		case 'H': appendNumber(result, date->tm_hour, 2); break;
+		case 'I': appendNumber(result, date->tm_hour % 12 == 0 ? 12 : date->tm_hour % 12, 2); break;
+		case 'M': appendNumber(result, date->tm_min, 2); break;
+		case 'S': appendNumber(result, date->tm_sec, 2); break;
+		case 'p': result += date->tm_hour < 12 ? "AM" : "PM"; break;
+	}
+}
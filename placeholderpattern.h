@@ -0,0 +1,72 @@
+/**
+ * \file placeholderpattern.h
+ * \brief Defines the PlaceholderPattern class
+ */
+
+#ifndef PLACEHOLDERPATTERN_H
+#define PLACEHOLDERPATTERN_H
+
+#include<string>
+#include<vector>
+#include<ctime>
+
+class Episode;
+
+/**
+ * \brief A string with placeholders for the metadata of an episode
+ * \details The pattern is split into literal text and placeholders once, when
+ * it is created. Filling in the placeholders for an episode then only appends
+ * the pieces, instead of scanning the pattern again each time. See
+ * Episode#fillPlaceholders() for the supported placeholders.
+ *
+ * Dates are formatted by hand, as std::strftime() would in the "C" locale,
+ * without going through a stream.
+ */
+class PlaceholderPattern
+{
+private:
+	enum class TokenType {LITERAL, FEED_TITLE, FEED_DESCRIPTION, TITLE, DESCRIPTION, DATE};
+	struct Token
+	{
+		TokenType type;
+		std::string text; // The literal text
+		char date; // The date placeholder (e.g. 'Y')
+	};
+
+	std::vector<Token> tokens;
+
+	static void appendDate(char placeholder, const std::tm* date, std::string& result);
+public:
+	/**
+	 * \brief Compiles a pattern
+	 * \param pattern A string that may contain placeholders.
+	 */
+	PlaceholderPattern(const std::string& pattern);
+
+	/**
+	 * \brief Fills the placeholders with the metadata of an episode
+	 * \param episode The episode.
+	 * \param result The string that the result is appended to.
+	 */
+	void fill(const Episode& episode, std::string& result) const;
+
+	/**
+	 * \brief Fills the placeholders with the metadata of an episode
+	 * \param episode The episode.
+	 * \return The pattern with all placeholders replaced.
+	 */
+	std::string fill(const Episode& episode) const;
+
+	/**
+	 * \brief Compiles a pattern that describes a relative path
+	 * \details The pattern is split at every '/' in its literal text, but not
+	 * at one that is filled in for a placeholder later. Empty parts are
+	 * dropped, so the path can neither be absolute nor contain empty names.
+	 * \param pattern A string that may contain placeholders and '/'.
+	 * \return One pattern per directory of the path, followed by one for the
+	 * file name. At least one pattern is returned.
+	 */
+	static std::vector<PlaceholderPattern> splitPath(const std::string& pattern);
+};
+
+#endif //PLACEHOLDERPATTERN_H
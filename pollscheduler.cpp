@@ -0,0 +1,95 @@
+/**
+ * \file pollscheduler.cpp
+ * \brief Implementation for pollscheduler.h
+ */
+
+#include<algorithm>
+#include<iterator>
+#include"pollscheduler.h"
+
+PollScheduler::PollScheduler(std::size_t count, unsigned minInterval, unsigned maxInterval, std::time_t now)
+: feeds(count), minInterval(std::max(minInterval, 1u)), maxInterval(std::max(minInterval, maxInterval)), random(std::random_device()())
+{
+	for(State& state : feeds)
+	{
+		state.next = now;
+		state.interval = this->minInterval;
+	}
+}
+
+std::vector<std::size_t> PollScheduler::due(std::time_t now) const
+{
+	std::vector<std::size_t> result;
+	for(std::size_t i = 0; i < feeds.size(); i++)
+		if(feeds[i].next <= now)
+			result.push_back(i);
+	std::stable_sort(result.begin(), result.end(), [this](std::size_t a, std::size_t b) {return feeds[a].next < feeds[b].next;});
+	return result;
+}
+
+std::time_t PollScheduler::getNext() const
+{
+	std::time_t next = 0;
+	for(std::size_t i = 0; i < feeds.size(); i++)
+		if(i == 0 || feeds[i].next < next)
+			next = feeds[i].next;
+	return next;
+}
+
+void PollScheduler::polled(std::size_t feed, std::time_t now, const std::vector<std::time_t>& itemTimes, long maxAge)
+{
+	State& state = feeds[feed];
+
+	// Remember the newest publication times, ignoring items scheduled for the future
+	std::time_t newest = state.published.empty() ? 0 : *state.published.rbegin();
+	for(std::time_t time : itemTimes)
+		if(time <= now)
+			state.published.insert(time);
+	while(state.published.size() > HISTORY)
+		state.published.erase(state.published.begin());
+	bool changed = !state.published.empty() && *state.published.rbegin() > newest;
+
+	double interval;
+	double gap = medianGap(state);
+	if(gap > 0)
+	{
+		// Converge on the time the next item is expected, back off once it is overdue
+		double expected = *state.published.rbegin() + gap;
+		interval = expected > now ? (expected - now) / 2 : (now - expected) / 2;
+	}
+	else
+		interval = changed ? minInterval : state.interval * 1.5;
+	state.interval = clamp(interval);
+
+	// Don't ask again before the server's copy can have changed
+	schedule(state, now, std::max(state.interval, (double)maxAge));
+}
+
+void PollScheduler::failed(std::size_t feed, std::time_t now)
+{
+	State& state = feeds[feed];
+	state.interval = clamp(state.interval * 2);
+	schedule(state, now, state.interval);
+}
+
+double PollScheduler::clamp(double interval) const
+{
+	return std::min(std::max(interval, minInterval), maxInterval);
+}
+
+void PollScheduler::schedule(State& state, std::time_t now, double interval)
+{
+	std::uniform_real_distribution<double> jitter(0.9, 1.1);
+	state.next = now + (std::time_t)(clamp(interval) * jitter(random));
+}
+
+double PollScheduler::medianGap(const State& state)
+{
+	if(state.published.size() < 2)
+		return 0;
+	std::vector<double> gaps;
+	for(auto iter = state.published.begin(); std::next(iter) != state.published.end(); iter++)
+		gaps.push_back(*std::next(iter) - *iter);
+	std::nth_element(gaps.begin(), gaps.begin() + gaps.size() / 2, gaps.end());
+	return gaps[gaps.size() / 2];
+}
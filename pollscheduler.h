@@ -0,0 +1,101 @@
+/**
+ * \file pollscheduler.h
+ * \brief Defines the PollScheduler class
+ */
+
+#ifndef POLLSCHEDULER_H
+#define POLLSCHEDULER_H
+
+#include<vector>
+#include<set>
+#include<random>
+#include<ctime>
+#include<cstddef>
+
+/**
+ * \brief Decides when each feed should be polled next
+ * \details Every feed is scheduled independently. Once a feed has published a
+ * few items, the scheduler knows the median gap between them and expects the
+ * next item one gap after the newest one. The interval until the next poll is
+ * half the time until that moment, so polls get denser as it approaches;
+ * afterwards, it is half the time by which the item is overdue, so a feed that
+ * has stopped publishing is polled less and less often. As long as the gap is
+ * unknown, the interval starts at the minimum and grows by half with every
+ * poll that brings nothing new.
+ *
+ * The interval is never shorter than the server's freshness lifetime of the
+ * document (Cache-Control/Expires), it is doubled after a failed poll, it is
+ * kept between the minimum and maximum interval, and it is randomized by
+ * +/-10% so feeds that were due at the same time drift apart.
+ */
+class PollScheduler
+{
+private:
+	struct State
+	{
+		std::time_t next;
+		double interval;
+		std::set<std::time_t> published;
+	};
+
+	/// Number of publication times kept per feed
+	static const std::size_t HISTORY = 16;
+
+	std::vector<State> feeds;
+	double minInterval, maxInterval;
+	std::mt19937 random;
+
+	double clamp(double interval) const;
+	void schedule(State& state, std::time_t now, double interval);
+	static double medianGap(const State& state);
+public:
+	/**
+	 * \brief Creates a PollScheduler where all feeds are due immediately
+	 * \param count Number of feeds, they are identified by their index.
+	 * \param minInterval Shortest time between two polls of a feed, in seconds.
+	 * \param maxInterval Longest time between two polls of a feed, in seconds.
+	 * \param now The current time.
+	 */
+	PollScheduler(std::size_t count, unsigned minInterval, unsigned maxInterval, std::time_t now);
+
+	/**
+	 * \brief Returns the feeds that are due
+	 * \param now The current time.
+	 * \return The indices of the feeds, the ones that have been waiting
+	 * longest first.
+	 */
+	std::vector<std::size_t> due(std::time_t now) const;
+
+	/**
+	 * \brief Returns when the next feed is due
+	 * \return The earliest time at which any feed is due.
+	 */
+	std::time_t getNext() const;
+
+	/**
+	 * \brief Returns when a feed is due
+	 * \param feed The index of the feed.
+	 * \return The time of the feed's next poll.
+	 */
+	std::time_t getNext(std::size_t feed) const {return feeds[feed].next;}
+
+	/**
+	 * \brief Reschedules a feed after a successful poll
+	 * \param feed The index of the feed.
+	 * \param now The current time.
+	 * \param itemTimes The publication times of the items in the document
+	 * (see Feed#getItemTimes()). Times that are already known are ignored.
+	 * \param maxAge The freshness lifetime of the document in seconds, or -1
+	 * if unknown (see Feed#getMaxAge()).
+	 */
+	void polled(std::size_t feed, std::time_t now, const std::vector<std::time_t>& itemTimes, long maxAge);
+
+	/**
+	 * \brief Reschedules a feed after a failed poll
+	 * \param feed The index of the feed.
+	 * \param now The current time.
+	 */
+	void failed(std::size_t feed, std::time_t now);
+};
+
+#endif //POLLSCHEDULER_H
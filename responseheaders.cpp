@@ -0,0 +1,75 @@
+/**
+ * \file responseheaders.cpp
+ * \brief Implementation for responseheaders.h
+ */
+
+#include<strings.h>
+#include<cstdlib>
+#include<cctype>
+#include<ctime>
+#include"responseheaders.h"
+#include"dateparser.h"
+
+// Returns the value of a header line, given the length of "Name:"
+static std::string headerValue(const std::string& line, std::size_t nameLength)
+{
+	std::size_t start = line.find_first_not_of(" \t", nameLength);
+	return start == std::string::npos ? "" : line.substr(start);
+}
+
+std::size_t ResponseHeaders::curlHeader(char* buffer, std::size_t size, std::size_t nitems, ResponseHeaders* headers)
+{
+	std::string line(buffer, size * nitems);
+	line.erase(line.find_last_not_of("\r\n") + 1);
+	if(line.compare(0, 5, "HTTP/") == 0)
+		*headers = ResponseHeaders(); // A new response begins (e.g. after a redirect)
+	else if(strncasecmp(line.c_str(), "ETag:", 5) == 0)
+		headers->etag = headerValue(line, 5);
+	else if(strncasecmp(line.c_str(), "Last-Modified:", 14) == 0)
+		headers->lastModified = headerValue(line, 14);
+	else if(strncasecmp(line.c_str(), "Content-Range:", 14) == 0)
+		headers->contentRange = headerValue(line, 14);
+	else if(strncasecmp(line.c_str(), "Accept-Ranges:", 14) == 0)
+		headers->acceptRanges = headerValue(line, 14);
+	else if(strncasecmp(line.c_str(), "Cache-Control:", 14) == 0)
+		headers->cacheControl = headerValue(line, 14);
+	else if(strncasecmp(line.c_str(), "Expires:", 8) == 0)
+		headers->expires = headerValue(line, 8);
+	else if(strncasecmp(line.c_str(), "Date:", 5) == 0)
+		headers->date = headerValue(line, 5);
+	return size * nitems;
+}
+
+long ResponseHeaders::getMaxAge() const
+{
+	// Cache-Control takes precedence over Expires
+	long maxAge = -1;
+	std::size_t pos = 0;
+	while(pos < cacheControl.size())
+	{
+		std::size_t end = cacheControl.find(',', pos);
+		if(end == std::string::npos)
+			end = cacheControl.size();
+		std::size_t start = cacheControl.find_first_not_of(" \t", pos);
+		if(start < end)
+		{
+			const char* directive = cacheControl.c_str() + start;
+			if(strncasecmp(directive, "no-cache", 8) == 0 || strncasecmp(directive, "no-store", 8) == 0)
+				return 0;
+			if(strncasecmp(directive, "max-age=", 8) == 0 && std::isdigit((unsigned char)directive[8]))
+				maxAge = std::strtol(directive + 8, NULL, 10);
+		}
+		pos = end + 1;
+	}
+	if(maxAge >= 0)
+		return maxAge;
+
+	// Expires is relative to the server's clock
+	std::tm tm;
+	std::time_t expiresTime, dateTime;
+	if(expires.empty() || !DateParser::parseRfc822(expires.c_str(), tm, expiresTime))
+		return expires.empty() ? -1 : 0; // An invalid Expires means already expired
+	if(date.empty() || !DateParser::parseRfc822(date.c_str(), tm, dateTime))
+		dateTime = std::time(NULL);
+	return expiresTime > dateTime ? (long)(expiresTime - dateTime) : 0;
+}
@@ -0,0 +1,56 @@
+/**
+ * \file responseheaders.h
+ * \brief Defines the ResponseHeaders structure
+ */
+
+#ifndef RESPONSEHEADERS_H
+#define RESPONSEHEADERS_H
+
+#include<string>
+#include<cstddef>
+
+/**
+ * \brief The HTTP response headers JPod is interested in
+ * \details Filled by passing curlHeader() as CURLOPT_HEADERFUNCTION and a
+ * pointer to the structure as CURLOPT_HEADERDATA. If the transfer is
+ * redirected, only the headers of the final response are kept.
+ */
+struct ResponseHeaders
+{
+	/// Value of the ETag header
+	std::string etag;
+	/// Value of the Last-Modified header
+	std::string lastModified;
+	/// Value of the Content-Range header
+	std::string contentRange;
+	/// Value of the Accept-Ranges header
+	std::string acceptRanges;
+	/// Value of the Cache-Control header
+	std::string cacheControl;
+	/// Value of the Expires header
+	std::string expires;
+	/// Value of the Date header
+	std::string date;
+
+	/**
+	 * \brief Returns how long the response may be considered fresh
+	 * \details Taken from the max-age directive of Cache-Control if present
+	 * (no-cache and no-store count as 0), otherwise from the difference
+	 * between Expires and Date.
+	 * \return The freshness lifetime in seconds, or -1 if the headers do not
+	 * state one.
+	 */
+	long getMaxAge() const;
+
+	/**
+	 * \brief Callback function for CURL to process a header line
+	 * \param buffer The header line (not null-terminated).
+	 * \param size Always 1.
+	 * \param nitems Length of the header line.
+	 * \param headers The structure that receives the header values.
+	 * \return The number of bytes processed, i.e. size * nitems.
+	 */
+	static std::size_t curlHeader(char* buffer, std::size_t size, std::size_t nitems, ResponseHeaders* headers);
+};
+
+#endif //RESPONSEHEADERS_H
@@ -0,0 +1,54 @@
+/**
+ * \file retrypolicy.cpp
+ * \brief Implementation for retrypolicy.h
+ */
+
+#include<algorithm>
+#include"retrypolicy.h"
+
+/// Longest delay before a retry, in seconds
+static const double MAX_DELAY = 60;
+
+RetryPolicy::RetryPolicy(unsigned retries, double delay)
+: retries(retries), delay(delay), random(std::random_device()())
+{
+}
+
+void RetryPolicy::configure(unsigned retries, double delay)
+{
+	this->retries = retries;
+	this->delay = delay;
+}
+
+double RetryPolicy::backoff(unsigned attempt)
+{
+	double limit = delay;
+	for(unsigned i = 1; i < attempt && limit < MAX_DELAY; i++)
+		limit *= 2;
+	limit = std::min(limit, MAX_DELAY);
+	std::lock_guard<std::mutex> lock(mutex);
+	return limit / 2 + std::uniform_real_distribution<double>(0, limit / 2)(random);
+}
+
+bool RetryPolicy::isTransient(CURLcode result, long responseCode)
+{
+	switch(result)
+	{
+		case CURLE_OK:
+			break;
+		case CURLE_COULDNT_RESOLVE_HOST:
+		case CURLE_COULDNT_CONNECT:
+		case CURLE_OPERATION_TIMEDOUT:
+		case CURLE_SSL_CONNECT_ERROR:
+		case CURLE_GOT_NOTHING:
+		case CURLE_SEND_ERROR:
+		case CURLE_RECV_ERROR:
+		case CURLE_PARTIAL_FILE:
+		case CURLE_HTTP2:
+		case CURLE_HTTP2_STREAM:
+			return true;
+		default:
+			return false; // E.g. the file could not be written
+	}
+	return responseCode == 408 || responseCode == 429 || responseCode == 500 || responseCode == 502 || responseCode == 503 || responseCode == 504;
+}
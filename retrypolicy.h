@@ -0,0 +1,74 @@
+/**
+ * \file retrypolicy.h
+ * \brief Defines the RetryPolicy class
+ */
+
+#ifndef RETRYPOLICY_H
+#define RETRYPOLICY_H
+
+#include<mutex>
+#include<random>
+#include<curl/curl.h>
+
+/**
+ * \brief Decides whether and when a failed transfer is tried again
+ * \details Only failures that may go away by themselves are retried: the
+ * server could not be reached, the transfer timed out or broke off, or the
+ * server answered with 408, 429, 500, 502, 503 or 504. Other statuses (like
+ * 501 Not Implemented) will not change by asking again. The delay before the
+ * n-th retry is the base delay times 2^(n-1), of which a random half is
+ * waited, so transfers that failed together do not all retry at the same
+ * moment. It is never longer than a minute. Thread-safe.
+ */
+class RetryPolicy
+{
+private:
+	unsigned retries;
+	double delay;
+	std::mt19937 random;
+	std::mutex mutex;
+public:
+	/**
+	 * \brief Creates a RetryPolicy
+	 * \param retries How often a transfer is retried at most.
+	 * \param delay The delay before the first retry in seconds.
+	 */
+	RetryPolicy(unsigned retries = 0, double delay = 1);
+
+	RetryPolicy(const RetryPolicy&) = delete;
+	RetryPolicy& operator=(const RetryPolicy&) = delete;
+
+	/**
+	 * \brief Changes the number of retries and the delay
+	 * \details Should be called before any transfer is started.
+	 * \param retries How often a transfer is retried at most.
+	 * \param delay The delay before the first retry in seconds.
+	 */
+	void configure(unsigned retries, double delay);
+
+	/**
+	 * \brief Returns how often a transfer is retried at most
+	 * \return The number of retries.
+	 */
+	unsigned getRetries() const {return retries;}
+
+	/**
+	 * \brief Returns how long to wait before a retry
+	 * \param attempt The number of the retry, starting at 1.
+	 * \return The delay in seconds.
+	 */
+	double backoff(unsigned attempt);
+
+	/**
+	 * \brief Checks whether a failure may go away by itself
+	 * \details This also tells whether the server is to blame for it (see
+	 * CircuitBreaker).
+	 * \param result The result code of the transfer.
+	 * \param responseCode The HTTP status of the response, 0 if none was
+	 * received.
+	 * \return True if the transfer should be retried.
+	 */
+	static bool isTransient(CURLcode result, long responseCode);
+};
+
+#endif //RETRYPOLICY_H
@@ -0,0 +1,112 @@
+/**
+ * \file transfercontext.cpp
+ * \brief Implementation for transfercontext.h
+ */
+
+#include<stdexcept>
+#include"transfercontext.h"
+
+TransferContext::TransferContext()
+: connectTimeout(0), stallTimeout(0), feedTimeout(0), episodeTimeout(0), breaker(NULL)
+{
+	if(curl_global_init(CURL_GLOBAL_DEFAULT) != CURLE_OK)
+		throw std::runtime_error("Unable to initialize CURL");
+	share = curl_share_init();
+	if(!share)
+	{
+		curl_global_cleanup();
+		throw std::runtime_error("Unable to initialize CURL");
+	}
+	curl_share_setopt(share, CURLSHOPT_LOCKFUNC, lock);
+	curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, unlock);
+	curl_share_setopt(share, CURLSHOPT_USERDATA, this);
+	curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+	curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+}
+
+TransferContext::~TransferContext()
+{
+	for(CURL* handle : handles)
+		curl_easy_cleanup(handle);
+	curl_share_cleanup(share);
+	curl_global_cleanup();
+}
+
+TransferContext& TransferContext::get()
+{
+	static TransferContext context;
+	return context;
+}
+
+CURL* TransferContext::acquire(TransferKind kind)
+{
+	CURL* handle = NULL;
+	{
+		std::lock_guard<std::mutex> lock(handlesMutex);
+		if(!handles.empty())
+		{
+			handle = handles.back();
+			handles.pop_back();
+		}
+	}
+	if(!handle)
+		handle = curl_easy_init();
+	if(!handle)
+		throw std::runtime_error("Unable to initialize CURL");
+
+	curl_easy_setopt(handle, CURLOPT_SHARE, share);
+	curl_easy_setopt(handle, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2TLS);
+	curl_easy_setopt(handle, CURLOPT_PIPEWAIT, 1L);
+	curl_easy_setopt(handle, CURLOPT_USERAGENT, "curl/4");
+	curl_easy_setopt(handle, CURLOPT_FOLLOWLOCATION, 1L);
+	curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1L);
+
+	// A transfer that receives nothing at all is stalled, one that is merely slow is not
+	curl_easy_setopt(handle, CURLOPT_CONNECTTIMEOUT, (long)connectTimeout);
+	if(stallTimeout)
+	{
+		curl_easy_setopt(handle, CURLOPT_LOW_SPEED_LIMIT, 1L);
+		curl_easy_setopt(handle, CURLOPT_LOW_SPEED_TIME, (long)stallTimeout);
+	}
+	curl_easy_setopt(handle, CURLOPT_TIMEOUT, (long)(kind == TransferKind::FEED ? feedTimeout : episodeTimeout));
+	return handle;
+}
+
+void TransferContext::release(CURL* handle)
+{
+	curl_easy_reset(handle);
+	std::lock_guard<std::mutex> lock(handlesMutex);
+	handles.push_back(handle);
+}
+
+void TransferContext::setTimeouts(unsigned connect, unsigned stall, unsigned feed, unsigned episode)
+{
+	connectTimeout = connect;
+	stallTimeout = stall;
+	feedTimeout = feed;
+	episodeTimeout = episode;
+}
+
+std::string TransferContext::hostOf(const std::string& uri)
+{
+	std::string host;
+	CURLU* url = curl_url();
+	char* h = NULL;
+	if(url && curl_url_set(url, CURLUPART_URL, uri.c_str(), 0) == CURLUE_OK && curl_url_get(url, CURLUPART_HOST, &h, 0) == CURLUE_OK)
+	{
+		host = h;
+		curl_free(h);
+	}
+	curl_url_cleanup(url);
+	return host;
+}
+
+void TransferContext::lock(CURL* /*handle*/, curl_lock_data data, curl_lock_access /*access*/, void* context)
+{
+	((TransferContext*)context)->shareMutexes[data].lock();
+}
+
+void TransferContext::unlock(CURL* /*handle*/, curl_lock_data data, void* context)
+{
+	((TransferContext*)context)->shareMutexes[data].unlock();
+}
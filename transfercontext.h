@@ -0,0 +1,133 @@
+/**
+ * \file transfercontext.h
+ * \brief Defines the TransferContext class
+ */
+
+#ifndef TRANSFERCONTEXT_H
+#define TRANSFERCONTEXT_H
+
+#include<string>
+#include<vector>
+#include<mutex>
+#include<curl/curl.h>
+#include"retrypolicy.h"
+#include"circuitbreaker.h"
+
+/**
+ * \brief What a transfer retrieves, which determines its time limit
+ */
+enum class TransferKind
+{
+	/// A feed document
+	FEED,
+	/// An episode, or a segment of one
+	EPISODE
+};
+
+/**
+ * \brief Process-wide state shared by all HTTP transfers
+ * \details All transfers (feed retrievals as well as episode downloads) take
+ * their CURL easy handles from here. The handles are reused instead of being
+ * created and destroyed for every transfer, and they are connected to a CURL
+ * share object so the DNS cache and the TLS session cache are shared between
+ * all of them, even across threads. Thus, only the first transfer to a host
+ * pays for DNS resolution and a full TLS handshake. Open connections stay with
+ * the handle (or with the DownloadEngine's multi handle) and are reused by its
+ * next transfer; the connection pool itself is not shared, because libcurl
+ * does not support sharing it between concurrent threads. HTTP/2 is used
+ * where the server supports it, which allows many transfers to the same host
+ * to be multiplexed over a single connection.
+ *
+ * The context also holds what every transfer must respect: the time limits
+ * (for connecting, for stalling and for the whole transfer), the RetryPolicy
+ * and the CircuitBreaker that tells which hosts are known to be down.
+ */
+class TransferContext
+{
+private:
+	CURLSH* share;
+	std::vector<CURL*> handles;
+	std::mutex handlesMutex;
+	std::mutex shareMutexes[CURL_LOCK_DATA_LAST];
+	unsigned connectTimeout, stallTimeout, feedTimeout, episodeTimeout;
+	RetryPolicy retryPolicy;
+	CircuitBreaker* breaker;
+
+	TransferContext();
+	~TransferContext();
+	static void lock(CURL* handle, curl_lock_data data, curl_lock_access access, void* context);
+	static void unlock(CURL* handle, curl_lock_data data, void* context);
+public:
+	TransferContext(const TransferContext&) = delete;
+	TransferContext& operator=(const TransferContext&) = delete;
+
+	/**
+	 * \brief Returns the context, creating it on first use
+	 * \details The first call initializes CURL (curl_global_init()). It should
+	 * therefore happen before any threads are started.
+	 * \return The process-wide context.
+	 * \throws std::runtime_error If CURL could not be initialized.
+	 */
+	static TransferContext& get();
+
+	/**
+	 * \brief Provides an easy handle for a transfer
+	 * \details The handle is set up with the options common to all transfers
+	 * (shared caches, HTTP/2, user agent, following redirects, time limits).
+	 * Thread-safe.
+	 * \param kind What the transfer retrieves.
+	 * \return A handle that must be returned with release() when the transfer
+	 * is done.
+	 * \throws std::runtime_error If no handle could be created.
+	 */
+	CURL* acquire(TransferKind kind);
+
+	/**
+	 * \brief Returns a handle obtained from acquire() for reuse
+	 * \details The options of the handle are reset, but its connections and
+	 * caches are kept. Thread-safe.
+	 * \param handle The handle. Must not be part of a multi handle anymore.
+	 */
+	void release(CURL* handle);
+
+	/**
+	 * \brief Sets the time limits of transfers
+	 * \details Should be called before any transfer is started. All limits
+	 * are in seconds, 0 means no limit.
+	 * \param connect Time for establishing a connection.
+	 * \param stall Time a transfer may go without receiving anything (while
+	 * it is not paused).
+	 * \param feed Time for retrieving a feed document.
+	 * \param episode Time for transferring an episode (or a segment of it).
+	 */
+	void setTimeouts(unsigned connect, unsigned stall, unsigned feed, unsigned episode);
+
+	/**
+	 * \brief Returns the policy for retrying failed transfers
+	 * \return The policy, which allows no retries unless configured.
+	 */
+	RetryPolicy& getRetryPolicy() {return retryPolicy;}
+
+	/**
+	 * \brief Sets the breaker that keeps track of failing hosts
+	 * \details Should be called before any transfer is started.
+	 * \param breaker The breaker, or NULL for none. It must stay alive as long
+	 * as transfers are made.
+	 */
+	void setCircuitBreaker(CircuitBreaker* breaker) {this->breaker = breaker;}
+
+	/**
+	 * \brief Returns the breaker that keeps track of failing hosts
+	 * \return The breaker, or NULL if there is none.
+	 */
+	CircuitBreaker* getCircuitBreaker() const {return breaker;}
+
+	/**
+	 * \brief Extracts the host from a URI
+	 * \param uri The URI.
+	 * \return The name of the host, empty if the URI has none.
+	 */
+	static std::string hostOf(const std::string& uri);
+};
+
+#endif //TRANSFERCONTEXT_H
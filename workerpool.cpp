@@ -0,0 +1,62 @@
+/**
+ * \file workerpool.cpp
+ * \brief Implementation for workerpool.h
+ */
+
+#include"workerpool.h"
+
+WorkerPool::WorkerPool(unsigned threads)
+: busy(0), stopping(false)
+{
+	if(threads == 0)
+		threads = 1;
+	for(unsigned i = 0; i < threads; i++)
+		workers.emplace_back(&WorkerPool::work, this);
+}
+
+WorkerPool::~WorkerPool()
+{
+	wait();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	taskAvailable.notify_all();
+	for(std::thread& worker : workers)
+		worker.join();
+}
+
+void WorkerPool::submit(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		tasks.push_back(task);
+	}
+	taskAvailable.notify_one();
+}
+
+void WorkerPool::wait()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	allDone.wait(lock, [this]{return tasks.empty() && busy == 0;});
+}
+
+void WorkerPool::work()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while(true)
+	{
+		taskAvailable.wait(lock, [this]{return stopping || !tasks.empty();});
+		if(tasks.empty())
+			return; // stopping
+		std::function<void()> task = std::move(tasks.front());
+		tasks.pop_front();
+		busy++;
+		lock.unlock();
+		task();
+		lock.lock();
+		busy--;
+		if(tasks.empty() && busy == 0)
+			allDone.notify_all();
+	}
+}
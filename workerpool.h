@@ -0,0 +1,61 @@
+/**
+ * \file workerpool.h
+ * \brief Defines the WorkerPool class
+ */
+
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include<vector>
+#include<deque>
+#include<thread>
+#include<mutex>
+#include<condition_variable>
+#include<functional>
+
+/**
+ * \brief A fixed number of threads that execute queued tasks
+ * \details Tasks are executed in the order in which they were submitted, but
+ * up to as many at the same time as there are threads. Tasks must not throw
+ * exceptions; they are expected to report problems themselves.
+ */
+class WorkerPool
+{
+private:
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> tasks;
+	std::mutex mutex;
+	std::condition_variable taskAvailable, allDone;
+	unsigned busy;
+	bool stopping;
+
+	void work();
+public:
+	/**
+	 * \brief Starts the worker threads
+	 * \param threads Number of threads. 0 is treated as 1.
+	 */
+	WorkerPool(unsigned threads);
+
+	/**
+	 * \brief Destructor
+	 * \details Waits until all queued tasks are done, then stops the threads.
+	 */
+	~WorkerPool();
+
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	/**
+	 * \brief Queues a task
+	 * \param task The function to be executed by one of the threads.
+	 */
+	void submit(std::function<void()> task);
+
+	/**
+	 * \brief Blocks until all queued tasks are done
+	 */
+	void wait();
+};
+
+#endif //WORKERPOOL_H